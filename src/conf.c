@@ -32,6 +32,10 @@
 #define CONF_DEFAULT_LATITUDE          "0.0"
 #define CONF_DEFAULT_LONGITUDE         "0.0"
 #define CONF_DEFAULT_ALTITUDE          "0.0"
+#define CONF_DEFAULT_MARKER_OCCLUSION  "0"
+#define CONF_DEFAULT_HORIZON           "0"
+#define CONF_DEFAULT_HORIZON_DISTANCE  "50.0"
+#define CONF_DEFAULT_DEPTH_RESOLUTION  "4"
 #define CONF_DEFAULT_DARK_THEME        "1"
 
 static const gchar key_jpeg_quality[] = "jpeg-quality";
@@ -44,6 +48,10 @@ static const gchar key_map_grid_distance[] = "map-grid-distance";
 static const gchar key_latitude[] = "latitude";
 static const gchar key_longitude[] = "longitude";
 static const gchar key_altitude[] = "altitude";
+static const gchar key_marker_occlusion[] = "marker-occlusion";
+static const gchar key_horizon[] = "horizon";
+static const gchar key_horizon_distance[] = "horizon-distance";
+static const gchar key_depth_resolution[] = "depth-resolution";
 static const gchar key_dark_theme[] = "dark-theme";
 
 static const gchar sql_init[] = "CREATE TABLE IF NOT EXISTS `config`(`key` TEXT PRIMARY KEY, `value` TEXT);";
@@ -231,6 +239,54 @@ overlayaz_conf_set_altitude(gdouble value)
     return conf_write_double(key_altitude, value);
 }
 
+gint
+overlayaz_conf_get_marker_occlusion(void)
+{
+    return conf_read_int(key_marker_occlusion, CONF_DEFAULT_MARKER_OCCLUSION);
+}
+
+gboolean
+overlayaz_conf_set_marker_occlusion(gint value)
+{
+    return conf_write_int(key_marker_occlusion, value);
+}
+
+gboolean
+overlayaz_conf_get_horizon(void)
+{
+    return conf_read_int(key_horizon, CONF_DEFAULT_HORIZON);
+}
+
+gboolean
+overlayaz_conf_set_horizon(gboolean value)
+{
+    return conf_write_int(key_horizon, value);
+}
+
+gdouble
+overlayaz_conf_get_horizon_distance(void)
+{
+    return conf_read_double(key_horizon_distance, CONF_DEFAULT_HORIZON_DISTANCE);
+}
+
+gboolean
+overlayaz_conf_set_horizon_distance(gdouble value)
+{
+    return conf_write_double(key_horizon_distance, value);
+}
+
+gint
+overlayaz_conf_get_depth_resolution(void)
+{
+    return conf_read_int(key_depth_resolution, CONF_DEFAULT_DEPTH_RESOLUTION);
+}
+
+gboolean
+overlayaz_conf_set_depth_resolution(gint value)
+{
+    return conf_write_int(key_depth_resolution, value);
+}
+
 gboolean
 overlayaz_conf_get_dark_theme(void)
 {
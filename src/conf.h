@@ -22,6 +22,13 @@
 #define OVERLAYAZ_CONF_IMAGE_FILTER_NEAREST  "nearest"
 #define OVERLAYAZ_CONF_IMAGE_FILTER_BILINEAR "bilinear"
 
+enum overlayaz_conf_marker_occlusion
+{
+    OVERLAYAZ_CONF_MARKER_OCCLUSION_SHOW = 0,
+    OVERLAYAZ_CONF_MARKER_OCCLUSION_DIM  = 1,
+    OVERLAYAZ_CONF_MARKER_OCCLUSION_HIDE = 2
+};
+
 void overlayaz_conf_init(const gchar*);
 void overlayaz_conf_free(void);
 
@@ -55,6 +62,18 @@ gboolean overlayaz_conf_set_longitude(gdouble);
 gdouble overlayaz_conf_get_altitude(void);
 gboolean overlayaz_conf_set_altitude(gdouble);
 
+gint overlayaz_conf_get_marker_occlusion(void);
+gboolean overlayaz_conf_set_marker_occlusion(gint);
+
+gboolean overlayaz_conf_get_horizon(void);
+gboolean overlayaz_conf_set_horizon(gboolean);
+
+gdouble overlayaz_conf_get_horizon_distance(void);
+gboolean overlayaz_conf_set_horizon_distance(gdouble);
+
+gint overlayaz_conf_get_depth_resolution(void);
+gboolean overlayaz_conf_set_depth_resolution(gint);
+
 gboolean overlayaz_conf_get_dark_theme(void);
 gboolean overlayaz_conf_set_dark_theme(gboolean);
 
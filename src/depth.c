@@ -0,0 +1,507 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include <gtk/gtk.h>
+#include <math.h>
+#include <string.h>
+#include "depth.h"
+#include "srtm.h"
+#include "viewshed.h"
+#include "terrain-queue.h"
+
+#define DEPTH_MAGIC        "OVLZDPT2"
+#define DEPTH_MAGIC_LEN    8
+#define DEPTH_TILE_COLUMNS 16
+#define DEPTH_MAX_ANGLE    89.0
+#define DEPTH_PREPARE      (-1)
+
+enum depth_key
+{
+    DEPTH_KEY_LATITUDE,
+    DEPTH_KEY_LONGITUDE,
+    DEPTH_KEY_ALTITUDE,
+    DEPTH_KEY_AZ_ANGLE,
+    DEPTH_KEY_AZ_RATIO,
+    DEPTH_KEY_EL_ANGLE,
+    DEPTH_KEY_EL_RATIO,
+    DEPTH_KEY_WIDTH,
+    DEPTH_KEY_HEIGHT,
+    DEPTH_KEY_CELL,
+    DEPTH_KEY_RANGE,
+    DEPTH_KEY_DIRECTORY,
+    DEPTH_KEY_SIZE
+};
+
+struct depth_raster
+{
+    gdouble key[DEPTH_KEY_SIZE];
+    gint columns;
+    gint rows;
+    gfloat *data;
+};
+
+/* A job is freed by its last task, the queue lock guards the task count */
+struct depth_job
+{
+    struct depth_raster *raster;
+    gchar *directory;
+    gchar *path;
+    gdouble *azimuth;
+    gdouble *slope;
+    gdouble observer;
+    guint generation;
+    gint tasks;
+    gint missing;
+};
+
+struct depth_task
+{
+    struct depth_job *job;
+    gint tile;
+};
+
+/* The terrain settings are kept in memory, so that the
+   pointer motion handler only compares keys and reads a cell */
+struct depth
+{
+    struct overlayaz_terrain_queue queue;
+    gchar *directory;
+    gdouble directory_key;
+    gint resolution;
+    gdouble distance;
+    struct depth_raster *raster;
+    struct depth_job *job;
+};
+
+static struct depth depth;
+
+static gboolean depth_key(const overlayaz_t*, gdouble*);
+static enum overlayaz_depth_state depth_lookup(const struct depth_raster*, gdouble, gdouble, gdouble*);
+static struct depth_job* depth_job_new(const overlayaz_t*, const gdouble*);
+static void depth_job_free(struct depth_job*);
+static void depth_job_push(struct depth_job*, gint);
+static void depth_worker(gpointer, gpointer);
+static struct depth_raster* depth_job_prepare(struct depth_job*);
+static void depth_job_trace(struct depth_job*, gint);
+static void depth_job_finish(struct depth_job*, struct depth_raster*);
+static struct depth_raster* depth_raster_new(const gdouble*);
+static void depth_raster_free(struct depth_raster*);
+static struct depth_raster* depth_raster_read(const gchar*);
+static void depth_raster_write(const struct depth_raster*, const gchar*);
+
+
+enum overlayaz_depth_state
+overlayaz_depth_get(const overlayaz_t *o,
+                    gdouble            x,
+                    gdouble            y,
+                    gdouble           *distance)
+{
+    enum overlayaz_depth_state state = OVERLAYAZ_DEPTH_PENDING;
+    gdouble key[DEPTH_KEY_SIZE];
+
+    *distance = NAN;
+
+    overlayaz_terrain_queue_lock(&depth.queue);
+
+    if (!depth_key(o, key))
+        state = OVERLAYAZ_DEPTH_UNAVAILABLE;
+    else if (depth.raster && memcmp(depth.raster->key, key, sizeof(key)) == 0)
+        state = depth_lookup(depth.raster, x, y, distance);
+    else if (depth.job == NULL || memcmp(depth.job->raster->key, key, sizeof(key)) != 0)
+    {
+        /* Results of an outdated job are dropped, its remaining tasks are skipped */
+        if (depth.job)
+            overlayaz_terrain_queue_reset(&depth.queue);
+
+        depth.job = depth_job_new(o, key);
+        depth_job_push(depth.job, DEPTH_PREPARE);
+    }
+
+    overlayaz_terrain_queue_unlock(&depth.queue);
+    return state;
+}
+
+void
+overlayaz_depth_set_terrain(const gchar *directory,
+                            gint         resolution,
+                            gdouble      distance)
+{
+    overlayaz_terrain_queue_lock(&depth.queue);
+
+    g_free(depth.directory);
+    depth.directory = (directory && strlen(directory) ? g_strdup(directory) : NULL);
+    depth.directory_key = (depth.directory ? g_str_hash(depth.directory) : 0);
+    depth.resolution = MAX(resolution, 1);
+    depth.distance = distance;
+
+    /* Tiles may have been added since, the distance map is traced again */
+    overlayaz_terrain_queue_reset(&depth.queue);
+    depth_raster_free(depth.raster);
+    depth.raster = NULL;
+    depth.job = NULL;
+
+    overlayaz_terrain_queue_unlock(&depth.queue);
+}
+
+void
+overlayaz_depth_set_notify(overlayaz_terrain_notify_t notify,
+                           gpointer                   data)
+{
+    overlayaz_terrain_queue_set_notify(&depth.queue, notify, data);
+}
+
+void
+overlayaz_depth_free(void)
+{
+    /* Pending jobs free themselves while the pool is shut down */
+    overlayaz_terrain_queue_free(&depth.queue);
+
+    overlayaz_terrain_queue_lock(&depth.queue);
+    depth_raster_free(depth.raster);
+    g_free(depth.directory);
+    depth.raster = NULL;
+    depth.job = NULL;
+    depth.directory = NULL;
+    overlayaz_terrain_queue_unlock(&depth.queue);
+}
+
+static gboolean
+depth_key(const overlayaz_t *o,
+          gdouble           *key)
+{
+    struct overlayaz_location home;
+
+    memset(key, 0, sizeof(gdouble) * DEPTH_KEY_SIZE);
+
+    if (depth.directory == NULL ||
+        !overlayaz_get_image(o) ||
+        !overlayaz_get_location(o, &home) ||
+        !overlayaz_get_ratio(o, OVERLAYAZ_REF_AZ, &key[DEPTH_KEY_AZ_RATIO]) ||
+        !overlayaz_get_ratio(o, OVERLAYAZ_REF_EL, &key[DEPTH_KEY_EL_RATIO]))
+        return FALSE;
+
+    key[DEPTH_KEY_LATITUDE] = home.latitude;
+    key[DEPTH_KEY_LONGITUDE] = home.longitude;
+    key[DEPTH_KEY_ALTITUDE] = home.altitude;
+    overlayaz_get_angle(o, OVERLAYAZ_REF_AZ, 0.0, &key[DEPTH_KEY_AZ_ANGLE]);
+    overlayaz_get_angle(o, OVERLAYAZ_REF_EL, 0.0, &key[DEPTH_KEY_EL_ANGLE]);
+    key[DEPTH_KEY_WIDTH] = overlayaz_get_width(o);
+    key[DEPTH_KEY_HEIGHT] = overlayaz_get_height(o);
+    key[DEPTH_KEY_CELL] = depth.resolution;
+    key[DEPTH_KEY_RANGE] = depth.distance;
+    key[DEPTH_KEY_DIRECTORY] = depth.directory_key;
+    return TRUE;
+}
+
+static enum overlayaz_depth_state
+depth_lookup(const struct depth_raster *raster,
+             gdouble                    x,
+             gdouble                    y,
+             gdouble                   *distance)
+{
+    gint column = (gint)floor(x / raster->key[DEPTH_KEY_CELL]);
+    gint row = (gint)floor(y / raster->key[DEPTH_KEY_CELL]);
+
+    if (column < 0 || column >= raster->columns ||
+        row < 0 || row >= raster->rows)
+        return OVERLAYAZ_DEPTH_UNAVAILABLE;
+
+    /* NAN stands for the sky (or elevation data missing in the memory-only map) */
+    *distance = raster->data[(gsize)row * raster->columns + column];
+    return OVERLAYAZ_DEPTH_READY;
+}
+
+static struct depth_job*
+depth_job_new(const overlayaz_t *o,
+              const gdouble     *key)
+{
+    struct depth_job *job = g_malloc0(sizeof(struct depth_job));
+    gdouble cell = key[DEPTH_KEY_CELL];
+    gdouble angle;
+    gint i;
+
+    job->raster = depth_raster_new(key);
+    job->directory = g_strdup(depth.directory);
+    job->generation = overlayaz_terrain_queue_generation(&depth.queue);
+    if (overlayaz_get_filename(o))
+        job->path = g_strdup_printf("%s%s", overlayaz_get_filename(o), OVERLAYAZ_EXTENSION_DEPTH);
+
+    /* Angles are taken in the middle of each cell */
+    job->azimuth = g_new(gdouble, job->raster->columns);
+    for (i = 0; i < job->raster->columns; i++)
+        overlayaz_get_angle(o, OVERLAYAZ_REF_AZ, (i + 0.5) * cell, &job->azimuth[i]);
+
+    job->slope = g_new(gdouble, job->raster->rows);
+    for (i = 0; i < job->raster->rows; i++)
+    {
+        overlayaz_get_angle(o, OVERLAYAZ_REF_EL, (i + 0.5) * cell, &angle);
+        angle = CLAMP(angle, -DEPTH_MAX_ANGLE, DEPTH_MAX_ANGLE);
+        job->slope[i] = tan(angle * G_PI / 180.0);
+    }
+
+    return job;
+}
+
+static void
+depth_job_free(struct depth_job *job)
+{
+    depth_raster_free(job->raster);
+    g_free(job->directory);
+    g_free(job->path);
+    g_free(job->azimuth);
+    g_free(job->slope);
+    g_free(job);
+}
+
+static void
+depth_job_push(struct depth_job *job,
+               gint              tile)
+{
+    struct depth_task *task = g_new(struct depth_task, 1);
+
+    task->job = job;
+    task->tile = tile;
+    job->tasks++;
+    overlayaz_terrain_queue_push(&depth.queue, depth_worker, task);
+}
+
+static void
+depth_worker(gpointer data,
+             gpointer user_data)
+{
+    struct depth_task *task = (struct depth_task*)data;
+    struct depth_raster *cached = NULL;
+    gboolean stale;
+
+    overlayaz_terrain_queue_lock(&depth.queue);
+    stale = (task->job->generation != overlayaz_terrain_queue_generation(&depth.queue));
+    overlayaz_terrain_queue_unlock(&depth.queue);
+
+    if (!stale)
+    {
+        if (task->tile == DEPTH_PREPARE)
+            cached = depth_job_prepare(task->job);
+        else
+            depth_job_trace(task->job, task->tile);
+    }
+
+    depth_job_finish(task->job, cached);
+    g_free(task);
+}
+
+static struct depth_raster*
+depth_job_prepare(struct depth_job *job)
+{
+    overlayaz_srtm_sampler_t *sampler;
+    struct overlayaz_location home;
+    struct depth_raster *raster;
+    gint tiles, i;
+
+    /* A distance map saved next to the image is used if it is still valid */
+    raster = (job->path ? depth_raster_read(job->path) : NULL);
+    if (raster && memcmp(raster->key, job->raster->key, sizeof(raster->key)) == 0)
+        return raster;
+    depth_raster_free(raster);
+
+    home.latitude = job->raster->key[DEPTH_KEY_LATITUDE];
+    home.longitude = job->raster->key[DEPTH_KEY_LONGITUDE];
+    home.altitude = job->raster->key[DEPTH_KEY_ALTITUDE];
+    sampler = overlayaz_srtm_sampler_new(job->directory);
+    job->observer = overlayaz_viewshed_observer(sampler, &home);
+    overlayaz_srtm_sampler_free(sampler);
+
+    /* Strips of columns are traced in parallel, unless the job got outdated meanwhile */
+    tiles = (job->raster->columns + DEPTH_TILE_COLUMNS - 1) / DEPTH_TILE_COLUMNS;
+    overlayaz_terrain_queue_lock(&depth.queue);
+    if (job->generation == overlayaz_terrain_queue_generation(&depth.queue))
+    {
+        for (i = 0; i < tiles; i++)
+            depth_job_push(job, i);
+    }
+    overlayaz_terrain_queue_unlock(&depth.queue);
+    return NULL;
+}
+
+static void
+depth_job_trace(struct depth_job *job,
+                gint              tile)
+{
+    struct depth_raster *raster = job->raster;
+    overlayaz_srtm_sampler_t *sampler;
+    gdouble *profile;
+    gdouble max_slope;
+    gint samples, missing = 0;
+    gint column, row, step, i;
+
+    samples = (gint)(raster->key[DEPTH_KEY_RANGE] / OVERLAYAZ_VIEWSHED_STEP);
+    profile = g_new(gdouble, MAX(samples, 1));
+    sampler = overlayaz_srtm_sampler_new(job->directory);
+
+    /* Rows are visited from the lowest elevation angle upwards */
+    step = (raster->rows > 1 && job->slope[0] > job->slope[raster->rows-1]) ? -1 : 1;
+
+    for (column = tile * DEPTH_TILE_COLUMNS; column < MIN((tile + 1) * DEPTH_TILE_COLUMNS, raster->columns); column++)
+    {
+        missing += overlayaz_viewshed_ray(sampler,
+                                          raster->key[DEPTH_KEY_LATITUDE],
+                                          raster->key[DEPTH_KEY_LONGITUDE],
+                                          job->observer,
+                                          job->azimuth[column],
+                                          raster->key[DEPTH_KEY_RANGE],
+                                          profile,
+                                          &max_slope);
+
+        /* The line of sight of a row meets the terrain at the first
+           sample where the running maximum slope reaches its own */
+        row = (step < 0 ? raster->rows - 1 : 0);
+        max_slope = -G_MAXDOUBLE;
+        for (i = 0; i < samples && row >= 0 && row < raster->rows; i++)
+        {
+            max_slope = MAX(max_slope, profile[i]);
+            while (row >= 0 && row < raster->rows && job->slope[row] <= max_slope)
+            {
+                raster->data[(gsize)row * raster->columns + column] = (gfloat)((i + 1) * OVERLAYAZ_VIEWSHED_STEP);
+                row += step;
+            }
+        }
+
+        for (; row >= 0 && row < raster->rows; row += step)
+            raster->data[(gsize)row * raster->columns + column] = NAN;
+    }
+
+    overlayaz_srtm_sampler_free(sampler);
+    g_free(profile);
+    g_atomic_int_add(&job->missing, missing);
+}
+
+static void
+depth_job_finish(struct depth_job    *job,
+                 struct depth_raster *cached)
+{
+    gboolean last, current;
+
+    overlayaz_terrain_queue_lock(&depth.queue);
+    last = (--job->tasks == 0);
+    current = (job->generation == overlayaz_terrain_queue_generation(&depth.queue));
+    overlayaz_terrain_queue_unlock(&depth.queue);
+
+    /* NAN stands for the sky, a map traced with missing tiles is not saved */
+    if (last && current && !cached && job->path && g_atomic_int_get(&job->missing) == 0)
+        depth_raster_write(job->raster, job->path);
+
+    overlayaz_terrain_queue_lock(&depth.queue);
+    if (last && job->generation == overlayaz_terrain_queue_generation(&depth.queue))
+    {
+        depth_raster_free(depth.raster);
+        depth.raster = (cached ? cached : job->raster);
+        if (!cached)
+            job->raster = NULL;
+        cached = NULL;
+    }
+    if (last && depth.job == job)
+        depth.job = NULL;
+    overlayaz_terrain_queue_done(&depth.queue);
+    overlayaz_terrain_queue_unlock(&depth.queue);
+
+    depth_raster_free(cached);
+    if (last)
+        depth_job_free(job);
+}
+
+static struct depth_raster*
+depth_raster_new(const gdouble *key)
+{
+    struct depth_raster *raster = g_malloc0(sizeof(struct depth_raster));
+
+    memcpy(raster->key, key, sizeof(raster->key));
+    raster->columns = (gint)ceil(key[DEPTH_KEY_WIDTH] / key[DEPTH_KEY_CELL]);
+    raster->rows = (gint)ceil(key[DEPTH_KEY_HEIGHT] / key[DEPTH_KEY_CELL]);
+    raster->data = g_new(gfloat, (gsize)raster->columns * raster->rows);
+    return raster;
+}
+
+static void
+depth_raster_free(struct depth_raster *raster)
+{
+    if (raster)
+    {
+        g_free(raster->data);
+        g_free(raster);
+    }
+}
+
+/* The cache file is a plain dump in the native byte order:
+   magic, key, raster data (columns * rows floats). */
+static struct depth_raster*
+depth_raster_read(const gchar *path)
+{
+    struct depth_raster *raster;
+    gchar *contents;
+    gsize length;
+    gdouble key[DEPTH_KEY_SIZE];
+
+    if (!g_file_get_contents(path, &contents, &length, NULL))
+        return NULL;
+
+    if (length < DEPTH_MAGIC_LEN + sizeof(key) ||
+        memcmp(contents, DEPTH_MAGIC, DEPTH_MAGIC_LEN) != 0)
+    {
+        g_free(contents);
+        return NULL;
+    }
+
+    memcpy(key, contents + DEPTH_MAGIC_LEN, sizeof(key));
+    if (!(key[DEPTH_KEY_CELL] >= 1.0) ||
+        !(key[DEPTH_KEY_WIDTH] >= 1.0 && key[DEPTH_KEY_WIDTH] <= G_MAXINT) ||
+        !(key[DEPTH_KEY_HEIGHT] >= 1.0 && key[DEPTH_KEY_HEIGHT] <= G_MAXINT))
+    {
+        g_free(contents);
+        return NULL;
+    }
+
+    raster = depth_raster_new(key);
+    if (length != DEPTH_MAGIC_LEN + sizeof(key) + sizeof(gfloat) * raster->columns * raster->rows)
+    {
+        g_warning("%s: Invalid size of %s", __func__, path);
+        depth_raster_free(raster);
+        g_free(contents);
+        return NULL;
+    }
+
+    memcpy(raster->data, contents + DEPTH_MAGIC_LEN + sizeof(key), sizeof(gfloat) * raster->columns * raster->rows);
+    g_free(contents);
+    return raster;
+}
+
+static void
+depth_raster_write(const struct depth_raster *raster,
+                   const gchar               *path)
+{
+    GByteArray *contents;
+    GError *error = NULL;
+
+    contents = g_byte_array_new();
+    g_byte_array_append(contents, (const guint8*)DEPTH_MAGIC, DEPTH_MAGIC_LEN);
+    g_byte_array_append(contents, (const guint8*)raster->key, sizeof(raster->key));
+    g_byte_array_append(contents, (const guint8*)raster->data, sizeof(gfloat) * raster->columns * raster->rows);
+
+    if (!g_file_set_contents(path, (const gchar*)contents->data, contents->len, &error))
+    {
+        g_warning("%s: %s", __func__, error->message);
+        g_error_free(error);
+    }
+
+    g_byte_array_free(contents, TRUE);
+}
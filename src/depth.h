@@ -0,0 +1,35 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef OVERLAYAZ_DEPTH_H_
+#define OVERLAYAZ_DEPTH_H_
+#include "overlayaz.h"
+#include "terrain-queue.h"
+
+#define OVERLAYAZ_EXTENSION_DEPTH ".depth"
+
+enum overlayaz_depth_state
+{
+    OVERLAYAZ_DEPTH_UNAVAILABLE,
+    OVERLAYAZ_DEPTH_PENDING,
+    OVERLAYAZ_DEPTH_READY
+};
+
+enum overlayaz_depth_state overlayaz_depth_get(const overlayaz_t*, gdouble, gdouble, gdouble*);
+void overlayaz_depth_set_terrain(const gchar*, gint, gdouble);
+void overlayaz_depth_set_notify(overlayaz_terrain_notify_t, gpointer);
+void overlayaz_depth_free(void);
+
+#endif
@@ -33,8 +33,12 @@ struct overlayaz_dialog_alt
     GtkWidget *spin_asl;
     GtkWidget *spin_agl;
     GtkWidget *spin_total;
+    gdouble latitude;
+    gdouble longitude;
 };
 
+static void dialog_alt_lookup_ready(GObject*, GAsyncResult*, gpointer);
+static gchar* dialog_alt_status(enum overlayaz_srtm_error, gdouble, gdouble);
 static void dialog_alt_spin_changed(GtkSpinButton*, gpointer);
 
 
@@ -46,12 +50,9 @@ overlayaz_dialog_alt(GtkWindow *parent,
 {
     GtkWidget *content_area;
     struct overlayaz_dialog_alt d;
+    GCancellable *cancellable;
     gint grid_pos;
-    enum overlayaz_srtm_error error;
-    gdouble hasl;
     gchar *directory;
-    gchar *filename;
-    gchar *markup;
     gboolean ret = FALSE;
 
     d.dialog = gtk_dialog_new_with_buttons("Altitude",
@@ -69,7 +70,10 @@ overlayaz_dialog_alt(GtkWindow *parent,
     gtk_window_set_title(GTK_WINDOW(d.dialog), "Altitude");
 
     content_area = gtk_dialog_get_content_area(GTK_DIALOG(d.dialog));
+    d.latitude = latitude;
+    d.longitude = longitude;
     d.label_srtm = gtk_label_new(NULL);
+    gtk_label_set_markup(GTK_LABEL(d.label_srtm), "SRTM status: <b>Lookup in progress…</b>");
     gtk_box_pack_start(GTK_BOX(content_area), d.label_srtm, FALSE, FALSE, OVERLAYAZ_WINDOW_DIALOG_MARGIN);
 
     d.grid = gtk_grid_new();
@@ -112,18 +116,67 @@ overlayaz_dialog_alt(GtkWindow *parent,
     gtk_spin_button_set_value(GTK_SPIN_BUTTON(d.spin_asl), 0.0);
     gtk_widget_grab_focus(d.spin_asl);
 
+    /* The altitude is filled in once the lookup finishes */
+    cancellable = g_cancellable_new();
     directory = overlayaz_conf_get_srtm_path();
+    overlayaz_srtm_lookup_async(directory, latitude, longitude, cancellable, dialog_alt_lookup_ready, &d);
+    g_free(directory);
+
+    if (gtk_dialog_run(GTK_DIALOG(d.dialog)) == GTK_RESPONSE_APPLY)
+    {
+        *out = gtk_spin_button_get_value(GTK_SPIN_BUTTON(d.spin_total));
+        ret = TRUE;
+    }
+
+    g_cancellable_cancel(cancellable);
+    g_object_unref(cancellable);
+    gtk_widget_destroy(d.dialog);
+    return ret;
+}
+
+static void
+dialog_alt_lookup_ready(GObject      *source_object,
+                        GAsyncResult *result,
+                        gpointer      user_data)
+{
+    struct overlayaz_dialog_alt *a = (struct overlayaz_dialog_alt*)user_data;
+    enum overlayaz_srtm_error error;
+    gdouble hasl;
+    gchar *markup;
+
+    error = overlayaz_srtm_lookup_finish(result, &hasl);
+    if (error == OVERLAYAZ_SRTM_ERROR_CANCELLED)
+    {
+        /* The dialog is already gone */
+        return;
+    }
+
+    /* Do not overwrite a value entered in the meantime */
+    if (error == OVERLAYAZ_SRTM_OK &&
+        gtk_spin_button_get_value(GTK_SPIN_BUTTON(a->spin_asl)) == 0.0)
+    {
+        gtk_spin_button_set_value(GTK_SPIN_BUTTON(a->spin_asl), hasl);
+        gtk_widget_grab_focus(a->spin_agl);
+    }
+
+    markup = dialog_alt_status(error, a->latitude, a->longitude);
+    gtk_label_set_markup(GTK_LABEL(a->label_srtm), markup);
+    g_free(markup);
+}
+
+static gchar*
+dialog_alt_status(enum overlayaz_srtm_error error,
+                  gdouble                   latitude,
+                  gdouble                   longitude)
+{
+    gchar *filename;
+    gchar *markup;
+
     filename = overlayaz_srtm_filename(latitude, longitude);
-    error = overlayaz_srtm_lookup(directory,
-                                  latitude,
-                                  longitude,
-                                  &hasl);
 
     switch (error)
     {
     case OVERLAYAZ_SRTM_OK:
-        gtk_spin_button_set_value(GTK_SPIN_BUTTON(d.spin_asl), hasl);
-        gtk_widget_grab_focus(d.spin_agl);
         markup = g_markup_printf_escaped("SRTM status: <b>Lookup succeeded</b>");
         break;
 
@@ -157,22 +210,7 @@ overlayaz_dialog_alt(GtkWindow *parent,
     }
 
     g_free(filename);
-    g_free(directory);
-
-    if (markup)
-    {
-        gtk_label_set_markup(GTK_LABEL(d.label_srtm), markup);
-        g_free(markup);
-    }
-
-    if (gtk_dialog_run(GTK_DIALOG(d.dialog)) == GTK_RESPONSE_APPLY)
-    {
-        *out = gtk_spin_button_get_value(GTK_SPIN_BUTTON(d.spin_total));
-        ret = TRUE;
-    }
-
-    gtk_widget_destroy(d.dialog);
-    return ret;
+    return markup;
 }
 
 static void
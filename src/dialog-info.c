@@ -53,8 +53,12 @@ struct overlayaz_dialog_info
     GtkWidget *button_distance;
     GtkWidget *button_location;
     GtkWidget *button_azidist;
+    GCancellable *cancellable;
+    gboolean altitude_ready;
 };
 
+static void dialog_info_lookup_ready(GObject*, GAsyncResult*, gpointer);
+
 static void dialog_info_copy_clicked(GtkButton*, GtkLabel*);
 static void dialog_info_copy_location_clicked(GtkButton *button, struct overlayaz_dialog_info*);
 static void dialog_info_copy_azidist_clicked(GtkButton*, struct overlayaz_dialog_info*);
@@ -72,9 +76,7 @@ overlayaz_dialog_info(GtkWindow *parent,
 {
     struct overlayaz_dialog_info *d = g_malloc0(sizeof(struct overlayaz_dialog_info));
     GtkWidget *content_area;
-    enum overlayaz_srtm_error error;
-    gchar *text, *text2, *directory, *filename;
-    gdouble altitude;
+    gchar *text, *text2, *directory;
     gint grid_pos = -1;
     gint pos_latitude = -1;
     gint pos_azimuth = -1;
@@ -188,31 +190,23 @@ overlayaz_dialog_info(GtkWindow *parent,
     if(!isnan(latitude) &&
        !isnan(longitude))
     {
+        d->label_altitude = gtk_label_new("Altitude:");
+        gtk_widget_set_halign(GTK_WIDGET(d->label_altitude), GTK_ALIGN_START);
+        gtk_grid_attach(GTK_GRID(d->grid), d->label_altitude, 1, ++grid_pos, 1, 1);
+
+        d->label_altitude_value = gtk_label_new(NULL);
+        gtk_label_set_markup(GTK_LABEL(d->label_altitude_value), "<b>…</b>");
+        gtk_grid_attach(GTK_GRID(d->grid), d->label_altitude_value, 2, grid_pos, 1, 1);
+
+        d->button_altitude = gtk_button_new_from_icon_name("edit-copy", OVERLAYAZ_WINDOW_BUTTON_IMAGE);
+        gtk_widget_set_sensitive(d->button_altitude, FALSE);
+        gtk_grid_attach(GTK_GRID(d->grid), d->button_altitude, 3, grid_pos, 1, 1);
+        g_signal_connect(d->button_altitude, "clicked", G_CALLBACK(dialog_info_copy_clicked), d->label_altitude_value);
+
+        /* The altitude is filled in once the lookup finishes */
+        d->cancellable = g_cancellable_new();
         directory = overlayaz_conf_get_srtm_path();
-        filename = overlayaz_srtm_filename(latitude, longitude);
-        error = overlayaz_srtm_lookup(directory,
-                                      latitude,
-                                      longitude,
-                                      &altitude);
-
-        if (error == OVERLAYAZ_SRTM_OK)
-        {
-            d->label_altitude = gtk_label_new("Altitude:");
-            gtk_widget_set_halign(GTK_WIDGET(d->label_altitude), GTK_ALIGN_START);
-            gtk_grid_attach(GTK_GRID(d->grid), d->label_altitude, 1, ++grid_pos, 1, 1);
-
-            d->label_altitude_value = gtk_label_new(NULL);
-            gtk_grid_attach(GTK_GRID(d->grid), d->label_altitude_value, 2, grid_pos, 1, 1);
-
-            text = g_strdup_printf("<b>%g m</b>", altitude);
-            gtk_label_set_markup(GTK_LABEL(d->label_altitude_value), text);
-            g_free(text);
-
-            d->button_altitude = gtk_button_new_from_icon_name("edit-copy", OVERLAYAZ_WINDOW_BUTTON_IMAGE);
-            gtk_grid_attach(GTK_GRID(d->grid), d->button_altitude, 3, grid_pos, 1, 1);
-            g_signal_connect(d->button_altitude, "clicked", G_CALLBACK(dialog_info_copy_clicked), d->label_altitude_value);
-        }
-        g_free(filename);
+        overlayaz_srtm_lookup_async(directory, latitude, longitude, d->cancellable, dialog_info_lookup_ready, d);
         g_free(directory);
     }
 
@@ -298,11 +292,49 @@ overlayaz_dialog_info(GtkWindow *parent,
     gtk_widget_show_all(d->dialog);
     gtk_widget_grab_focus(gtk_dialog_get_widget_for_response(GTK_DIALOG(d->dialog), GTK_RESPONSE_NONE));
     gtk_dialog_run(GTK_DIALOG(d->dialog));
+
+    if (d->cancellable)
+    {
+        g_cancellable_cancel(d->cancellable);
+        g_object_unref(d->cancellable);
+    }
     gtk_widget_destroy(d->dialog);
     
     g_free(d);
 }
 
+static void
+dialog_info_lookup_ready(GObject      *source_object,
+                         GAsyncResult *result,
+                         gpointer      user_data)
+{
+    struct overlayaz_dialog_info *d = (struct overlayaz_dialog_info*)user_data;
+    enum overlayaz_srtm_error error;
+    gdouble altitude;
+    gchar *text;
+
+    error = overlayaz_srtm_lookup_finish(result, &altitude);
+    if (error == OVERLAYAZ_SRTM_ERROR_CANCELLED)
+    {
+        /* The dialog is already gone */
+        return;
+    }
+
+    if (error != OVERLAYAZ_SRTM_OK)
+    {
+        gtk_widget_hide(d->label_altitude);
+        gtk_widget_hide(d->label_altitude_value);
+        gtk_widget_hide(d->button_altitude);
+        return;
+    }
+
+    text = g_strdup_printf("<b>%g m</b>", altitude);
+    gtk_label_set_markup(GTK_LABEL(d->label_altitude_value), text);
+    g_free(text);
+
+    gtk_widget_set_sensitive(d->button_altitude, TRUE);
+    d->altitude_ready = TRUE;
+}
 
 static void
 dialog_info_copy_clicked(GtkButton *button,
@@ -325,8 +357,8 @@ dialog_info_copy_location_clicked(GtkButton                    *button,
         text = g_strdup_printf("%s %s%s%s",
                                gtk_label_get_text(GTK_LABEL(d->label_latitude_value)),
                                gtk_label_get_text(GTK_LABEL(d->label_longitude_value)),
-                               (d->label_altitude_value ? " " : ""),
-                               (d->label_altitude_value ? gtk_label_get_text(GTK_LABEL(d->label_altitude_value)) : ""));
+                               (d->altitude_ready ? " " : ""),
+                               (d->altitude_ready ? gtk_label_get_text(GTK_LABEL(d->label_altitude_value)) : ""));
         gtk_clipboard_set_text(clipboard, text, -1);
         g_free(text);
     }
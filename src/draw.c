@@ -17,48 +17,78 @@
 #include <math.h>
 #include "draw.h"
 #include "overlayaz.h"
-#include "geo.h"
-#include "marker-iter.h"
 #include "util.h"
 #include "ui-util.h"
+#include "conf.h"
+#include "viewshed.h"
+#include "horizon.h"
+
+#define DRAW_MARKER_DIM_ALPHA 0.35
+#define DRAW_HORIZON_STEP     2
 
 static void draw_grid(cairo_t*, const overlayaz_t*, enum overlayaz_ref_type);
-static void draw_markers(cairo_t*, const overlayaz_t*);
-gchar* format_marker_text(const overlayaz_marker_t*, gdouble, gdouble);
+static void draw_horizon(cairo_t*, const overlayaz_t*, const cairo_rectangle_t*, gboolean);
+static void draw_markers(cairo_t*, const overlayaz_t*, const cairo_rectangle_t*, gboolean);
+static PangoLayout* draw_markers_label(cairo_t*, const overlayaz_t*, const struct overlayaz_marker_arrays*, gint, gdouble*, gdouble*);
+static void draw_markers_extents(PangoLayout*, gdouble, gdouble, cairo_rectangle_int_t*);
+static struct overlayaz_viewshed* draw_markers_viewshed(const overlayaz_t*, const struct overlayaz_location*, gboolean);
+gchar* format_marker_text(const struct overlayaz_marker_arrays*, gint, gdouble, gdouble);
+
+
+gboolean
+overlayaz_draw_marker_extents(const overlayaz_t     *o,
+                              gint                   id,
+                              cairo_rectangle_int_t *out)
+{
+    struct overlayaz_marker_arrays markers;
+    PangoLayout *layout;
+    gdouble x, y;
 
+    overlayaz_marker_store_get_arrays(overlayaz_get_marker_store(o), &markers);
+    if (!overlayaz_get_location(o, NULL) ||
+        id < 0 || id >= markers.count ||
+        !(markers.flags[id] & OVERLAYAZ_MARKER_ACTIVE))
+        return FALSE;
 
-void
-overlayaz_draw(cairo_t           *cr,
-               cairo_filter_t     filter,
-               cairo_surface_t   *cache,
-               const overlayaz_t *o)
-{
-    const GdkPixbuf *pixbuf;
-    gint width, height;
+    layout = draw_markers_label(NULL, o, &markers, id, &x, &y);
+    if (layout == NULL)
+        return FALSE;
 
-    pixbuf = overlayaz_get_pixbuf(o);
-    if (pixbuf == NULL)
-        return;
+    draw_markers_extents(layout, x, y, out);
+    return TRUE;
+}
 
-    width = overlayaz_get_width(o);
-    height = overlayaz_get_height(o);
+void
+overlayaz_draw_rotate(cairo_t           *cr,
+                      const overlayaz_t *o)
+{
+    gint width = overlayaz_get_width(o);
+    gint height = overlayaz_get_height(o);
 
-    cairo_save(cr);
     cairo_translate(cr, width/2.0,  height/2.0);
     cairo_rotate(cr, overlayaz_get_rotation(o) * G_PI / 180.0);
+    cairo_translate(cr, -width/2.0, -height/2.0);
+}
 
-    if (cache)
-        cairo_set_source_surface(cr, cache, -width/2.0, -height/2.0);
-    else
-        gdk_cairo_set_source_pixbuf(cr, pixbuf, -width/2.0, -height/2.0);
+void
+overlayaz_draw_overlay(cairo_t           *cr,
+                       const overlayaz_t *o,
+                       gboolean           wait)
+{
+    cairo_rectangle_t area;
+    gdouble x1, y1, x2, y2;
 
-    cairo_pattern_set_filter(cairo_get_source(cr), filter);
-    cairo_paint(cr);
-    cairo_restore(cr);
+    /* Only the clipped area is drawn (e.g. a strip of the export) */
+    cairo_clip_extents(cr, &x1, &y1, &x2, &y2);
+    area.x = x1;
+    area.y = y1;
+    area.width = x2 - x1;
+    area.height = y2 - y1;
 
     draw_grid(cr, o, OVERLAYAZ_REF_AZ);
     draw_grid(cr, o, OVERLAYAZ_REF_EL);
-    draw_markers(cr, o);
+    draw_horizon(cr, o, &area, wait);
+    draw_markers(cr, o, &area, wait);
 }
 
 static void
@@ -75,7 +105,7 @@ draw_grid(cairo_t                 *cr,
     gdouble angle;
     gdouble pos;
     gchar buff[G_ASCII_DTOSTR_BUF_SIZE];
-    gchar *text;
+    gchar text[G_ASCII_DTOSTR_BUF_SIZE + 8];
     gint layout_width, layout_height;
     gdouble text_width, text_height;
     gdouble offset;
@@ -88,9 +118,6 @@ draw_grid(cairo_t                 *cr,
     width = overlayaz_get_width(o);
     height = overlayaz_get_height(o);
 
-    layout = pango_cairo_create_layout(cr);
-    pango_layout_set_font_description(layout, overlayaz_font_get_pango(overlayaz_get_grid_font(o)));
-
     text_pos = 0.0;
     for (i = 0; i < count; i++)
     {
@@ -115,8 +142,8 @@ draw_grid(cairo_t                 *cr,
 
         gdk_cairo_set_source_rgba(cr, overlayaz_get_grid_font_color(o));
         g_ascii_formatd(buff, sizeof(buff), "%g", fmod(angle, 360.0));
-        text = g_strdup_printf("%s°", buff);
-        pango_layout_set_text(layout, text, -1);
+        g_snprintf(text, sizeof(text), "%s°", buff);
+        layout = overlayaz_font_get_layout(overlayaz_get_grid_font(o), cr, text, PANGO_ALIGN_LEFT);
         pango_layout_get_size(layout, &layout_width, &layout_height);
         text_width = (gdouble)layout_width / PANGO_SCALE;
         text_height = (gdouble)layout_height / PANGO_SCALE;
@@ -148,121 +175,301 @@ draw_grid(cairo_t                 *cr,
                 text_pos = y + text_height;
             }
         }
-        g_free(text);
     }
-    g_object_unref(layout);
 }
 
 static void
-draw_markers(cairo_t           *cr,
-             const overlayaz_t *o)
+draw_horizon(cairo_t                 *cr,
+             const overlayaz_t       *o,
+             const cairo_rectangle_t *area,
+             gboolean                 wait)
 {
-    overlayaz_marker_iter_t *iter;
     struct overlayaz_location home;
-    gint height;
+    gchar *directory;
+    gdouble *azimuth, *elevation;
+    gint width, count;
+    gint first, last;
+    gdouble margin;
+    gdouble x, y;
+    gboolean drawing;
+    gint i;
+
+    if (!overlayaz_conf_get_horizon() ||
+        !overlayaz_get_location(o, &home) ||
+        !overlayaz_get_ratio(o, OVERLAYAZ_REF_AZ, NULL) ||
+        !overlayaz_get_ratio(o, OVERLAYAZ_REF_EL, NULL))
+        return;
+
+    directory = overlayaz_conf_get_srtm_path();
+    if (!strlen(directory))
+    {
+        g_free(directory);
+        return;
+    }
+
+    /* The line is traced across the area, with one more step and the line width on each side */
+    width = overlayaz_get_width(o);
+    margin = DRAW_HORIZON_STEP + overlayaz_get_grid_width(o);
+    first = MAX(0, (gint)floor((area->x - margin) / DRAW_HORIZON_STEP));
+    last = MIN(width / DRAW_HORIZON_STEP, (gint)ceil((area->x + area->width + margin) / DRAW_HORIZON_STEP));
+    if (first > last)
+    {
+        g_free(directory);
+        return;
+    }
+
+    count = last - first + 1;
+    azimuth = g_new(gdouble, count);
+    elevation = g_new(gdouble, count);
+
+    for (i = 0; i < count; i++)
+        overlayaz_get_angle(o, OVERLAYAZ_REF_AZ, MIN((first + i) * DRAW_HORIZON_STEP, width), &azimuth[i]);
+
+    /* Bins still being traced break the line until the redraw */
+    overlayaz_horizon_get(directory, &home, overlayaz_conf_get_horizon_distance() * 1000.0, azimuth, count, wait, elevation);
+
+    gdk_cairo_set_source_rgba(cr, overlayaz_get_grid_color(o));
+    cairo_set_line_width(cr, overlayaz_get_grid_width(o));
+    cairo_set_line_join(cr, CAIRO_LINE_JOIN_ROUND);
+
+    drawing = FALSE;
+    for (i = 0; i < count; i++)
+    {
+        /* Break the line where there is no elevation data or it leaves the image */
+        if (isnan(elevation[i]) || !overlayaz_get_position(o, OVERLAYAZ_REF_EL, elevation[i], &y))
+        {
+            drawing = FALSE;
+            continue;
+        }
+
+        x = MIN((first + i) * DRAW_HORIZON_STEP, width);
+        if (drawing)
+            cairo_line_to(cr, x, y);
+        else
+            cairo_move_to(cr, x, y);
+        drawing = TRUE;
+    }
+    cairo_stroke(cr);
+
+    g_free(azimuth);
+    g_free(elevation);
+    g_free(directory);
+}
+
+static void
+draw_markers(cairo_t                 *cr,
+             const overlayaz_t       *o,
+             const cairo_rectangle_t *area,
+             gboolean                 wait)
+{
+    const overlayaz_marker_store_t *store = overlayaz_get_marker_store(o);
+    struct overlayaz_marker_arrays markers;
+    struct overlayaz_location home;
     PangoLayout *layout;
-    gchar *text;
-    gdouble pos, dist, angle;
-    gint layout_width, layout_height;
-    gdouble lh, x, y;
-    const overlayaz_marker_t *m;
+    cairo_rectangle_int_t extents;
+    gdouble x, y;
+    gint occlusion;
+    struct overlayaz_viewshed *viewshed = NULL;
+    GdkRGBA color;
+    gint id, i = 0;
 
     if (!overlayaz_get_location(o, &home))
         return;
 
-    iter = overlayaz_marker_iter_new(overlayaz_get_marker_list(o), &m);
-    if (iter == NULL)
+    overlayaz_marker_store_get_arrays(store, &markers);
+    if (markers.count == 0)
         return;
 
-    height = overlayaz_get_height(o);
-    layout = pango_cairo_create_layout(cr);
-    pango_layout_set_alignment(layout, PANGO_ALIGN_CENTER);
+    occlusion = overlayaz_conf_get_marker_occlusion();
+    if (occlusion != OVERLAYAZ_CONF_MARKER_OCCLUSION_SHOW)
+        viewshed = draw_markers_viewshed(o, &home, wait);
 
-    do
+    for (id = 0; id < markers.count; id++)
     {
-        if (overlayaz_marker_get_active(m))
+        if (!(markers.flags[id] & OVERLAYAZ_MARKER_ACTIVE))
+            continue;
+
+        color = *overlayaz_marker_style_get_color(overlayaz_get_marker_style(o), markers.style[id]);
+        if (viewshed && viewshed[i++].state == OVERLAYAZ_VIEWSHED_OCCLUDED)
         {
-            overlayaz_geo_inverse(home.latitude, home.longitude,
-                                  overlayaz_marker_get_latitude(m),
-                                  overlayaz_marker_get_longitude(m),
-                                  &angle, NULL, &dist);
+            if (occlusion == OVERLAYAZ_CONF_MARKER_OCCLUSION_HIDE)
+                continue;
+            color.alpha *= DRAW_MARKER_DIM_ALPHA;
+        }
 
-            if (overlayaz_get_position(o, OVERLAYAZ_REF_AZ, angle, &pos))
-            {
-                pango_layout_set_font_description(layout, overlayaz_font_get_pango(overlayaz_marker_get_font(m)));
-                gdk_cairo_set_source_rgba(cr, overlayaz_marker_get_font_color(m));
-                text = format_marker_text(m, angle, dist);
-                if (strlen(text))
-                {
-                    pango_layout_set_text(layout, text, -1);
-                    pango_layout_get_size(layout, &layout_width, &layout_height);
-                    lh = (gdouble)layout_height / PANGO_SCALE;
-
-                    x = pos - (gdouble)layout_width / PANGO_SCALE / 2.0;
-                    y = overlayaz_marker_get_position(m)/100.0 * height;
-
-                    if (overlayaz_marker_get_tick(m) == OVERLAYAZ_MARKER_TICK_NONE)
-                        y -= lh/2;
-                    else if (overlayaz_marker_get_tick(m) == OVERLAYAZ_MARKER_TICK_BOTTOM)
-                        y -= lh;
-
-                    /* Keep text visible within image bounds */
-                    if (y < 0)
-                        y = 0;
-                    else if (y + lh > height)
-                        y = height - lh;
-
-                    cairo_move_to(cr, x, y);
-                    pango_cairo_show_layout(cr, layout);
-                }
-                g_free(text);
-            }
+        layout = draw_markers_label(cr, o, &markers, id, &x, &y);
+        if (layout == NULL)
+            continue;
+
+        /* Labels outside of the area are not rendered */
+        draw_markers_extents(layout, x, y, &extents);
+        if (extents.x > area->x + area->width || extents.x + extents.width < area->x ||
+            extents.y > area->y + area->height || extents.y + extents.height < area->y)
+            continue;
+
+        gdk_cairo_set_source_rgba(cr, &color);
+        cairo_move_to(cr, x, y);
+        pango_cairo_show_layout(cr, layout);
+    }
+
+    g_free(viewshed);
+}
+
+static PangoLayout*
+draw_markers_label(cairo_t                              *cr,
+                   const overlayaz_t                    *o,
+                   const struct overlayaz_marker_arrays *markers,
+                   gint                                  id,
+                   gdouble                              *x,
+                   gdouble                              *y)
+{
+    PangoLayout *layout = NULL;
+    overlayaz_font_t *font;
+    gchar *text;
+    gdouble pos, dist, angle;
+    gint layout_width, layout_height;
+    gint height;
+    gdouble lh;
+
+    angle = markers->azimuth[id];
+    dist = markers->distance[id];
+    if (isnan(angle))
+        return NULL;
+
+    if (!overlayaz_get_position(o, OVERLAYAZ_REF_AZ, angle, &pos))
+        return NULL;
+
+    text = format_marker_text(markers, id, angle, dist);
+    if (strlen(text))
+    {
+        font = overlayaz_marker_style_get_font(overlayaz_get_marker_style(o), markers->style[id]);
+        layout = overlayaz_font_get_layout(font, cr, text, PANGO_ALIGN_CENTER);
+        pango_layout_get_size(layout, &layout_width, &layout_height);
+        lh = (gdouble)layout_height / PANGO_SCALE;
+        height = overlayaz_get_height(o);
+
+        *x = pos - (gdouble)layout_width / PANGO_SCALE / 2.0;
+        *y = markers->position[id]/100.0 * height;
+
+        if (markers->tick[id] == OVERLAYAZ_MARKER_TICK_NONE)
+            *y -= lh/2;
+        else if (markers->tick[id] == OVERLAYAZ_MARKER_TICK_BOTTOM)
+            *y -= lh;
+
+        /* Keep text visible within image bounds */
+        if (*y < 0)
+            *y = 0;
+        else if (*y + lh > height)
+            *y = height - lh;
+    }
+    g_free(text);
+    return layout;
+}
+
+static void
+draw_markers_extents(PangoLayout           *layout,
+                     gdouble                x,
+                     gdouble                y,
+                     cairo_rectangle_int_t *out)
+{
+    PangoRectangle ink, logical;
+    gint x1, y1, x2, y2;
+
+    /* The glyphs may extend beyond the logical extents of the text */
+    pango_layout_get_pixel_extents(layout, &ink, &logical);
+    x1 = MIN(ink.x, logical.x) + (gint)floor(x);
+    y1 = MIN(ink.y, logical.y) + (gint)floor(y);
+    x2 = MAX(ink.x + ink.width, logical.x + logical.width) + (gint)ceil(x);
+    y2 = MAX(ink.y + ink.height, logical.y + logical.height) + (gint)ceil(y);
+
+    out->x = x1;
+    out->y = y1;
+    out->width = x2 - x1;
+    out->height = y2 - y1;
+}
+
+static struct overlayaz_viewshed*
+draw_markers_viewshed(const overlayaz_t               *o,
+                      const struct overlayaz_location *home,
+                      gboolean                         wait)
+{
+    struct overlayaz_marker_arrays markers;
+    gdouble *latitude, *longitude;
+    struct overlayaz_viewshed *viewshed;
+    gchar *directory;
+    gint id, count = 0;
+
+    overlayaz_marker_store_get_arrays(overlayaz_get_marker_store(o), &markers);
+    if (markers.count == 0)
+        return NULL;
+
+    latitude = g_new(gdouble, markers.count);
+    longitude = g_new(gdouble, markers.count);
+
+    for (id = 0; id < markers.count; id++)
+    {
+        if (markers.flags[id] & OVERLAYAZ_MARKER_ACTIVE)
+        {
+            latitude[count] = markers.latitude[id];
+            longitude[count] = markers.longitude[id];
+            count++;
         }
-    } while (overlayaz_marker_iter_next(iter, &m));
+    }
 
-    overlayaz_marker_iter_free(iter);
-    g_object_unref(layout);
+    /* All active markers are traced in parallel, in the background.
+       Markers not traced yet are drawn as unknown until the redraw. */
+    viewshed = g_new(struct overlayaz_viewshed, MAX(count, 1));
+    directory = overlayaz_conf_get_srtm_path();
+    overlayaz_viewshed_check(strlen(directory) ? directory : NULL, home,
+                             latitude, longitude, count,
+                             wait, viewshed);
+
+    g_free(directory);
+    g_free(latitude);
+    g_free(longitude);
+    return viewshed;
 }
 
 gchar*
-format_marker_text(const overlayaz_marker_t *m,
-                   gdouble                   angle,
-                   gdouble                   dist)
+format_marker_text(const struct overlayaz_marker_arrays *markers,
+                   gint                                  id,
+                   gdouble                               angle,
+                   gdouble                               dist)
 {
     GString *string = g_string_new(NULL);
     gchar *text;
 
-    if (overlayaz_marker_get_tick(m) == OVERLAYAZ_MARKER_TICK_TOP)
+    if (markers->tick[id] == OVERLAYAZ_MARKER_TICK_TOP)
         g_string_append(string, "|\n");
 
-    if (strlen(overlayaz_marker_get_name(m)))
+    if (strlen(markers->name[id]))
     {
-        g_string_append(string, overlayaz_marker_get_name(m));
-        if (overlayaz_marker_get_show_azimuth(m) ||
-            overlayaz_marker_get_show_distance(m))
+        g_string_append(string, markers->name[id]);
+        if ((markers->flags[id] & OVERLAYAZ_MARKER_SHOW_AZIMUTH) ||
+            (markers->flags[id] & OVERLAYAZ_MARKER_SHOW_DISTANCE))
         {
             g_string_append(string, "\n");
         }
     }
 
-    if (overlayaz_marker_get_show_azimuth(m))
+    if (markers->flags[id] & OVERLAYAZ_MARKER_SHOW_AZIMUTH)
     {
         text = overlayaz_ui_util_format_angle(angle);
         g_string_append(string, text);
         g_free(text);
 
-        if (overlayaz_marker_get_show_distance(m))
+        if (markers->flags[id] & OVERLAYAZ_MARKER_SHOW_DISTANCE)
             g_string_append(string, "\n");
     }
 
-    if (overlayaz_marker_get_show_distance(m))
+    if (markers->flags[id] & OVERLAYAZ_MARKER_SHOW_DISTANCE)
     {
         text = overlayaz_ui_util_format_distance(dist);
         g_string_append(string, text);
         g_free(text);
     }
 
-    if (overlayaz_marker_get_tick(m) == OVERLAYAZ_MARKER_TICK_BOTTOM)
+    if (markers->tick[id] == OVERLAYAZ_MARKER_TICK_BOTTOM)
         g_string_append(string, "\n|");
 
     return g_string_free(string, FALSE);
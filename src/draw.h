@@ -17,6 +17,8 @@
 #define OVERLAYAZ_DRAW_H_
 #include "overlayaz.h"
 
-void overlayaz_draw(cairo_t*, cairo_filter_t, cairo_surface_t*, const overlayaz_t*);
+void overlayaz_draw_rotate(cairo_t*, const overlayaz_t*);
+void overlayaz_draw_overlay(cairo_t*, const overlayaz_t*, gboolean);
+gboolean overlayaz_draw_marker_extents(const overlayaz_t*, gint, cairo_rectangle_int_t*);
 
 #endif
@@ -14,9 +14,39 @@
  */
 
 #include <gtk/gtk.h>
+#include <string.h>
 #include "overlayaz.h"
 #include "draw.h"
 #include "conf.h"
+#include "jpeg.h"
+#include "rotate.h"
+
+/* The photo is rendered in strips of rows, each one is encoded as soon as it is ready */
+#define EXPORT_STRIP_HEIGHT 512
+/* Strips are shared out between the workers in bands of rows, a few bands for each worker */
+#define EXPORT_BANDS_PER_WORKER 4
+#define EXPORT_BAND_MIN_HEIGHT  8
+/* The overlay is drawn through surfaces that fit within the cairo size limit */
+#define EXPORT_TILE_WIDTH 8192
+
+struct export_job
+{
+    const overlayaz_t *o;
+    enum overlayaz_rotate_filter filter;
+    gint width;
+    gint height;
+    guint8 *strip;
+    gint strip_first_row;
+    gint strip_rows;
+    gint band_height;
+    gint pending;
+    GMutex lock;
+    GCond cond;
+};
+
+static void export_overlay(struct export_job*);
+static void export_worker(gpointer, gpointer);
+
 
 gboolean
 overlayaz_export(const overlayaz_t *o,
@@ -24,44 +54,117 @@ overlayaz_export(const overlayaz_t *o,
                  const gchar       *filter_str,
                  guint              quality)
 {
-    gint width, height;
-    cairo_t *cr;
-    cairo_surface_t *target;
-    GdkPixbuf *pixbuf;
-    gboolean ret;
-    cairo_filter_t filter;
-    gchar *quality_str;
+    overlayaz_jpeg_t *jpeg;
+    struct export_job job;
+    GThreadPool *pool;
+    gint count;
+    gint bands;
+    gint i;
 
-    if (!overlayaz_get_pixbuf(o))
+    if (!overlayaz_get_image(o))
         return FALSE;
 
-    width = overlayaz_get_width(o);
-    height = overlayaz_get_height(o);
-    quality = MIN(quality, 100);
+    memset(&job, 0, sizeof(struct export_job));
+    job.o = o;
+    job.width = overlayaz_get_width(o);
+    job.height = overlayaz_get_height(o);
 
+    /* The photo is not scaled, so the cairo filters come down to these kernels */
     if (g_strcmp0(filter_str, OVERLAYAZ_CONF_IMAGE_FILTER_FAST) == 0)
-        filter = CAIRO_FILTER_FAST;
+        job.filter = OVERLAYAZ_ROTATE_NEAREST;
     else if (g_strcmp0(filter_str, OVERLAYAZ_CONF_IMAGE_FILTER_GOOD) == 0)
-        filter = CAIRO_FILTER_GOOD;
+        job.filter = OVERLAYAZ_ROTATE_BILINEAR;
     else if (g_strcmp0(filter_str, OVERLAYAZ_CONF_IMAGE_FILTER_NEAREST) == 0)
-        filter = CAIRO_FILTER_NEAREST;
+        job.filter = OVERLAYAZ_ROTATE_NEAREST;
     else if (g_strcmp0(filter_str, OVERLAYAZ_CONF_IMAGE_FILTER_BILINEAR) == 0)
-        filter = CAIRO_FILTER_BILINEAR;
+        job.filter = OVERLAYAZ_ROTATE_BILINEAR;
     else /* default */
-        filter = CAIRO_FILTER_BEST;
+        job.filter = OVERLAYAZ_ROTATE_BICUBIC;
+
+    jpeg = overlayaz_jpeg_new(filename, job.width, job.height, MIN(quality, 100));
+    if (jpeg == NULL)
+        return FALSE;
+
+    /* The workers read the rows of the image as they are, the result is never held in full */
+    job.strip = g_malloc((gsize)job.width * 4 * EXPORT_STRIP_HEIGHT);
+    g_mutex_init(&job.lock);
+    g_cond_init(&job.cond);
+
+    /* The same workers render every strip */
+    count = (gint)g_get_num_processors();
+    pool = g_thread_pool_new(export_worker, &job, count, FALSE, NULL);
+
+    for (job.strip_first_row = 0; job.strip_first_row < job.height; job.strip_first_row += EXPORT_STRIP_HEIGHT)
+    {
+        job.strip_rows = MIN(EXPORT_STRIP_HEIGHT, job.height - job.strip_first_row);
+        job.band_height = MAX(EXPORT_BAND_MIN_HEIGHT, job.strip_rows / (count * EXPORT_BANDS_PER_WORKER));
+        bands = (job.strip_rows + job.band_height - 1) / job.band_height;
 
-    target = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
-    cr = cairo_create(target);
-    overlayaz_draw(cr, filter, NULL, o);
-    cairo_destroy(cr);
+        job.pending = bands;
+        for (i = 0; i < bands; i++)
+            g_thread_pool_push(pool, GINT_TO_POINTER(i + 1), NULL);
 
-    pixbuf = gdk_pixbuf_get_from_surface(target, 0, 0, width, height);
-    quality_str = g_strdup_printf("%d", quality);
+        g_mutex_lock(&job.lock);
+        while (job.pending)
+            g_cond_wait(&job.cond, &job.lock);
+        g_mutex_unlock(&job.lock);
+
+        /* The overlay uses shared text layouts and caches, it stays on this thread */
+        export_overlay(&job);
+
+        if (!overlayaz_jpeg_write(jpeg, job.strip, job.width * 4, job.strip_rows))
+            break;
+    }
+
+    g_thread_pool_free(pool, FALSE, TRUE);
+    g_mutex_clear(&job.lock);
+    g_cond_clear(&job.cond);
+    g_free(job.strip);
+    return overlayaz_jpeg_finish(jpeg);
+}
+
+static void
+export_overlay(struct export_job *job)
+{
+    cairo_surface_t *tile;
+    cairo_t *cr;
+    gint x;
+
+    for (x = 0; x < job->width; x += EXPORT_TILE_WIDTH)
+    {
+        tile = cairo_image_surface_create_for_data(job->strip + (gsize)x * 4, CAIRO_FORMAT_RGB24,
+                                                   MIN(EXPORT_TILE_WIDTH, job->width - x), job->strip_rows,
+                                                   job->width * 4);
+        cr = cairo_create(tile);
+        cairo_translate(cr, -x, -job->strip_first_row);
+        /* Only the horizon and the labels within the tile are drawn */
+        overlayaz_draw_overlay(cr, job->o, TRUE);
+        cairo_destroy(cr);
+        cairo_surface_finish(tile);
+        cairo_surface_destroy(tile);
+    }
+}
+
+static void
+export_worker(gpointer data,
+              gpointer user_data)
+{
+    struct export_job *job = (struct export_job*)user_data;
+    gint stride = job->width * 4;
+    gint y = (GPOINTER_TO_INT(data) - 1) * job->band_height;
 
-    ret = gdk_pixbuf_save(pixbuf, filename, "jpeg", NULL, "quality", quality_str, NULL);
+    overlayaz_rotate(overlayaz_image_get_rows(overlayaz_get_image(job->o)),
+                     job->width,
+                     job->height,
+                     overlayaz_get_rotation(job->o),
+                     job->filter,
+                     job->strip + (gsize)y * stride,
+                     stride,
+                     job->strip_first_row + y,
+                     MIN(job->band_height, job->strip_rows - y));
 
-    g_free(quality_str);
-    g_object_unref(pixbuf);
-    cairo_surface_destroy(target);
-    return ret;
+    g_mutex_lock(&job->lock);
+    if (--job->pending == 0)
+        g_cond_signal(&job->cond);
+    g_mutex_unlock(&job->lock);
 }
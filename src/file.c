@@ -18,111 +18,100 @@
 #include "file.h"
 #include "profile.h"
 #include "exif.h"
+#include "jpeg.h"
 
-/* Image size limit from cairo */
-#define MAX_IMAGE_SIZE 32767
+/* The view and the export never create a surface of the whole image,
+   but an image that does not fit in a JPEG file could not be exported */
+#define MAX_IMAGE_SIZE OVERLAYAZ_JPEG_MAX_SIZE
 #define STR(x) #x
 #define VAL(x) STR(x)
 
-static GdkPixbuf* file_load_image(const gchar*);
+/* JPEG previews are decoded at this fraction of the full size */
+#define PREVIEW_SCALE_DENOM 8
 
-
-enum overlayaz_file_load_error
-overlayaz_file_load(overlayaz_t *o,
-                    const gchar *filename)
+/* The image is decoded on its own thread, while the profile is parsed by the caller */
+struct file_load
 {
-    enum overlayaz_file_load_error ret = OVERLAYAZ_FILE_LOAD_OK;
+    overlayaz_t *o;
     gchar *filename_image;
     gchar *filename_profile;
-    GdkPixbuf *pixbuf;
+    overlayaz_image_t *image;
+    gboolean has_location;
     struct overlayaz_location location;
+    enum overlayaz_file_load_error image_error;
+    enum overlayaz_file_load_error profile_error;
+};
 
-    overlayaz_reset(o);
+static struct file_load* file_load_new(overlayaz_t*, const gchar*);
+static void file_load_free(gpointer);
+static gpointer file_load_thread(gpointer);
+static void file_load_task(GTask*, gpointer, gpointer, GCancellable*);
+static void file_load_image(struct file_load*, GCancellable*);
+static overlayaz_image_t* file_load_pixbuf(const gchar*, GCancellable*);
+static void file_load_profile(struct file_load*);
+static enum overlayaz_file_load_error file_load_apply(struct file_load*);
+static gchar* file_image_name(const gchar*);
 
-    if (g_str_has_suffix(filename, OVERLAYAZ_EXTENSION_PROFILE))
-    {
-        filename_image = g_strndup(filename, strlen(filename) - strlen(OVERLAYAZ_EXTENSION_PROFILE));
-        filename_profile = g_strdup(filename);
-    }
-    else
-    {
-        filename_image = g_strdup(filename);
-        filename_profile = g_strdup_printf("%s%s", filename, OVERLAYAZ_EXTENSION_PROFILE);
-    }
 
-    pixbuf = file_load_image(filename_image);
-    if (pixbuf == NULL)
-    {
-        ret = OVERLAYAZ_FILE_LOAD_ERROR_IMAGE_OPEN;
-        goto overlayaz_file_load_cleanup;
-    }
+enum overlayaz_file_load_error
+overlayaz_file_load(overlayaz_t *o,
+                    const gchar *filename)
+{
+    enum overlayaz_file_load_error ret;
+    struct file_load *load;
+    GThread *thread;
 
-    if (!gdk_pixbuf_get_width(pixbuf) ||
-        !gdk_pixbuf_get_height(pixbuf))
-    {
-        g_object_unref(pixbuf);
-        ret = OVERLAYAZ_FILE_LOAD_ERROR_IMAGE_OPEN;
-        goto overlayaz_file_load_cleanup;
-    }
+    load = file_load_new(o, filename);
+    thread = g_thread_new("file-load", file_load_thread, load);
+    file_load_profile(load);
+    g_thread_join(thread);
 
-    if (gdk_pixbuf_get_width(pixbuf) > MAX_IMAGE_SIZE ||
-        gdk_pixbuf_get_height(pixbuf) > MAX_IMAGE_SIZE)
-    {
-        g_object_unref(pixbuf);
-        ret = OVERLAYAZ_FILE_LOAD_ERROR_IMAGE_TOO_BIG;
-        goto overlayaz_file_load_cleanup;
-    }
+    ret = file_load_apply(load);
+    file_load_free(load);
+    return ret;
+}
 
-    overlayaz_set_filename(o, filename_image);
-    overlayaz_set_pixbuf(o, pixbuf);
-    overlayaz_unchanged(o);
+void
+overlayaz_file_load_async(overlayaz_t         *o,
+                          const gchar         *filename,
+                          GCancellable        *cancellable,
+                          GAsyncReadyCallback  callback,
+                          gpointer             user_data)
+{
+    struct file_load *load = file_load_new(o, filename);
+    GTask *task;
 
-    if (filename_profile &&
-        g_file_test(filename_profile, G_FILE_TEST_EXISTS))
-    {
-        switch (overlayaz_profile_load(o, filename_profile))
-        {
-        case OVERLAYAZ_PROFILE_LOAD_OK:
-            overlayaz_unchanged(o);
-            break;
+    task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_task_data(task, load, file_load_free);
+    g_task_run_in_thread(task, file_load_task);
 
-        case OVERLAYAZ_PROFILE_LOAD_ERROR_OPEN:
-            ret = OVERLAYAZ_FILE_LOAD_ERROR_PROFILE_OPEN;
-            break;
+    /* The task only touches the image fields, the result is applied in the main loop */
+    file_load_profile(load);
+    g_object_unref(task);
+}
 
-        case OVERLAYAZ_PROFILE_LOAD_ERROR_PARSE:
-            ret = OVERLAYAZ_FILE_LOAD_ERROR_PROFILE_PARSE;
-            break;
+enum overlayaz_file_load_error
+overlayaz_file_load_finish(GAsyncResult *result)
+{
+    g_return_val_if_fail(g_task_is_valid(result, NULL), OVERLAYAZ_FILE_LOAD_ERROR_CANCELLED);
 
-        case OVERLAYAZ_PROFILE_LOAD_ERROR_FORMAT:
-            ret = OVERLAYAZ_FILE_LOAD_ERROR_PROFILE_FORMAT;
-            break;
+    /* The only error a task returns is the cancellation. The profile is already applied then,
+       without the image, so the caller resets the model (unless a newer load has taken it over). */
+    if (g_task_propagate_int(G_TASK(result), NULL) < 0)
+        return OVERLAYAZ_FILE_LOAD_ERROR_CANCELLED;
 
-        case OVERLAYAZ_PROFILE_LOAD_ERROR_VERSION:
-            ret = OVERLAYAZ_FILE_LOAD_ERROR_PROFILE_VERSION;
-            break;
-        }
-    }
-    else
-    {
-        /* Look up location in EXIF metadata if profile does not exist */
-        overlayaz_exif_t *exif = overlayaz_exif_new(filename_image);
-        if (exif)
-        {
-            if (overlayaz_exif_get_location(exif, &location))
-            {
-                overlayaz_set_location(o, &location);
-                overlayaz_unchanged(o);
-            }
+    return file_load_apply(g_task_get_task_data(G_TASK(result)));
+}
 
-            overlayaz_exif_free(exif);
-        }
-    }
+GdkPixbuf*
+overlayaz_file_load_preview(const gchar *filename)
+{
+    gchar *filename_image = file_image_name(filename);
+    GdkPixbuf *pixbuf;
 
-overlayaz_file_load_cleanup:
+    pixbuf = overlayaz_jpeg_load_preview(filename_image, PREVIEW_SCALE_DENOM);
     g_free(filename_image);
-    g_free(filename_profile);
-    return ret;
+    return pixbuf;
 }
 
 const gchar*
@@ -135,7 +124,7 @@ overlayaz_file_load_error(enum overlayaz_file_load_error error)
         case OVERLAYAZ_FILE_LOAD_ERROR_IMAGE_OPEN:
             return "Failed to open the image";
         case OVERLAYAZ_FILE_LOAD_ERROR_IMAGE_TOO_BIG:
-            return "Failed to process the image (too big, limit: " VAL(MAX_IMAGE_SIZE) " px)";
+            return "The image is too big to be exported (limit: " VAL(MAX_IMAGE_SIZE) " px)";
         case OVERLAYAZ_FILE_LOAD_ERROR_PROFILE_OPEN:
             return "Failed to open the profile file";
         case OVERLAYAZ_FILE_LOAD_ERROR_PROFILE_PARSE:
@@ -144,24 +133,211 @@ overlayaz_file_load_error(enum overlayaz_file_load_error error)
             return "The profile file has an invalid format";
         case OVERLAYAZ_FILE_LOAD_ERROR_PROFILE_VERSION:
             return "The profile format version is unsupported";
+        case OVERLAYAZ_FILE_LOAD_ERROR_CANCELLED:
+            return "The loading was cancelled";
         default:
             return "Unknown error";
     }
 }
 
-static GdkPixbuf*
-file_load_image(const gchar *filename)
+static struct file_load*
+file_load_new(overlayaz_t *o,
+              const gchar *filename)
 {
-    GdkPixbuf *pixbuf;
+    struct file_load *load = g_malloc0(sizeof(struct file_load));
+
+    load->o = o;
+    load->filename_image = file_image_name(filename);
+    load->filename_profile = g_strdup_printf("%s%s", load->filename_image, OVERLAYAZ_EXTENSION_PROFILE);
+    load->image_error = OVERLAYAZ_FILE_LOAD_OK;
+    load->profile_error = OVERLAYAZ_FILE_LOAD_OK;
+
+    /* Look up location in EXIF metadata if profile does not exist */
+    if (!g_file_test(load->filename_profile, G_FILE_TEST_EXISTS))
+    {
+        g_free(load->filename_profile);
+        load->filename_profile = NULL;
+    }
+
+    return load;
+}
+
+static void
+file_load_free(gpointer data)
+{
+    struct file_load *load = (struct file_load*)data;
+
+    overlayaz_image_free(load->image);
+    g_free(load->filename_image);
+    g_free(load->filename_profile);
+    g_free(load);
+}
+
+static gpointer
+file_load_thread(gpointer data)
+{
+    file_load_image((struct file_load*)data, NULL);
+    return NULL;
+}
+
+static void
+file_load_task(GTask        *task,
+               gpointer      source_object,
+               gpointer      task_data,
+               GCancellable *cancellable)
+{
+    file_load_image((struct file_load*)task_data, cancellable);
+    g_task_return_int(task, 0);
+}
+
+static void
+file_load_image(struct file_load *load,
+                GCancellable     *cancellable)
+{
+    overlayaz_exif_t *exif;
+    gint width, height;
+
+    /* The size is known from the header, a panorama that is too big is not decoded at all */
+    if (gdk_pixbuf_get_file_info(load->filename_image, &width, &height) &&
+        (width > MAX_IMAGE_SIZE || height > MAX_IMAGE_SIZE))
+    {
+        load->image_error = OVERLAYAZ_FILE_LOAD_ERROR_IMAGE_TOO_BIG;
+        return;
+    }
+
+    /* A JPEG file is decoded straight into the image, without a pixbuf of the whole photo */
+    load->image = overlayaz_jpeg_load(load->filename_image, cancellable);
+    if (load->image == NULL)
+        load->image = file_load_pixbuf(load->filename_image, cancellable);
+
+    if (load->image == NULL)
+    {
+        load->image_error = OVERLAYAZ_FILE_LOAD_ERROR_IMAGE_OPEN;
+        return;
+    }
+
+    if (overlayaz_image_get_width(load->image) > MAX_IMAGE_SIZE ||
+        overlayaz_image_get_height(load->image) > MAX_IMAGE_SIZE)
+    {
+        load->image_error = OVERLAYAZ_FILE_LOAD_ERROR_IMAGE_TOO_BIG;
+        return;
+    }
+
+    if (load->filename_profile == NULL)
+    {
+        exif = overlayaz_exif_new(load->filename_image);
+        if (exif)
+        {
+            load->has_location = overlayaz_exif_get_location(exif, &load->location);
+            overlayaz_exif_free(exif);
+        }
+    }
+}
+
+static overlayaz_image_t*
+file_load_pixbuf(const gchar  *filename,
+                 GCancellable *cancellable)
+{
+    overlayaz_image_t *image = NULL;
+    GFileInputStream *stream;
+    GFile *file;
+    GdkPixbuf *pixbuf = NULL;
     GError *error = NULL;
 
-    pixbuf = gdk_pixbuf_new_from_file(filename, &error);
+    file = g_file_new_for_path(filename);
+    stream = g_file_read(file, cancellable, &error);
+    if (stream)
+    {
+        pixbuf = gdk_pixbuf_new_from_stream(G_INPUT_STREAM(stream), cancellable, &error);
+        g_object_unref(stream);
+    }
+    g_object_unref(file);
 
     if (error)
     {
-        g_warning("%s: %s", __func__, error->message);
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            g_warning("%s: %s", __func__, error->message);
         g_error_free(error);
     }
 
-    return pixbuf;
+    if (pixbuf == NULL)
+        return NULL;
+
+    /* The pixels are converted once, the decoded pixbuf is not kept */
+    if (gdk_pixbuf_get_width(pixbuf) && gdk_pixbuf_get_height(pixbuf))
+        image = overlayaz_image_new_from_pixbuf(pixbuf);
+
+    g_object_unref(pixbuf);
+    return image;
+}
+
+static void
+file_load_profile(struct file_load *load)
+{
+    overlayaz_t *o = load->o;
+
+    overlayaz_reset(o);
+    overlayaz_set_filename(o, load->filename_image);
+    overlayaz_unchanged(o);
+
+    if (load->filename_profile == NULL)
+        return;
+
+    switch (overlayaz_profile_load(o, load->filename_profile))
+    {
+    case OVERLAYAZ_PROFILE_LOAD_OK:
+        overlayaz_unchanged(o);
+        break;
+
+    case OVERLAYAZ_PROFILE_LOAD_ERROR_OPEN:
+        load->profile_error = OVERLAYAZ_FILE_LOAD_ERROR_PROFILE_OPEN;
+        break;
+
+    case OVERLAYAZ_PROFILE_LOAD_ERROR_PARSE:
+        load->profile_error = OVERLAYAZ_FILE_LOAD_ERROR_PROFILE_PARSE;
+        break;
+
+    case OVERLAYAZ_PROFILE_LOAD_ERROR_FORMAT:
+        load->profile_error = OVERLAYAZ_FILE_LOAD_ERROR_PROFILE_FORMAT;
+        break;
+
+    case OVERLAYAZ_PROFILE_LOAD_ERROR_VERSION:
+        load->profile_error = OVERLAYAZ_FILE_LOAD_ERROR_PROFILE_VERSION;
+        break;
+    }
+}
+
+static enum overlayaz_file_load_error
+file_load_apply(struct file_load *load)
+{
+    overlayaz_t *o = load->o;
+    gboolean changed;
+
+    /* Without the image, the profile does not stay either */
+    if (load->image_error != OVERLAYAZ_FILE_LOAD_OK)
+    {
+        overlayaz_reset(o);
+        return load->image_error;
+    }
+
+    /* Changes made while the image was decoded are kept */
+    changed = overlayaz_changed(o);
+    overlayaz_set_image(o, load->image);
+    load->image = NULL;
+
+    if (load->has_location)
+        overlayaz_set_location(o, &load->location);
+
+    if (!changed)
+        overlayaz_unchanged(o);
+
+    return load->profile_error;
+}
+
+static gchar*
+file_image_name(const gchar *filename)
+{
+    if (g_str_has_suffix(filename, OVERLAYAZ_EXTENSION_PROFILE))
+        return g_strndup(filename, strlen(filename) - strlen(OVERLAYAZ_EXTENSION_PROFILE));
+    return g_strdup(filename);
 }
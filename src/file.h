@@ -24,10 +24,14 @@ enum overlayaz_file_load_error
     OVERLAYAZ_FILE_LOAD_ERROR_PROFILE_OPEN,
     OVERLAYAZ_FILE_LOAD_ERROR_PROFILE_PARSE,
     OVERLAYAZ_FILE_LOAD_ERROR_PROFILE_FORMAT,
-    OVERLAYAZ_FILE_LOAD_ERROR_PROFILE_VERSION
+    OVERLAYAZ_FILE_LOAD_ERROR_PROFILE_VERSION,
+    OVERLAYAZ_FILE_LOAD_ERROR_CANCELLED
 };
 
 enum overlayaz_file_load_error overlayaz_file_load(overlayaz_t*, const gchar*);
+void overlayaz_file_load_async(overlayaz_t*, const gchar*, GCancellable*, GAsyncReadyCallback, gpointer);
+enum overlayaz_file_load_error overlayaz_file_load_finish(GAsyncResult*);
+GdkPixbuf* overlayaz_file_load_preview(const gchar*);
 const gchar* overlayaz_file_load_error(enum overlayaz_file_load_error);
 
 #endif
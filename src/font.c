@@ -16,17 +16,43 @@
 #include <gtk/gtk.h>
 #include "font.h"
 
+/* Above this many entries the layouts of a font are dropped all at once */
+#define FONT_LAYOUT_CACHE 1024
+
 struct overlayaz_font
 {
     gchar *name;
     PangoFontDescription *pango;
+    GHashTable *layouts;
 };
 
+static PangoContext *font_context = NULL;
+
+
+void
+overlayaz_font_context_init(void)
+{
+    cairo_font_options_t *options;
+
+    /* Metrics are not hinted, so the shaped layouts can be drawn at any scale */
+    font_context = pango_font_map_create_context(pango_cairo_font_map_get_default());
+    options = cairo_font_options_create();
+    cairo_font_options_set_hint_metrics(options, CAIRO_HINT_METRICS_OFF);
+    pango_cairo_context_set_font_options(font_context, options);
+    cairo_font_options_destroy(options);
+}
+
+void
+overlayaz_font_context_free(void)
+{
+    g_clear_object(&font_context);
+}
 
 overlayaz_font_t*
 overlayaz_font_new(const gchar *default_font)
 {
     overlayaz_font_t *f = g_malloc0(sizeof(overlayaz_font_t));
+    f->layouts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_object_unref);
     overlayaz_font_set(f, default_font);
     return f;
 }
@@ -37,6 +63,7 @@ overlayaz_font_free(overlayaz_font_t *f)
     g_free(f->name);
     if (f->pango)
         pango_font_description_free(f->pango);
+    g_hash_table_destroy(f->layouts);
     g_free(f);
 }
 
@@ -49,6 +76,7 @@ overlayaz_font_set(struct overlayaz_font *f,
     if (f->pango)
         pango_font_description_free(f->pango);
     f->pango = pango_font_description_from_string(font);
+    g_hash_table_remove_all(f->layouts);
 }
 
 const gchar*
@@ -62,3 +90,38 @@ overlayaz_font_get_pango(const overlayaz_font_t *f)
 {
     return f->pango;
 }
+
+PangoLayout*
+overlayaz_font_get_layout(overlayaz_font_t *f,
+                          cairo_t          *cr,
+                          const gchar      *text,
+                          PangoAlignment    alignment)
+{
+    PangoLayout *layout;
+    gchar *key;
+
+    g_return_val_if_fail(font_context != NULL, NULL);
+
+    /* The layout is owned by the font, it remains valid until the next lookup or font change */
+    key = g_strdup_printf("%d%s", alignment, text);
+    layout = g_hash_table_lookup(f->layouts, key);
+    if (layout == NULL)
+    {
+        if (g_hash_table_size(f->layouts) >= FONT_LAYOUT_CACHE)
+            g_hash_table_remove_all(f->layouts);
+
+        layout = pango_layout_new(font_context);
+        pango_layout_set_font_description(layout, f->pango);
+        pango_layout_set_alignment(layout, alignment);
+        pango_layout_set_text(layout, text, -1);
+        g_hash_table_insert(f->layouts, key, layout);
+    }
+    else
+        g_free(key);
+
+    /* The text is shaped again only if the target changes the context */
+    if (cr)
+        pango_cairo_update_layout(cr, layout);
+
+    return layout;
+}
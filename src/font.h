@@ -18,12 +18,17 @@
 
 typedef struct overlayaz_font overlayaz_font_t;
 
+/* Fonts cache their layouts, they must be used from the main thread only */
+void overlayaz_font_context_init(void);
+void overlayaz_font_context_free(void);
+
 overlayaz_font_t* overlayaz_font_new(const gchar*);
 void overlayaz_font_free(overlayaz_font_t*);
 
 void overlayaz_font_set(overlayaz_font_t*, const gchar*);
 const gchar* overlayaz_font_get(const overlayaz_font_t*);
 const PangoFontDescription* overlayaz_font_get_pango(const overlayaz_font_t*);
+PangoLayout* overlayaz_font_get_layout(overlayaz_font_t*, cairo_t*, const gchar*, PangoAlignment);
 
 #endif
 
@@ -0,0 +1,260 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+#include "horizon.h"
+#include "srtm.h"
+#include "viewshed.h"
+#include "terrain-queue.h"
+
+#define HORIZON_RESOLUTION 0.05
+#define HORIZON_BINS       7200
+#define HORIZON_TASK_BINS  16
+
+struct horizon_task
+{
+    gchar *directory;
+    struct overlayaz_location home;
+    gdouble distance;
+    gint first;
+    gint count;
+    guint generation;
+};
+
+/* Bins are traced in the background, queued bins are not pushed again */
+struct horizon_cache
+{
+    struct overlayaz_terrain_queue queue;
+    gchar *directory;
+    struct overlayaz_location home;
+    gdouble distance;
+    gfloat *elevation;
+    gboolean *done;
+    gboolean *queued;
+};
+
+static struct horizon_cache cache;
+
+static void horizon_reset(const gchar*, const struct overlayaz_location*, gdouble);
+static gboolean horizon_ready(const gboolean*);
+static void horizon_worker(gpointer, gpointer);
+
+
+void
+overlayaz_horizon_get(const gchar                     *directory,
+                      const struct overlayaz_location *home,
+                      gdouble                          distance,
+                      const gdouble                   *azimuth,
+                      gint                             count,
+                      gboolean                         wait,
+                      gdouble                         *elevation)
+{
+    struct horizon_task *task;
+    gboolean *needed;
+    gdouble pos, t;
+    guint generation;
+    gint bin, next;
+    gint i;
+
+    if (directory == NULL || count <= 0)
+    {
+        for (i = 0; i < count; i++)
+            elevation[i] = NAN;
+        return;
+    }
+
+    overlayaz_terrain_queue_lock(&cache.queue);
+
+    if (cache.elevation == NULL ||
+        g_strcmp0(cache.directory, directory) != 0 ||
+        cache.home.latitude != home->latitude ||
+        cache.home.longitude != home->longitude ||
+        cache.home.altitude != home->altitude ||
+        cache.distance != distance)
+    {
+        horizon_reset(directory, home, distance);
+    }
+
+    /* Only the bins which were not traced before are computed, so a change
+       of the azimuth ratio or rotation usually costs a few columns at most. */
+    needed = g_new0(gboolean, HORIZON_BINS);
+    for (i = 0; i < count; i++)
+    {
+        if (!isfinite(azimuth[i]))
+            continue;
+        bin = (gint)floor(azimuth[i] / HORIZON_RESOLUTION);
+        bin = ((bin % HORIZON_BINS) + HORIZON_BINS) % HORIZON_BINS;
+        needed[bin] = !cache.done[bin];
+        next = (bin + 1) % HORIZON_BINS;
+        needed[next] = !cache.done[next];
+    }
+
+    generation = overlayaz_terrain_queue_generation(&cache.queue);
+    for (bin = 0; bin < HORIZON_BINS; bin++)
+    {
+        if (!needed[bin] || cache.queued[bin])
+            continue;
+
+        task = g_new(struct horizon_task, 1);
+        task->directory = g_strdup(directory);
+        task->home = *home;
+        task->distance = distance;
+        task->generation = generation;
+        task->first = bin;
+        task->count = 0;
+        while (bin < HORIZON_BINS && needed[bin] && !cache.queued[bin] && task->count < HORIZON_TASK_BINS)
+        {
+            cache.queued[bin] = TRUE;
+            task->count++;
+            bin++;
+        }
+        bin--;
+
+        overlayaz_terrain_queue_push(&cache.queue, horizon_worker, task);
+    }
+
+    while (wait && !horizon_ready(needed))
+        if (!overlayaz_terrain_queue_wait(&cache.queue, generation))
+            break;
+    g_free(needed);
+
+    /* Interpolate linearly between the neighbouring bins,
+       the ones still being traced are left out */
+    for (i = 0; i < count; i++)
+    {
+        elevation[i] = NAN;
+        if (!isfinite(azimuth[i]))
+            continue;
+
+        pos = azimuth[i] / HORIZON_RESOLUTION;
+        t = pos - floor(pos);
+        bin = (gint)floor(pos);
+        bin = ((bin % HORIZON_BINS) + HORIZON_BINS) % HORIZON_BINS;
+        next = (bin + 1) % HORIZON_BINS;
+        if (cache.done[bin] && cache.done[next])
+            elevation[i] = cache.elevation[bin] * (1.0 - t) + cache.elevation[next] * t;
+    }
+
+    overlayaz_terrain_queue_unlock(&cache.queue);
+}
+
+void
+overlayaz_horizon_set_notify(overlayaz_terrain_notify_t notify,
+                             gpointer                   data)
+{
+    overlayaz_terrain_queue_set_notify(&cache.queue, notify, data);
+}
+
+void
+overlayaz_horizon_free(void)
+{
+    overlayaz_terrain_queue_free(&cache.queue);
+    g_free(cache.directory);
+    g_free(cache.elevation);
+    g_free(cache.done);
+    g_free(cache.queued);
+
+    cache.directory = NULL;
+    cache.elevation = NULL;
+    cache.done = NULL;
+    cache.queued = NULL;
+}
+
+static void
+horizon_reset(const gchar                     *directory,
+              const struct overlayaz_location *home,
+              gdouble                          distance)
+{
+    g_free(cache.directory);
+    cache.directory = g_strdup(directory);
+    cache.home = *home;
+    cache.distance = distance;
+    overlayaz_terrain_queue_reset(&cache.queue);
+
+    if (cache.elevation == NULL)
+    {
+        cache.elevation = g_new(gfloat, HORIZON_BINS);
+        cache.done = g_new(gboolean, HORIZON_BINS);
+        cache.queued = g_new(gboolean, HORIZON_BINS);
+    }
+    memset(cache.done, 0, sizeof(gboolean) * HORIZON_BINS);
+    memset(cache.queued, 0, sizeof(gboolean) * HORIZON_BINS);
+}
+
+static gboolean
+horizon_ready(const gboolean *needed)
+{
+    gint bin;
+
+    for (bin = 0; bin < HORIZON_BINS; bin++)
+        if (needed[bin] && !cache.done[bin])
+            return FALSE;
+
+    return TRUE;
+}
+
+static void
+horizon_worker(gpointer data,
+               gpointer user_data)
+{
+    struct horizon_task *task = (struct horizon_task*)data;
+    overlayaz_srtm_sampler_t *sampler;
+    gfloat elevation[HORIZON_TASK_BINS];
+    gdouble observer, max_slope;
+    gboolean stale;
+    gint i;
+
+    overlayaz_terrain_queue_lock(&cache.queue);
+    stale = (task->generation != overlayaz_terrain_queue_generation(&cache.queue));
+    overlayaz_terrain_queue_unlock(&cache.queue);
+
+    if (!stale)
+    {
+        sampler = overlayaz_srtm_sampler_new(task->directory);
+        observer = overlayaz_viewshed_observer(sampler, &task->home);
+
+        for (i = 0; i < task->count; i++)
+        {
+            overlayaz_viewshed_ray(sampler, task->home.latitude, task->home.longitude, observer,
+                                   (task->first + i) * HORIZON_RESOLUTION, task->distance, NULL, &max_slope);
+
+            /* Partially missing data still gives the nearest part of the horizon */
+            if (max_slope == -G_MAXDOUBLE)
+                elevation[i] = NAN;
+            else
+                elevation[i] = (gfloat)(atan(max_slope) * 180.0 / G_PI);
+        }
+
+        overlayaz_srtm_sampler_free(sampler);
+    }
+
+    overlayaz_terrain_queue_lock(&cache.queue);
+    if (task->generation == overlayaz_terrain_queue_generation(&cache.queue))
+    {
+        for (i = 0; i < task->count; i++)
+        {
+            cache.elevation[task->first + i] = elevation[i];
+            cache.done[task->first + i] = TRUE;
+        }
+    }
+
+    overlayaz_terrain_queue_done(&cache.queue);
+    overlayaz_terrain_queue_unlock(&cache.queue);
+
+    g_free(task->directory);
+    g_free(task);
+}
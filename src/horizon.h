@@ -0,0 +1,25 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef OVERLAYAZ_HORIZON_H_
+#define OVERLAYAZ_HORIZON_H_
+#include "location.h"
+#include "terrain-queue.h"
+
+void overlayaz_horizon_get(const gchar*, const struct overlayaz_location*, gdouble, const gdouble*, gint, gboolean, gdouble*);
+void overlayaz_horizon_set_notify(overlayaz_terrain_notify_t, gpointer);
+void overlayaz_horizon_free(void);
+
+#endif
@@ -0,0 +1,159 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include <gtk/gtk.h>
+#include "image.h"
+#include "pixel.h"
+
+/* Wide panoramas are never held in one allocation. The bands are
+   cairo-compatible, so the view and the export use them as they are. */
+struct overlayaz_image
+{
+    gint width;
+    gint height;
+    gboolean has_alpha;
+    gint stride;
+    gint bands;
+    guint8 **band;
+    guint8 **rows;
+};
+
+
+overlayaz_image_t*
+overlayaz_image_new(gint     width,
+                    gint     height,
+                    gboolean has_alpha)
+{
+    overlayaz_image_t *image;
+    gint band_rows;
+    gint i, y;
+
+    g_return_val_if_fail(width > 0 && height > 0, NULL);
+
+    image = g_malloc0(sizeof(overlayaz_image_t));
+    image->width = width;
+    image->height = height;
+    image->has_alpha = has_alpha;
+    image->stride = cairo_format_stride_for_width(has_alpha ? CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24, width);
+    image->bands = (height + OVERLAYAZ_IMAGE_BAND_HEIGHT - 1) / OVERLAYAZ_IMAGE_BAND_HEIGHT;
+    image->band = g_new0(guint8*, image->bands);
+    image->rows = g_new(guint8*, height);
+
+    for (i = 0; i < image->bands; i++)
+    {
+        band_rows = MIN(OVERLAYAZ_IMAGE_BAND_HEIGHT, height - i * OVERLAYAZ_IMAGE_BAND_HEIGHT);
+        image->band[i] = g_try_malloc((gsize)image->stride * band_rows);
+        if (image->band[i] == NULL)
+        {
+            g_warning("%s: Failed to allocate %dx%d pixels", __func__, width, height);
+            overlayaz_image_free(image);
+            return NULL;
+        }
+
+        for (y = 0; y < band_rows; y++)
+            image->rows[i * OVERLAYAZ_IMAGE_BAND_HEIGHT + y] = image->band[i] + (gsize)y * image->stride;
+    }
+
+    return image;
+}
+
+overlayaz_image_t*
+overlayaz_image_new_from_pixbuf(const GdkPixbuf *pixbuf)
+{
+    overlayaz_image_t *image;
+    const guint8 *pixels;
+    gint n_channels;
+    gint rowstride;
+    gint y;
+
+    image = overlayaz_image_new(gdk_pixbuf_get_width(pixbuf),
+                                gdk_pixbuf_get_height(pixbuf),
+                                gdk_pixbuf_get_has_alpha(pixbuf));
+    if (image == NULL)
+        return NULL;
+
+    pixels = gdk_pixbuf_read_pixels(pixbuf);
+    n_channels = gdk_pixbuf_get_n_channels(pixbuf);
+    rowstride = gdk_pixbuf_get_rowstride(pixbuf);
+
+    for (y = 0; y < image->height; y++)
+        overlayaz_pixel_convert(pixels + (gsize)y * rowstride, n_channels, image->rows[y], image->width);
+
+    return image;
+}
+
+void
+overlayaz_image_free(overlayaz_image_t *image)
+{
+    gint i;
+
+    if (image == NULL)
+        return;
+
+    for (i = 0; i < image->bands; i++)
+        g_free(image->band[i]);
+
+    g_free(image->band);
+    g_free(image->rows);
+    g_free(image);
+}
+
+gint
+overlayaz_image_get_width(const overlayaz_image_t *image)
+{
+    return image->width;
+}
+
+gint
+overlayaz_image_get_height(const overlayaz_image_t *image)
+{
+    return image->height;
+}
+
+gboolean
+overlayaz_image_get_has_alpha(const overlayaz_image_t *image)
+{
+    return image->has_alpha;
+}
+
+guint8*
+overlayaz_image_get_row(const overlayaz_image_t *image,
+                        gint                     y)
+{
+    g_return_val_if_fail(y >= 0 && y < image->height, NULL);
+    return image->rows[y];
+}
+
+const guint8* const*
+overlayaz_image_get_rows(const overlayaz_image_t *image)
+{
+    return (const guint8* const*)image->rows;
+}
+
+cairo_surface_t*
+overlayaz_image_surface(const overlayaz_image_t *image,
+                        gint                     x,
+                        gint                     y,
+                        gint                     width,
+                        gint                     height)
+{
+    g_return_val_if_fail(x >= 0 && width > 0 && x + width <= image->width, NULL);
+    g_return_val_if_fail(y >= 0 && height > 0 && y + height <= image->height, NULL);
+    g_return_val_if_fail(y / OVERLAYAZ_IMAGE_BAND_HEIGHT == (y + height - 1) / OVERLAYAZ_IMAGE_BAND_HEIGHT, NULL);
+
+    return cairo_image_surface_create_for_data(image->rows[y] + (gsize)x * 4,
+                                               image->has_alpha ? CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24,
+                                               width, height, image->stride);
+}
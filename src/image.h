@@ -0,0 +1,40 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef OVERLAYAZ_IMAGE_H_
+#define OVERLAYAZ_IMAGE_H_
+
+/* The pixels are kept in separate bands of full rows */
+#define OVERLAYAZ_IMAGE_BAND_HEIGHT 256
+
+typedef struct overlayaz_image overlayaz_image_t;
+
+/* The decoded photo, in the native endian xRGB32 (or premultiplied ARGB32) of cairo */
+overlayaz_image_t* overlayaz_image_new(gint, gint, gboolean);
+overlayaz_image_t* overlayaz_image_new_from_pixbuf(const GdkPixbuf*);
+void overlayaz_image_free(overlayaz_image_t*);
+
+gint overlayaz_image_get_width(const overlayaz_image_t*);
+gint overlayaz_image_get_height(const overlayaz_image_t*);
+gboolean overlayaz_image_get_has_alpha(const overlayaz_image_t*);
+
+guint8* overlayaz_image_get_row(const overlayaz_image_t*, gint);
+const guint8* const* overlayaz_image_get_rows(const overlayaz_image_t*);
+
+/* A surface sharing the pixels of an area within one band,
+ * it must be destroyed before the image is freed */
+cairo_surface_t* overlayaz_image_surface(const overlayaz_image_t*, gint, gint, gint, gint);
+
+#endif
@@ -0,0 +1,355 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <setjmp.h>
+#include <jpeglib.h>
+#include "jpeg.h"
+#include "pixel.h"
+
+/* libjpeg-turbo takes the xRGB pixels of cairo as they are */
+#if defined(JCS_EXTENSIONS) && G_BYTE_ORDER == G_LITTLE_ENDIAN
+#define JPEG_DIRECT 1
+#endif
+
+struct jpeg_error
+{
+    struct jpeg_error_mgr pub;
+    jmp_buf jump;
+};
+
+struct overlayaz_jpeg
+{
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error error;
+    gchar *filename;
+    FILE *fp;
+    gboolean failed;
+#ifndef JPEG_DIRECT
+    JSAMPROW buffer;
+#endif
+};
+
+static gboolean jpeg_close(overlayaz_jpeg_t*, gboolean);
+static gboolean jpeg_check(FILE*);
+static void jpeg_error_exit(j_common_ptr);
+
+
+overlayaz_jpeg_t*
+overlayaz_jpeg_new(const gchar *filename,
+                   gint         width,
+                   gint         height,
+                   guint        quality)
+{
+    overlayaz_jpeg_t *jpeg;
+    FILE *fp;
+
+    fp = g_fopen(filename, "wb");
+    if (fp == NULL)
+        return NULL;
+
+    jpeg = g_malloc0(sizeof(overlayaz_jpeg_t));
+    jpeg->filename = g_strdup(filename);
+    jpeg->fp = fp;
+#ifndef JPEG_DIRECT
+    jpeg->buffer = g_malloc((gsize)width * 3);
+#endif
+
+    jpeg->cinfo.err = jpeg_std_error(&jpeg->error.pub);
+    jpeg->error.pub.error_exit = jpeg_error_exit;
+    jpeg_create_compress(&jpeg->cinfo);
+    if (setjmp(jpeg->error.jump))
+    {
+        /* The dimensions are checked here, see OVERLAYAZ_JPEG_MAX_SIZE */
+        jpeg_close(jpeg, FALSE);
+        return NULL;
+    }
+
+    jpeg_stdio_dest(&jpeg->cinfo, fp);
+    jpeg->cinfo.image_width = width;
+    jpeg->cinfo.image_height = height;
+#ifdef JPEG_DIRECT
+    jpeg->cinfo.input_components = 4;
+    jpeg->cinfo.in_color_space = JCS_EXT_BGRX;
+#else
+    jpeg->cinfo.input_components = 3;
+    jpeg->cinfo.in_color_space = JCS_RGB;
+#endif
+    jpeg_set_defaults(&jpeg->cinfo);
+    jpeg_set_quality(&jpeg->cinfo, (gint)MIN(quality, 100), TRUE);
+    jpeg_start_compress(&jpeg->cinfo, TRUE);
+    return jpeg;
+}
+
+gboolean
+overlayaz_jpeg_write(overlayaz_jpeg_t *jpeg,
+                     const guint8     *data,
+                     gint              stride,
+                     gint              rows)
+{
+    JSAMPROW row;
+    gint y;
+#ifndef JPEG_DIRECT
+    const guint32 *pixel;
+    gint x;
+#endif
+
+    if (jpeg->failed)
+        return FALSE;
+
+    if (setjmp(jpeg->error.jump))
+    {
+        jpeg->failed = TRUE;
+        return FALSE;
+    }
+
+    /* Scanlines are taken straight from the caller, one at a time */
+    for (y = 0; y < rows && jpeg->cinfo.next_scanline < jpeg->cinfo.image_height; y++)
+    {
+        row = (JSAMPROW)(data + (gsize)y * stride);
+#ifndef JPEG_DIRECT
+        pixel = (const guint32*)row;
+        for (x = 0; x < (gint)jpeg->cinfo.image_width; x++)
+        {
+            jpeg->buffer[3*x+0] = (pixel[x] >> 16) & 0xFF;
+            jpeg->buffer[3*x+1] = (pixel[x] >> 8) & 0xFF;
+            jpeg->buffer[3*x+2] = pixel[x] & 0xFF;
+        }
+        row = jpeg->buffer;
+#endif
+        jpeg_write_scanlines(&jpeg->cinfo, &row, 1);
+    }
+
+    return TRUE;
+}
+
+gboolean
+overlayaz_jpeg_finish(overlayaz_jpeg_t *jpeg)
+{
+    gboolean ret = FALSE;
+
+    if (!jpeg->failed &&
+        jpeg->cinfo.next_scanline == jpeg->cinfo.image_height)
+    {
+        if (setjmp(jpeg->error.jump) == 0)
+        {
+            jpeg_finish_compress(&jpeg->cinfo);
+            ret = TRUE;
+        }
+    }
+
+    return jpeg_close(jpeg, ret);
+}
+
+overlayaz_image_t*
+overlayaz_jpeg_load(const gchar  *filename,
+                    GCancellable *cancellable)
+{
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error error;
+    overlayaz_image_t *volatile image = NULL;
+    JSAMPROW volatile buffer = NULL;
+    JSAMPROW row;
+    FILE *fp;
+
+    fp = g_fopen(filename, "rb");
+    if (fp == NULL)
+        return NULL;
+
+    if (!jpeg_check(fp))
+    {
+        fclose(fp);
+        return NULL;
+    }
+
+    cinfo.err = jpeg_std_error(&error.pub);
+    error.pub.error_exit = jpeg_error_exit;
+    jpeg_create_decompress(&cinfo);
+    if (setjmp(error.jump))
+    {
+        jpeg_destroy_decompress(&cinfo);
+        fclose(fp);
+        overlayaz_image_free(image);
+        g_free(buffer);
+        return NULL;
+    }
+
+    jpeg_stdio_src(&cinfo, fp);
+    jpeg_read_header(&cinfo, TRUE);
+
+    /* Same as for the preview, CMYK is left to GdkPixbuf */
+    if (cinfo.jpeg_color_space == JCS_CMYK ||
+        cinfo.jpeg_color_space == JCS_YCCK)
+    {
+        jpeg_destroy_decompress(&cinfo);
+        fclose(fp);
+        return NULL;
+    }
+
+#ifdef JPEG_DIRECT
+    cinfo.out_color_space = JCS_EXT_BGRX;
+#else
+    cinfo.out_color_space = JCS_RGB;
+#endif
+    jpeg_start_decompress(&cinfo);
+
+    /* Every scanline goes straight to its row, the image bands are the only allocation */
+    image = overlayaz_image_new(cinfo.output_width, cinfo.output_height, FALSE);
+#ifndef JPEG_DIRECT
+    buffer = g_malloc((gsize)cinfo.output_width * 3);
+#endif
+
+    while (image &&
+           cinfo.output_scanline < cinfo.output_height &&
+           !g_cancellable_is_cancelled(cancellable))
+    {
+#ifdef JPEG_DIRECT
+        row = overlayaz_image_get_row(image, cinfo.output_scanline);
+        jpeg_read_scanlines(&cinfo, &row, 1);
+#else
+        row = buffer;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+        overlayaz_pixel_convert(buffer, 3, overlayaz_image_get_row(image, cinfo.output_scanline - 1), cinfo.output_width);
+#endif
+    }
+
+    if (image && cinfo.output_scanline == cinfo.output_height)
+    {
+        jpeg_finish_decompress(&cinfo);
+    }
+    else
+    {
+        overlayaz_image_free(image);
+        image = NULL;
+    }
+
+    jpeg_destroy_decompress(&cinfo);
+    fclose(fp);
+    g_free(buffer);
+    return image;
+}
+
+GdkPixbuf*
+overlayaz_jpeg_load_preview(const gchar *filename,
+                            guint        scale_denom)
+{
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error error;
+    GdkPixbuf *volatile pixbuf = NULL;
+    guchar *pixels;
+    gint rowstride;
+    JSAMPROW row;
+    FILE *fp;
+
+    fp = g_fopen(filename, "rb");
+    if (fp == NULL)
+        return NULL;
+
+    if (!jpeg_check(fp))
+    {
+        fclose(fp);
+        return NULL;
+    }
+
+    cinfo.err = jpeg_std_error(&error.pub);
+    error.pub.error_exit = jpeg_error_exit;
+    jpeg_create_decompress(&cinfo);
+    if (setjmp(error.jump))
+    {
+        jpeg_destroy_decompress(&cinfo);
+        fclose(fp);
+        if (pixbuf)
+            g_object_unref(pixbuf);
+        return NULL;
+    }
+
+    jpeg_stdio_src(&cinfo, fp);
+    jpeg_read_header(&cinfo, TRUE);
+
+    /* CMYK needs a conversion libjpeg does not provide, the full decode will show it */
+    if (cinfo.jpeg_color_space == JCS_CMYK ||
+        cinfo.jpeg_color_space == JCS_YCCK)
+    {
+        jpeg_destroy_decompress(&cinfo);
+        fclose(fp);
+        return NULL;
+    }
+
+    /* Only a fraction of the coefficients is transformed, this is where the time is saved */
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = scale_denom;
+    cinfo.out_color_space = JCS_RGB;
+    cinfo.dct_method = JDCT_IFAST;
+    cinfo.do_fancy_upsampling = FALSE;
+    jpeg_start_decompress(&cinfo);
+
+    pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, cinfo.output_width, cinfo.output_height);
+    pixels = gdk_pixbuf_get_pixels(pixbuf);
+    rowstride = gdk_pixbuf_get_rowstride(pixbuf);
+    while (cinfo.output_scanline < cinfo.output_height)
+    {
+        row = pixels + (gsize)cinfo.output_scanline * rowstride;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    fclose(fp);
+    return pixbuf;
+}
+
+static gboolean
+jpeg_close(overlayaz_jpeg_t *jpeg,
+           gboolean          keep)
+{
+    jpeg_destroy_compress(&jpeg->cinfo);
+    if (fclose(jpeg->fp) != 0)
+        keep = FALSE;
+    if (!keep)
+        g_unlink(jpeg->filename);
+#ifndef JPEG_DIRECT
+    g_free(jpeg->buffer);
+#endif
+    g_free(jpeg->filename);
+    g_free(jpeg);
+    return keep;
+}
+
+static gboolean
+jpeg_check(FILE *fp)
+{
+    guchar magic[2];
+
+    /* Other formats are not worth a warning from libjpeg */
+    if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic) ||
+        magic[0] != 0xFF || magic[1] != 0xD8)
+        return FALSE;
+
+    rewind(fp);
+    return TRUE;
+}
+
+static void
+jpeg_error_exit(j_common_ptr cinfo)
+{
+    struct jpeg_error *error = (struct jpeg_error*)cinfo->err;
+    gchar message[JMSG_LENGTH_MAX];
+
+    cinfo->err->format_message(cinfo, message);
+    g_warning("%s: %s", __func__, message);
+    longjmp(error->jump, 1);
+}
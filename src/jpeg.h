@@ -0,0 +1,38 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef OVERLAYAZ_JPEG_H_
+#define OVERLAYAZ_JPEG_H_
+#include "image.h"
+
+/* Largest width or height of a JPEG file */
+#define OVERLAYAZ_JPEG_MAX_SIZE 65500
+
+typedef struct overlayaz_jpeg overlayaz_jpeg_t;
+
+/* Rows of native endian xRGB32 pixels are written as they come,
+ * the file is removed when it is not finished successfully */
+overlayaz_jpeg_t* overlayaz_jpeg_new(const gchar*, gint, gint, guint);
+gboolean overlayaz_jpeg_write(overlayaz_jpeg_t*, const guint8*, gint, gint);
+gboolean overlayaz_jpeg_finish(overlayaz_jpeg_t*);
+
+/* Decodes a JPEG file into a new image, row by row, other files are not decoded at all */
+overlayaz_image_t* overlayaz_jpeg_load(const gchar*, GCancellable*);
+
+/* Decodes a JPEG file scaled down by 1/2, 1/4 or 1/8 in the DCT domain,
+ * other files are not decoded at all */
+GdkPixbuf* overlayaz_jpeg_load_preview(const gchar*, guint);
+
+#endif
@@ -23,6 +23,10 @@
 #include "ui.h"
 #include "file.h"
 #include "export.h"
+#include "srtm.h"
+#include "viewshed.h"
+#include "horizon.h"
+#include "depth.h"
 #include "resources.h"
 #ifdef G_OS_WIN32
 #include "mingw.h"
@@ -150,6 +154,7 @@ main (int   argc,
 {
     overlayaz_t *o;
     enum overlayaz_file_load_error error;
+    gchar *srtm_path;
 
     gexiv2_initialize();
     gtk_disable_setlocale();
@@ -169,6 +174,7 @@ main (int   argc,
         g_object_set(gtk_settings_get_default(), "gtk-application-prefer-dark-theme", TRUE, NULL);
 
     overlayaz_geo_init();
+    overlayaz_font_context_init();
     o = overlayaz_new();
 
     if (args.input_filename)
@@ -199,10 +205,21 @@ main (int   argc,
         }
     }
 
+    srtm_path = overlayaz_conf_get_srtm_path();
+    overlayaz_depth_set_terrain(srtm_path,
+                                overlayaz_conf_get_depth_resolution(),
+                                overlayaz_conf_get_horizon_distance() * 1000.0);
+    g_free(srtm_path);
+
     overlayaz_ui(o);
     gtk_main();
 
     overlayaz_free(o);
+    overlayaz_font_context_free();
+    overlayaz_depth_free();
+    overlayaz_horizon_free();
+    overlayaz_viewshed_free();
+    overlayaz_srtm_free();
     overlayaz_conf_free();
 
 #ifdef G_OS_WIN32
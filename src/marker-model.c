@@ -0,0 +1,142 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2022  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include <gtk/gtk.h>
+#include "marker-model.h"
+
+/* The rows carry no data, the index of a row is the marker id
+   and the combo box reads everything else from the store itself */
+struct overlayaz_marker_model
+{
+    overlayaz_marker_store_t *store;
+    GtkComboBox *combo;
+    GtkListStore *list;
+};
+
+static void marker_model_notify(gpointer, enum overlayaz_marker_store_event, gint);
+static void marker_model_row_changed(overlayaz_marker_model_t*, gint);
+static void marker_model_reset(overlayaz_marker_model_t*);
+static void marker_model_fill(overlayaz_marker_model_t*);
+
+
+overlayaz_marker_model_t*
+overlayaz_marker_model_new(overlayaz_marker_store_t *store,
+                           GtkComboBox              *combo)
+{
+    overlayaz_marker_model_t *model = g_malloc0(sizeof(overlayaz_marker_model_t));
+
+    model->store = store;
+    model->combo = combo;
+    model->list = gtk_list_store_new(1, G_TYPE_INT);
+    marker_model_fill(model);
+    gtk_combo_box_set_model(combo, GTK_TREE_MODEL(model->list));
+    overlayaz_marker_store_connect(store, marker_model_notify, model);
+    return model;
+}
+
+void
+overlayaz_marker_model_free(overlayaz_marker_model_t *model)
+{
+    if (model)
+    {
+        overlayaz_marker_store_disconnect(model->store, marker_model_notify, model);
+        g_object_unref(model->list);
+        g_free(model);
+    }
+}
+
+static void
+marker_model_notify(gpointer                           data,
+                    enum overlayaz_marker_store_event  event,
+                    gint                               id)
+{
+    overlayaz_marker_model_t *model = (overlayaz_marker_model_t*)data;
+    GtkTreeIter iter;
+
+    switch (event)
+    {
+    case OVERLAYAZ_MARKER_STORE_INSERTED:
+        gtk_list_store_insert(model->list, &iter, id);
+        break;
+
+    case OVERLAYAZ_MARKER_STORE_CHANGED:
+        marker_model_row_changed(model, id);
+        break;
+
+    case OVERLAYAZ_MARKER_STORE_REMOVED:
+        if (gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(model->list), &iter, NULL, id))
+            gtk_list_store_remove(model->list, &iter);
+        break;
+
+    case OVERLAYAZ_MARKER_STORE_SWAPPED:
+        marker_model_row_changed(model, id);
+        marker_model_row_changed(model, id + 1);
+        break;
+
+    case OVERLAYAZ_MARKER_STORE_CLEARED:
+        gtk_list_store_clear(model->list);
+        break;
+
+    case OVERLAYAZ_MARKER_STORE_RESET:
+        marker_model_reset(model);
+        break;
+    }
+}
+
+static void
+marker_model_row_changed(overlayaz_marker_model_t *model,
+                         gint                      id)
+{
+    GtkTreeIter iter;
+    GtkTreePath *path;
+
+    if (!gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(model->list), &iter, NULL, id))
+        return;
+
+    path = gtk_tree_path_new_from_indices(id, -1);
+    gtk_tree_model_row_changed(GTK_TREE_MODEL(model->list), path, &iter);
+    gtk_tree_path_free(path);
+}
+
+static void
+marker_model_reset(overlayaz_marker_model_t *model)
+{
+    guint signal_id = g_signal_lookup("changed", GTK_TYPE_COMBO_BOX);
+    gint active = gtk_combo_box_get_active(model->combo);
+    gint count = overlayaz_marker_store_count(model->store);
+
+    /* Refill the list while it is detached, so that the combo box
+       does not process a row signal for every marker */
+    g_signal_handlers_block_matched(model->combo, G_SIGNAL_MATCH_ID, signal_id, 0, NULL, NULL, NULL);
+    gtk_combo_box_set_model(model->combo, NULL);
+    marker_model_fill(model);
+    gtk_combo_box_set_model(model->combo, GTK_TREE_MODEL(model->list));
+    gtk_combo_box_set_active(model->combo, (active < count) ? active : -1);
+    g_signal_handlers_unblock_matched(model->combo, G_SIGNAL_MATCH_ID, signal_id, 0, NULL, NULL, NULL);
+
+    /* The selected marker may have changed as well */
+    g_signal_emit(model->combo, signal_id, 0);
+}
+
+static void
+marker_model_fill(overlayaz_marker_model_t *model)
+{
+    GtkTreeIter iter;
+    gint i;
+
+    gtk_list_store_clear(model->list);
+    for (i = 0; i < overlayaz_marker_store_count(model->store); i++)
+        gtk_list_store_insert(model->list, &iter, i);
+}
@@ -13,15 +13,13 @@
  *  GNU General Public License for more details.
  */
 
-#ifndef OVERLAYAZ_MARKER_ITER_H_
-#define OVERLAYAZ_MARKER_ITER_H_
-#include "marker.h"
+#ifndef OVERLAYAZ_MARKER_MODEL_H_
+#define OVERLAYAZ_MARKER_MODEL_H_
+#include "marker-store.h"
 
-typedef struct overlayaz_marker_iter overlayaz_marker_iter_t;
+typedef struct overlayaz_marker_model overlayaz_marker_model_t;
 
-overlayaz_marker_iter_t* overlayaz_marker_iter_new(GtkListStore*, const overlayaz_marker_t**);
-gboolean overlayaz_marker_iter_next(overlayaz_marker_iter_t*, const overlayaz_marker_t**);
-gint overlayaz_marker_iter_get_id(overlayaz_marker_iter_t*);
-void overlayaz_marker_iter_free(overlayaz_marker_iter_t*);
+overlayaz_marker_model_t* overlayaz_marker_model_new(overlayaz_marker_store_t*, GtkComboBox*);
+void overlayaz_marker_model_free(overlayaz_marker_model_t*);
 
 #endif
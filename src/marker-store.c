@@ -0,0 +1,516 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2022  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include <glib.h>
+#include <string.h>
+#include <math.h>
+#include "marker-store.h"
+#include "geo.h"
+
+#define OVERLAYAZ_DEFAULT_MARKER_NAME          "Marker"
+#define OVERLAYAZ_DEFAULT_MARKER_LATITUDE      0.0
+#define OVERLAYAZ_DEFAULT_MARKER_LONGITUDE     0.0
+#define OVERLAYAZ_DEFAULT_MARKER_TICK          OVERLAYAZ_MARKER_TICK_BOTTOM
+#define OVERLAYAZ_DEFAULT_MARKER_POSITION      50.0
+#define OVERLAYAZ_DEFAULT_MARKER_FLAGS         (OVERLAYAZ_MARKER_ACTIVE | OVERLAYAZ_MARKER_SHOW_AZIMUTH | OVERLAYAZ_MARKER_SHOW_DISTANCE)
+
+#define MARKER_STORE_MIN_SIZE 16
+
+struct marker_listener
+{
+    overlayaz_marker_store_notify_t func;
+    gpointer data;
+};
+
+struct overlayaz_marker_store
+{
+    gint count;
+    gint size;
+    gchar **name;
+    gdouble *latitude;
+    gdouble *longitude;
+    gdouble *azimuth;
+    gdouble *distance;
+    gdouble *position;
+    guint8 *flags;
+    guint8 *tick;
+    guint *style;
+
+    gdouble home_latitude;
+    gdouble home_longitude;
+    GArray *listeners;
+    gint batch;
+    gboolean pending;
+};
+
+static void marker_store_reserve(overlayaz_marker_store_t*, gint);
+static void marker_store_notify(overlayaz_marker_store_t*, enum overlayaz_marker_store_event, gint);
+static void marker_store_update_geo(overlayaz_marker_store_t*, gint);
+static void marker_store_set_flag(overlayaz_marker_store_t*, gint, guint8, gboolean);
+
+
+overlayaz_marker_store_t*
+overlayaz_marker_store_new(void)
+{
+    overlayaz_marker_store_t *store = g_malloc0(sizeof(overlayaz_marker_store_t));
+    store->listeners = g_array_new(FALSE, FALSE, sizeof(struct marker_listener));
+    store->home_latitude = NAN;
+    store->home_longitude = NAN;
+    marker_store_reserve(store, MARKER_STORE_MIN_SIZE);
+    return store;
+}
+
+void
+overlayaz_marker_store_free(overlayaz_marker_store_t *store)
+{
+    gint i;
+
+    if (store == NULL)
+        return;
+
+    for (i = 0; i < store->count; i++)
+        g_free(store->name[i]);
+
+    g_free(store->name);
+    g_free(store->latitude);
+    g_free(store->longitude);
+    g_free(store->azimuth);
+    g_free(store->distance);
+    g_free(store->position);
+    g_free(store->flags);
+    g_free(store->tick);
+    g_free(store->style);
+    g_array_free(store->listeners, TRUE);
+    g_free(store);
+}
+
+void
+overlayaz_marker_store_connect(overlayaz_marker_store_t        *store,
+                               overlayaz_marker_store_notify_t  func,
+                               gpointer                         data)
+{
+    struct marker_listener listener = { func, data };
+    g_array_append_val(store->listeners, listener);
+}
+
+void
+overlayaz_marker_store_disconnect(overlayaz_marker_store_t        *store,
+                                  overlayaz_marker_store_notify_t  func,
+                                  gpointer                         data)
+{
+    struct marker_listener *listener;
+    guint i;
+
+    for (i = 0; i < store->listeners->len; i++)
+    {
+        listener = &g_array_index(store->listeners, struct marker_listener, i);
+        if (listener->func == func && listener->data == data)
+        {
+            g_array_remove_index(store->listeners, i);
+            return;
+        }
+    }
+}
+
+gint
+overlayaz_marker_store_add(overlayaz_marker_store_t *store)
+{
+    gint id = store->count;
+
+    if (store->count == store->size)
+        marker_store_reserve(store, store->size * 2);
+
+    store->name[id] = g_strdup(OVERLAYAZ_DEFAULT_MARKER_NAME);
+    store->latitude[id] = OVERLAYAZ_DEFAULT_MARKER_LATITUDE;
+    store->longitude[id] = OVERLAYAZ_DEFAULT_MARKER_LONGITUDE;
+    store->position[id] = OVERLAYAZ_DEFAULT_MARKER_POSITION;
+    store->flags[id] = OVERLAYAZ_DEFAULT_MARKER_FLAGS;
+    store->tick[id] = OVERLAYAZ_DEFAULT_MARKER_TICK;
+    store->style[id] = OVERLAYAZ_MARKER_STYLE_DEFAULT;
+    store->count++;
+
+    marker_store_update_geo(store, id);
+    marker_store_notify(store, OVERLAYAZ_MARKER_STORE_INSERTED, id);
+    return id;
+}
+
+void
+overlayaz_marker_store_remove(overlayaz_marker_store_t *store,
+                              gint                      id)
+{
+    gint n;
+
+    g_return_if_fail(id >= 0 && id < store->count);
+
+    g_free(store->name[id]);
+
+    n = store->count - id - 1;
+    memmove(store->name + id, store->name + id + 1, n * sizeof(gchar*));
+    memmove(store->latitude + id, store->latitude + id + 1, n * sizeof(gdouble));
+    memmove(store->longitude + id, store->longitude + id + 1, n * sizeof(gdouble));
+    memmove(store->azimuth + id, store->azimuth + id + 1, n * sizeof(gdouble));
+    memmove(store->distance + id, store->distance + id + 1, n * sizeof(gdouble));
+    memmove(store->position + id, store->position + id + 1, n * sizeof(gdouble));
+    memmove(store->flags + id, store->flags + id + 1, n * sizeof(guint8));
+    memmove(store->tick + id, store->tick + id + 1, n * sizeof(guint8));
+    memmove(store->style + id, store->style + id + 1, n * sizeof(guint));
+    store->count--;
+
+    marker_store_notify(store, OVERLAYAZ_MARKER_STORE_REMOVED, id);
+}
+
+void
+overlayaz_marker_store_swap(overlayaz_marker_store_t *store,
+                            gint                      id)
+{
+    g_return_if_fail(id >= 0 && id + 1 < store->count);
+
+#define MARKER_STORE_SWAP(type, array) \
+    { type tmp = store->array[id]; store->array[id] = store->array[id+1]; store->array[id+1] = tmp; }
+
+    MARKER_STORE_SWAP(gchar*, name);
+    MARKER_STORE_SWAP(gdouble, latitude);
+    MARKER_STORE_SWAP(gdouble, longitude);
+    MARKER_STORE_SWAP(gdouble, azimuth);
+    MARKER_STORE_SWAP(gdouble, distance);
+    MARKER_STORE_SWAP(gdouble, position);
+    MARKER_STORE_SWAP(guint8, flags);
+    MARKER_STORE_SWAP(guint8, tick);
+    MARKER_STORE_SWAP(guint, style);
+
+#undef MARKER_STORE_SWAP
+
+    marker_store_notify(store, OVERLAYAZ_MARKER_STORE_SWAPPED, id);
+}
+
+void
+overlayaz_marker_store_clear(overlayaz_marker_store_t *store)
+{
+    gint i;
+
+    if (store->count == 0)
+        return;
+
+    for (i = 0; i < store->count; i++)
+        g_free(store->name[i]);
+
+    store->count = 0;
+    marker_store_notify(store, OVERLAYAZ_MARKER_STORE_CLEARED, -1);
+}
+
+void
+overlayaz_marker_store_begin(overlayaz_marker_store_t *store)
+{
+    store->batch++;
+}
+
+void
+overlayaz_marker_store_commit(overlayaz_marker_store_t *store)
+{
+    if (store->batch == 0)
+    {
+        g_warning("%s: No batch in progress", __func__);
+        return;
+    }
+
+    if (--store->batch == 0 && store->pending)
+    {
+        store->pending = FALSE;
+        marker_store_notify(store, OVERLAYAZ_MARKER_STORE_RESET, -1);
+    }
+}
+
+gint
+overlayaz_marker_store_count(const overlayaz_marker_store_t *store)
+{
+    return store->count;
+}
+
+void
+overlayaz_marker_store_get_arrays(const overlayaz_marker_store_t *store,
+                                  struct overlayaz_marker_arrays *out)
+{
+    out->count = store->count;
+    out->name = store->name;
+    out->latitude = store->latitude;
+    out->longitude = store->longitude;
+    out->azimuth = store->azimuth;
+    out->distance = store->distance;
+    out->position = store->position;
+    out->flags = store->flags;
+    out->tick = store->tick;
+    out->style = store->style;
+}
+
+void
+overlayaz_marker_store_set_home(overlayaz_marker_store_t *store,
+                                gdouble                   latitude,
+                                gdouble                   longitude)
+{
+    gint i;
+
+    store->home_latitude = latitude;
+    store->home_longitude = longitude;
+
+    for (i = 0; i < store->count; i++)
+        marker_store_update_geo(store, i);
+}
+
+gboolean
+overlayaz_marker_store_get_geo(const overlayaz_marker_store_t *store,
+                               gint                            id,
+                               gdouble                        *azimuth,
+                               gdouble                        *distance)
+{
+    if (isnan(store->azimuth[id]))
+        return FALSE;
+
+    if (azimuth)
+        *azimuth = store->azimuth[id];
+    if (distance)
+        *distance = store->distance[id];
+    return TRUE;
+}
+
+void
+overlayaz_marker_store_set_name(overlayaz_marker_store_t *store,
+                                gint                      id,
+                                const gchar              *value)
+{
+    if (g_strcmp0(store->name[id], value) == 0)
+        return;
+
+    g_free(store->name[id]);
+    store->name[id] = g_strdup(value);
+    marker_store_notify(store, OVERLAYAZ_MARKER_STORE_CHANGED, id);
+}
+
+const gchar*
+overlayaz_marker_store_get_name(const overlayaz_marker_store_t *store,
+                                gint                            id)
+{
+    return store->name[id];
+}
+
+void
+overlayaz_marker_store_set_latitude(overlayaz_marker_store_t *store,
+                                    gint                      id,
+                                    gdouble                   value)
+{
+    if (store->latitude[id] == value)
+        return;
+
+    store->latitude[id] = value;
+    marker_store_update_geo(store, id);
+    marker_store_notify(store, OVERLAYAZ_MARKER_STORE_CHANGED, id);
+}
+
+gdouble
+overlayaz_marker_store_get_latitude(const overlayaz_marker_store_t *store,
+                                    gint                            id)
+{
+    return store->latitude[id];
+}
+
+void
+overlayaz_marker_store_set_longitude(overlayaz_marker_store_t *store,
+                                     gint                      id,
+                                     gdouble                   value)
+{
+    if (store->longitude[id] == value)
+        return;
+
+    store->longitude[id] = value;
+    marker_store_update_geo(store, id);
+    marker_store_notify(store, OVERLAYAZ_MARKER_STORE_CHANGED, id);
+}
+
+gdouble
+overlayaz_marker_store_get_longitude(const overlayaz_marker_store_t *store,
+                                     gint                            id)
+{
+    return store->longitude[id];
+}
+
+void
+overlayaz_marker_store_set_tick(overlayaz_marker_store_t   *store,
+                                gint                        id,
+                                enum overlayaz_marker_tick  value)
+{
+    if (store->tick[id] == value)
+        return;
+
+    store->tick[id] = value;
+    marker_store_notify(store, OVERLAYAZ_MARKER_STORE_CHANGED, id);
+}
+
+enum overlayaz_marker_tick
+overlayaz_marker_store_get_tick(const overlayaz_marker_store_t *store,
+                                gint                            id)
+{
+    return store->tick[id];
+}
+
+void
+overlayaz_marker_store_set_style(overlayaz_marker_store_t *store,
+                                 gint                      id,
+                                 guint                     value)
+{
+    if (store->style[id] == value)
+        return;
+
+    store->style[id] = value;
+    marker_store_notify(store, OVERLAYAZ_MARKER_STORE_CHANGED, id);
+}
+
+guint
+overlayaz_marker_store_get_style(const overlayaz_marker_store_t *store,
+                                 gint                            id)
+{
+    return store->style[id];
+}
+
+void
+overlayaz_marker_store_set_position(overlayaz_marker_store_t *store,
+                                    gint                      id,
+                                    gdouble                   value)
+{
+    if (store->position[id] == value)
+        return;
+
+    store->position[id] = value;
+    marker_store_notify(store, OVERLAYAZ_MARKER_STORE_CHANGED, id);
+}
+
+gdouble
+overlayaz_marker_store_get_position(const overlayaz_marker_store_t *store,
+                                    gint                            id)
+{
+    return store->position[id];
+}
+
+void
+overlayaz_marker_store_set_active(overlayaz_marker_store_t *store,
+                                  gint                      id,
+                                  gboolean                  value)
+{
+    marker_store_set_flag(store, id, OVERLAYAZ_MARKER_ACTIVE, value);
+}
+
+gboolean
+overlayaz_marker_store_get_active(const overlayaz_marker_store_t *store,
+                                  gint                            id)
+{
+    return (store->flags[id] & OVERLAYAZ_MARKER_ACTIVE) != 0;
+}
+
+void
+overlayaz_marker_store_set_show_azimuth(overlayaz_marker_store_t *store,
+                                        gint                      id,
+                                        gboolean                  value)
+{
+    marker_store_set_flag(store, id, OVERLAYAZ_MARKER_SHOW_AZIMUTH, value);
+}
+
+gboolean
+overlayaz_marker_store_get_show_azimuth(const overlayaz_marker_store_t *store,
+                                        gint                            id)
+{
+    return (store->flags[id] & OVERLAYAZ_MARKER_SHOW_AZIMUTH) != 0;
+}
+
+void
+overlayaz_marker_store_set_show_distance(overlayaz_marker_store_t *store,
+                                         gint                      id,
+                                         gboolean                  value)
+{
+    marker_store_set_flag(store, id, OVERLAYAZ_MARKER_SHOW_DISTANCE, value);
+}
+
+gboolean
+overlayaz_marker_store_get_show_distance(const overlayaz_marker_store_t *store,
+                                         gint                            id)
+{
+    return (store->flags[id] & OVERLAYAZ_MARKER_SHOW_DISTANCE) != 0;
+}
+
+static void
+marker_store_reserve(overlayaz_marker_store_t *store,
+                     gint                      size)
+{
+    store->name = g_renew(gchar*, store->name, size);
+    store->latitude = g_renew(gdouble, store->latitude, size);
+    store->longitude = g_renew(gdouble, store->longitude, size);
+    store->azimuth = g_renew(gdouble, store->azimuth, size);
+    store->distance = g_renew(gdouble, store->distance, size);
+    store->position = g_renew(gdouble, store->position, size);
+    store->flags = g_renew(guint8, store->flags, size);
+    store->tick = g_renew(guint8, store->tick, size);
+    store->style = g_renew(guint, store->style, size);
+    store->size = size;
+}
+
+static void
+marker_store_notify(overlayaz_marker_store_t          *store,
+                    enum overlayaz_marker_store_event  event,
+                    gint                               id)
+{
+    struct marker_listener *listener;
+    guint i;
+
+    /* Changes made within a batch are announced once, on commit */
+    if (store->batch)
+    {
+        store->pending = TRUE;
+        return;
+    }
+
+    for (i = 0; i < store->listeners->len; i++)
+    {
+        listener = &g_array_index(store->listeners, struct marker_listener, i);
+        listener->func(listener->data, event, id);
+    }
+}
+
+static void
+marker_store_update_geo(overlayaz_marker_store_t *store,
+                        gint                      id)
+{
+    if (isnan(store->home_latitude) || isnan(store->home_longitude))
+    {
+        store->azimuth[id] = NAN;
+        store->distance[id] = NAN;
+        return;
+    }
+
+    overlayaz_geo_inverse(store->home_latitude, store->home_longitude,
+                          store->latitude[id], store->longitude[id],
+                          &store->azimuth[id], NULL, &store->distance[id]);
+}
+
+static void
+marker_store_set_flag(overlayaz_marker_store_t *store,
+                      gint                      id,
+                      guint8                    flag,
+                      gboolean                  value)
+{
+    guint8 flags = value ? (store->flags[id] | flag) : (store->flags[id] & ~flag);
+
+    if (store->flags[id] == flags)
+        return;
+
+    store->flags[id] = flags;
+    marker_store_notify(store, OVERLAYAZ_MARKER_STORE_CHANGED, id);
+}
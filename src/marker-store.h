@@ -0,0 +1,113 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2022  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef OVERLAYAZ_MARKER_STORE_H_
+#define OVERLAYAZ_MARKER_STORE_H_
+
+/* Style ids refer to the marker style table */
+#define OVERLAYAZ_MARKER_STYLE_DEFAULT 0
+
+typedef struct overlayaz_marker_store overlayaz_marker_store_t;
+
+enum overlayaz_marker_tick
+{
+    OVERLAYAZ_MARKER_TICK_NONE = 0,
+    OVERLAYAZ_MARKER_TICK_TOP = 1,
+    OVERLAYAZ_MARKER_TICK_BOTTOM = 2
+};
+
+enum overlayaz_marker_flag
+{
+    OVERLAYAZ_MARKER_ACTIVE        = 1 << 0,
+    OVERLAYAZ_MARKER_SHOW_AZIMUTH  = 1 << 1,
+    OVERLAYAZ_MARKER_SHOW_DISTANCE = 1 << 2
+};
+
+enum overlayaz_marker_store_event
+{
+    OVERLAYAZ_MARKER_STORE_INSERTED,
+    OVERLAYAZ_MARKER_STORE_CHANGED,
+    OVERLAYAZ_MARKER_STORE_REMOVED,
+    OVERLAYAZ_MARKER_STORE_SWAPPED,
+    OVERLAYAZ_MARKER_STORE_CLEARED,
+    OVERLAYAZ_MARKER_STORE_RESET
+};
+
+/* A swap exchanges the marker with the next one,
+   a reset means that any marker may have changed */
+typedef void (*overlayaz_marker_store_notify_t)(gpointer, enum overlayaz_marker_store_event, gint);
+
+/* Markers are kept in parallel arrays indexed by the marker id,
+   the arrays stay valid until the next insertion or removal */
+struct overlayaz_marker_arrays
+{
+    gint count;
+    gchar * const *name;
+    const gdouble *latitude;
+    const gdouble *longitude;
+    const gdouble *azimuth;
+    const gdouble *distance;
+    const gdouble *position;
+    const guint8 *flags;
+    const guint8 *tick;
+    const guint *style;
+};
+
+overlayaz_marker_store_t* overlayaz_marker_store_new(void);
+void overlayaz_marker_store_free(overlayaz_marker_store_t*);
+
+void overlayaz_marker_store_connect(overlayaz_marker_store_t*, overlayaz_marker_store_notify_t, gpointer);
+void overlayaz_marker_store_disconnect(overlayaz_marker_store_t*, overlayaz_marker_store_notify_t, gpointer);
+
+gint overlayaz_marker_store_add(overlayaz_marker_store_t*);
+void overlayaz_marker_store_remove(overlayaz_marker_store_t*, gint);
+void overlayaz_marker_store_swap(overlayaz_marker_store_t*, gint);
+void overlayaz_marker_store_clear(overlayaz_marker_store_t*);
+void overlayaz_marker_store_begin(overlayaz_marker_store_t*);
+void overlayaz_marker_store_commit(overlayaz_marker_store_t*);
+gint overlayaz_marker_store_count(const overlayaz_marker_store_t*);
+void overlayaz_marker_store_get_arrays(const overlayaz_marker_store_t*, struct overlayaz_marker_arrays*);
+
+void overlayaz_marker_store_set_home(overlayaz_marker_store_t*, gdouble, gdouble);
+gboolean overlayaz_marker_store_get_geo(const overlayaz_marker_store_t*, gint, gdouble*, gdouble*);
+
+void overlayaz_marker_store_set_name(overlayaz_marker_store_t*, gint, const gchar*);
+const gchar* overlayaz_marker_store_get_name(const overlayaz_marker_store_t*, gint);
+
+void overlayaz_marker_store_set_latitude(overlayaz_marker_store_t*, gint, gdouble);
+gdouble overlayaz_marker_store_get_latitude(const overlayaz_marker_store_t*, gint);
+
+void overlayaz_marker_store_set_longitude(overlayaz_marker_store_t*, gint, gdouble);
+gdouble overlayaz_marker_store_get_longitude(const overlayaz_marker_store_t*, gint);
+
+void overlayaz_marker_store_set_tick(overlayaz_marker_store_t*, gint, enum overlayaz_marker_tick);
+enum overlayaz_marker_tick overlayaz_marker_store_get_tick(const overlayaz_marker_store_t*, gint);
+
+void overlayaz_marker_store_set_style(overlayaz_marker_store_t*, gint, guint);
+guint overlayaz_marker_store_get_style(const overlayaz_marker_store_t*, gint);
+
+void overlayaz_marker_store_set_position(overlayaz_marker_store_t*, gint, gdouble);
+gdouble overlayaz_marker_store_get_position(const overlayaz_marker_store_t*, gint);
+
+void overlayaz_marker_store_set_active(overlayaz_marker_store_t*, gint, gboolean);
+gboolean overlayaz_marker_store_get_active(const overlayaz_marker_store_t*, gint);
+
+void overlayaz_marker_store_set_show_azimuth(overlayaz_marker_store_t*, gint, gboolean);
+gboolean overlayaz_marker_store_get_show_azimuth(const overlayaz_marker_store_t*, gint);
+
+void overlayaz_marker_store_set_show_distance(overlayaz_marker_store_t*, gint, gboolean);
+gboolean overlayaz_marker_store_get_show_distance(const overlayaz_marker_store_t*, gint);
+
+#endif
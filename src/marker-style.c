@@ -0,0 +1,108 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2022  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include <gtk/gtk.h>
+#include "marker-style.h"
+#include "marker-store.h"
+
+#define OVERLAYAZ_DEFAULT_MARKER_FONT          "monospace 12"
+#define OVERLAYAZ_DEFAULT_MARKER_FONT_COLOR    "rgba(0,0,0,0.9)"
+
+/* Markers with the same font and color share a style,
+   together with the layouts cached by its font */
+struct marker_style
+{
+    overlayaz_font_t *font;
+    GdkRGBA color;
+};
+
+/* A table of all label styles used by the markers. A style is only
+   a handful of bytes, so the entries are kept for the lifetime
+   of the table and a style id never becomes invalid. */
+struct overlayaz_marker_style
+{
+    GArray *styles;
+};
+
+
+overlayaz_marker_style_t*
+overlayaz_marker_style_new(void)
+{
+    overlayaz_marker_style_t *table = g_malloc0(sizeof(overlayaz_marker_style_t));
+    GdkRGBA color;
+
+    table->styles = g_array_new(FALSE, FALSE, sizeof(struct marker_style));
+
+    /* The first entry is OVERLAYAZ_MARKER_STYLE_DEFAULT */
+    gdk_rgba_parse(&color, OVERLAYAZ_DEFAULT_MARKER_FONT_COLOR);
+    overlayaz_marker_style_lookup(table, OVERLAYAZ_DEFAULT_MARKER_FONT, &color);
+    return table;
+}
+
+void
+overlayaz_marker_style_free(overlayaz_marker_style_t *table)
+{
+    guint i;
+
+    if (table == NULL)
+        return;
+
+    for (i = 0; i < table->styles->len; i++)
+        overlayaz_font_free(g_array_index(table->styles, struct marker_style, i).font);
+
+    g_array_free(table->styles, TRUE);
+    g_free(table);
+}
+
+guint
+overlayaz_marker_style_lookup(overlayaz_marker_style_t *table,
+                              const gchar              *font,
+                              const GdkRGBA            *color)
+{
+    struct marker_style *s;
+    struct marker_style new_style;
+    guint i;
+
+    for (i = 0; i < table->styles->len; i++)
+    {
+        s = &g_array_index(table->styles, struct marker_style, i);
+        if (g_strcmp0(overlayaz_font_get(s->font), font) == 0 &&
+            gdk_rgba_equal(&s->color, color))
+        {
+            return i;
+        }
+    }
+
+    new_style.font = overlayaz_font_new(font);
+    new_style.color = *color;
+    g_array_append_val(table->styles, new_style);
+    return table->styles->len - 1;
+}
+
+overlayaz_font_t*
+overlayaz_marker_style_get_font(const overlayaz_marker_style_t *table,
+                                guint                           style)
+{
+    g_return_val_if_fail(style < table->styles->len, NULL);
+    return g_array_index(table->styles, struct marker_style, style).font;
+}
+
+const GdkRGBA*
+overlayaz_marker_style_get_color(const overlayaz_marker_style_t *table,
+                                 guint                           style)
+{
+    g_return_val_if_fail(style < table->styles->len, NULL);
+    return &g_array_index(table->styles, struct marker_style, style).color;
+}
@@ -13,17 +13,17 @@
  *  GNU General Public License for more details.
  */
 
-#ifndef OVERLAYAZ_MARKER_LIST_H_
-#define OVERLAYAZ_MARKER_LIST_H_
-#include "marker.h"
+#ifndef OVERLAYAZ_MARKER_STYLE_H_
+#define OVERLAYAZ_MARKER_STYLE_H_
+#include "font.h"
 
-GtkListStore* overlayaz_marker_list_new();
-void overlayaz_marker_list_free(GtkListStore*);
-void overlayaz_marker_list_clear(GtkListStore*);
-overlayaz_marker_t* overlayaz_marker_list_get(GtkListStore*, GtkTreeIter*);
-void overlayaz_marker_list_add(GtkListStore*, overlayaz_marker_t*);
-void overlayaz_marker_list_update(GtkListStore*, GtkTreeIter*);
-void overlayaz_marker_list_remove(GtkListStore*, GtkTreeIter*);
-gint overlayaz_marker_list_count(GtkListStore*);
+typedef struct overlayaz_marker_style overlayaz_marker_style_t;
+
+overlayaz_marker_style_t* overlayaz_marker_style_new(void);
+void overlayaz_marker_style_free(overlayaz_marker_style_t*);
+
+guint overlayaz_marker_style_lookup(overlayaz_marker_style_t*, const gchar*, const GdkRGBA*);
+overlayaz_font_t* overlayaz_marker_style_get_font(const overlayaz_marker_style_t*, guint);
+const GdkRGBA* overlayaz_marker_style_get_color(const overlayaz_marker_style_t*, guint);
 
 #endif
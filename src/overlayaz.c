@@ -17,7 +17,6 @@
 #include <math.h>
 #include "overlayaz.h"
 #include "overlayaz-default.h"
-#include "marker-list.h"
 #include "font.h"
 #include "geo.h"
 
@@ -35,10 +34,11 @@ struct overlayaz_ref
 struct overlayaz
 {
     gchar *filename;
-    GdkPixbuf *pixbuf;
+    overlayaz_image_t *image;
     gint width;
     gint height;
     gboolean changed;
+    guint revision;
 
     /* Profile */
     gdouble rotation;
@@ -51,11 +51,13 @@ struct overlayaz
     GdkRGBA grid_color;
     overlayaz_font_t *grid_font;
     GdkRGBA grid_font_color;
-    GtkListStore *marker_list;
+    overlayaz_marker_store_t *markers;
+    overlayaz_marker_style_t *marker_style;
 };
 
 static void ref_update(overlayaz_t*, enum overlayaz_ref_type);
-static void marker_changed(overlayaz_t*);
+static void marker_changed(gpointer, enum overlayaz_marker_store_event, gint);
+static inline void overlayaz_set_changed(overlayaz_t*);
 static inline gboolean overlayaz_is_valid(gdouble);
 
 
@@ -65,11 +67,9 @@ overlayaz_new(void)
     overlayaz_t *o = g_malloc0(sizeof(overlayaz_t));
 
     o->grid_font = overlayaz_font_new(OVERLAYAZ_DEFAULT_GRID_FONT);
-    o->marker_list = overlayaz_marker_list_new();
-    g_signal_connect_swapped(o->marker_list, "row-changed", G_CALLBACK(marker_changed), o);
-    g_signal_connect_swapped(o->marker_list, "row-inserted", G_CALLBACK(marker_changed), o);
-    g_signal_connect_swapped(o->marker_list, "row-deleted", G_CALLBACK(marker_changed), o);
-    g_signal_connect_swapped(o->marker_list, "rows-reordered", G_CALLBACK(marker_changed), o);
+    o->markers = overlayaz_marker_store_new();
+    o->marker_style = overlayaz_marker_style_new();
+    overlayaz_marker_store_connect(o->markers, marker_changed, o);
 
     overlayaz_reset(o);
     return o;
@@ -79,10 +79,10 @@ void
 overlayaz_free(overlayaz_t *o)
 {
     g_free(o->filename);
-    if (o->pixbuf)
-        g_object_unref(o->pixbuf);
+    overlayaz_image_free(o->image);
     overlayaz_font_free(o->grid_font);
-    overlayaz_marker_list_free(o->marker_list);
+    overlayaz_marker_store_free(o->markers);
+    overlayaz_marker_style_free(o->marker_style);
     g_free(o);
 }
 
@@ -90,7 +90,7 @@ void
 overlayaz_reset(overlayaz_t *o)
 {
     overlayaz_set_filename(o, NULL);
-    overlayaz_set_pixbuf(o, NULL);
+    overlayaz_set_image(o, NULL);
     overlayaz_set_rotation(o, OVERLAYAZ_DEFAULT_ROTATION);
     overlayaz_set_location(o, &(struct overlayaz_location){OVERLAYAZ_DEFAULT_LATITUDE, OVERLAYAZ_DEFAULT_LONGITUDE, OVERLAYAZ_DEFAULT_ALTITUDE});
     overlayaz_set_ref_none(o, OVERLAYAZ_REF_AZ);
@@ -107,7 +107,7 @@ overlayaz_reset(overlayaz_t *o)
     overlayaz_set_grid_font(o, OVERLAYAZ_DEFAULT_GRID_FONT);
     gdk_rgba_parse(&o->grid_font_color, OVERLAYAZ_DEFAULT_GRID_FONT_COLOR);
 
-    overlayaz_marker_list_clear(o->marker_list);
+    overlayaz_marker_store_clear(o->markers);
 
     o->changed = FALSE;
 }
@@ -124,6 +124,12 @@ overlayaz_unchanged(overlayaz_t *o)
     o->changed = FALSE;
 }
 
+guint
+overlayaz_get_revision(const overlayaz_t *o)
+{
+    return o->revision;
+}
+
 void
 overlayaz_set_filename(overlayaz_t *o,
                        const gchar *filename)
@@ -132,7 +138,7 @@ overlayaz_set_filename(overlayaz_t *o,
     {
         g_free(o->filename);
         o->filename = g_strdup(filename);
-        o->changed = TRUE;
+        overlayaz_set_changed(o);
     }
 }
 
@@ -143,22 +149,26 @@ overlayaz_get_filename(const overlayaz_t *o)
 }
 
 void
-overlayaz_set_pixbuf(overlayaz_t *o,
-                     GdkPixbuf   *pixbuf)
+overlayaz_set_image(overlayaz_t       *o,
+                    overlayaz_image_t *image)
 {
-    if (o->pixbuf)
-        g_object_unref(o->pixbuf);
+    overlayaz_image_free(o->image);
 
-    o->pixbuf = pixbuf;
-    o->width = pixbuf ? gdk_pixbuf_get_width(pixbuf) : 0;
-    o->height = pixbuf ? gdk_pixbuf_get_height(pixbuf) : 0;
-    o->changed = TRUE;
+    o->image = image;
+    o->width = image ? overlayaz_image_get_width(image) : 0;
+    o->height = image ? overlayaz_image_get_height(image) : 0;
+
+    /* A profile may be loaded before its image is decoded,
+       the references are checked again against the new size */
+    ref_update(o, OVERLAYAZ_REF_AZ);
+    ref_update(o, OVERLAYAZ_REF_EL);
+    overlayaz_set_changed(o);
 }
 
-const GdkPixbuf*
-overlayaz_get_pixbuf(const overlayaz_t *o)
+const overlayaz_image_t*
+overlayaz_get_image(const overlayaz_t *o)
 {
-    return o->pixbuf;
+    return o->image;
 }
 
 gint
@@ -186,7 +196,7 @@ overlayaz_set_rotation(overlayaz_t *o,
     if (o->rotation != rotation)
     {
         o->rotation = rotation;
-        o->changed = TRUE;
+        overlayaz_set_changed(o);
     }
 }
 
@@ -215,7 +225,8 @@ overlayaz_set_location(overlayaz_t                     *o,
 
         ref_update(o, OVERLAYAZ_REF_AZ);
         ref_update(o, OVERLAYAZ_REF_EL);
-        o->changed = TRUE;
+        overlayaz_marker_store_set_home(o->markers, o->location.latitude, o->location.longitude);
+        overlayaz_set_changed(o);
     }
 }
 
@@ -246,7 +257,7 @@ overlayaz_set_ref_none(overlayaz_t             *o,
     }
 
     o->ref[type].ratio = OVERLAYAZ_INVALID_RATIO;
-    o->changed = TRUE;
+    overlayaz_set_changed(o);
 }
 
 void
@@ -272,7 +283,7 @@ overlayaz_set_ref_one(overlayaz_t                     *o,
     o->ref[type].position[OVERLAYAZ_REF_B] = OVERLAYAZ_INVALID_DATA;
     o->ref[type].ratio = ratio;
     ref_update(o, type);
-    o->changed = TRUE;
+    overlayaz_set_changed(o);
 }
 
 void
@@ -304,7 +315,7 @@ overlayaz_set_ref_two(overlayaz_t                     *o,
     }
 
     ref_update(o, type);
-    o->changed = TRUE;
+    overlayaz_set_changed(o);
 }
 
 gboolean
@@ -428,7 +439,7 @@ overlayaz_set_grid(overlayaz_t             *o,
     if (o->grid[type] != value)
     {
         o->grid[type] = value;
-        o->changed = TRUE;
+        overlayaz_set_changed(o);
     }
 }
 
@@ -447,7 +458,7 @@ overlayaz_set_grid_step(overlayaz_t             *o,
     if (o->grid_step[type] != value)
     {
         o->grid_step[type] = value;
-        o->changed = TRUE;
+        overlayaz_set_changed(o);
     }
 }
 
@@ -466,7 +477,7 @@ overlayaz_set_grid_position(overlayaz_t             *o,
     if (o->grid_position[type] != value)
     {
         o->grid_position[type] = value;
-        o->changed = TRUE;
+        overlayaz_set_changed(o);
     }
 }
 
@@ -484,7 +495,7 @@ overlayaz_set_grid_width(overlayaz_t *o,
     if (o->grid_width != value)
     {
         o->grid_width = value;
-        o->changed = TRUE;
+        overlayaz_set_changed(o);
     }
 }
 
@@ -501,7 +512,7 @@ overlayaz_set_grid_color(overlayaz_t   *o,
     if (!gdk_rgba_equal(&o->grid_color, color))
     {
         o->grid_color = *color;
-        o->changed = TRUE;
+        overlayaz_set_changed(o);
     }
 }
 
@@ -518,11 +529,11 @@ overlayaz_set_grid_font(overlayaz_t *o,
     if (g_strcmp0(overlayaz_font_get(o->grid_font), font) != 0)
     {
         overlayaz_font_set(o->grid_font, font);
-        o->changed = TRUE;
+        overlayaz_set_changed(o);
     }
 }
 
-const overlayaz_font_t*
+overlayaz_font_t*
 overlayaz_get_grid_font(const overlayaz_t *o)
 {
     return o->grid_font;
@@ -535,7 +546,7 @@ overlayaz_set_grid_font_color(overlayaz_t   *o,
     if (!gdk_rgba_equal(&o->grid_font_color, color))
     {
         o->grid_font_color = *color;
-        o->changed = TRUE;
+        overlayaz_set_changed(o);
     }
 }
 
@@ -545,10 +556,16 @@ overlayaz_get_grid_font_color(const overlayaz_t *o)
     return &o->grid_font_color;
 }
 
-GtkListStore*
-overlayaz_get_marker_list(const overlayaz_t *o)
+overlayaz_marker_store_t*
+overlayaz_get_marker_store(const overlayaz_t *o)
+{
+    return o->markers;
+}
+
+overlayaz_marker_style_t*
+overlayaz_get_marker_style(const overlayaz_t *o)
 {
-    return o->marker_list;
+    return o->marker_style;
 }
 
 static void
@@ -635,9 +652,20 @@ ref_update(overlayaz_t             *o,
 }
 
 static void
-marker_changed(overlayaz_t *o)
+marker_changed(gpointer                           data,
+               enum overlayaz_marker_store_event  event,
+               gint                               id)
+{
+    overlayaz_set_changed((overlayaz_t*)data);
+}
+
+static inline void
+overlayaz_set_changed(overlayaz_t *o)
 {
+    /* Unlike the changed flag, the revision is never reset
+       and any drawing made at an older one is outdated */
     o->changed = TRUE;
+    o->revision++;
 }
 
 static inline gboolean
@@ -16,8 +16,10 @@
 #ifndef OVERLAYAZ_H_
 #define OVERLAYAZ_H_
 #include "location.h"
-#include "marker.h"
+#include "marker-store.h"
+#include "marker-style.h"
 #include "font.h"
+#include "image.h"
 
 #define OVERLAYAZ_NAME "overlayaz"
 #define OVERLAYAZ_VERSION "1.1"
@@ -49,12 +51,13 @@ void overlayaz_free(overlayaz_t*);
 void overlayaz_reset(overlayaz_t*);
 gboolean overlayaz_changed(const overlayaz_t*);
 void overlayaz_unchanged(overlayaz_t*);
+guint overlayaz_get_revision(const overlayaz_t*);
 
 void overlayaz_set_filename(overlayaz_t*, const gchar*);
 const gchar* overlayaz_get_filename(const overlayaz_t*);
 
-void overlayaz_set_pixbuf(overlayaz_t*, GdkPixbuf*);
-const GdkPixbuf* overlayaz_get_pixbuf(const overlayaz_t*);
+void overlayaz_set_image(overlayaz_t*, overlayaz_image_t*);
+const overlayaz_image_t* overlayaz_get_image(const overlayaz_t*);
 gint overlayaz_get_width(const overlayaz_t*);
 gint overlayaz_get_height(const overlayaz_t*);
 
@@ -91,11 +94,12 @@ void overlayaz_set_grid_color(overlayaz_t*, const GdkRGBA*);
 const GdkRGBA* overlayaz_get_grid_color(const overlayaz_t*);
 
 void overlayaz_set_grid_font(overlayaz_t*, const gchar*);
-const overlayaz_font_t* overlayaz_get_grid_font(const overlayaz_t*);
+overlayaz_font_t* overlayaz_get_grid_font(const overlayaz_t*);
 
 void overlayaz_set_grid_font_color(overlayaz_t*, const GdkRGBA*);
 const GdkRGBA* overlayaz_get_grid_font_color(const overlayaz_t*);
 
-GtkListStore* overlayaz_get_marker_list(const overlayaz_t*);
+overlayaz_marker_store_t* overlayaz_get_marker_store(const overlayaz_t*);
+overlayaz_marker_style_t* overlayaz_get_marker_style(const overlayaz_t*);
 
 #endif
@@ -0,0 +1,302 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include <gtk/gtk.h>
+#include "pixel.h"
+
+/* The vector kernels are selected at runtime on x86, NEON is always there on AArch64 */
+#if defined(__GNUC__) && defined(__SSE2__)
+#define PIXEL_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && G_BYTE_ORDER == G_LITTLE_ENDIAN
+#define PIXEL_NEON 1
+#include <arm_neon.h>
+#endif
+
+/* Same rounding as GDK: c * a / 255 */
+#define PIXEL_PREMULTIPLY(c, a, t) ((t) = (c) * (a) + 0x80, (((t) >> 8) + (t)) >> 8)
+
+static void pixel_convert_rgb(const guint8*, guint32*, gint);
+static void pixel_convert_rgba(const guint8*, guint32*, gint);
+#ifdef PIXEL_X86
+static gint pixel_convert_rgb_ssse3(const guint8*, guint32*, gint);
+static gint pixel_convert_rgb_avx2(const guint8*, guint32*, gint);
+static gint pixel_convert_rgba_sse2(const guint8*, guint32*, gint);
+#endif
+#ifdef PIXEL_NEON
+static gint pixel_convert_rgb_neon(const guint8*, guint32*, gint);
+#endif
+
+
+void
+overlayaz_pixel_convert(const guint8 *src,
+                        gint          n_channels,
+                        guint8       *dst,
+                        gint          count)
+{
+    guint32 *out = (guint32*)dst;
+    gint done = 0;
+
+    if (n_channels == 3)
+    {
+#if defined(PIXEL_X86)
+        if (__builtin_cpu_supports("avx2"))
+            done = pixel_convert_rgb_avx2(src, out, count);
+        else if (__builtin_cpu_supports("ssse3"))
+            done = pixel_convert_rgb_ssse3(src, out, count);
+#elif defined(PIXEL_NEON)
+        done = pixel_convert_rgb_neon(src, out, count);
+#endif
+        pixel_convert_rgb(src + done * 3, out + done, count - done);
+    }
+    else
+    {
+#ifdef PIXEL_X86
+        done = pixel_convert_rgba_sse2(src, out, count);
+#endif
+        pixel_convert_rgba(src + done * 4, out + done, count - done);
+    }
+}
+
+void
+overlayaz_pixel_convert_scalar(const guint8 *src,
+                               gint          n_channels,
+                               guint8       *dst,
+                               gint          count)
+{
+    if (n_channels == 3)
+        pixel_convert_rgb(src, (guint32*)dst, count);
+    else
+        pixel_convert_rgba(src, (guint32*)dst, count);
+}
+
+void
+overlayaz_pixel_fill(cairo_surface_t *surface,
+                     const guint8    *src,
+                     gint             src_stride,
+                     gint             n_channels)
+{
+    guint8 *dst;
+    gint width, height;
+    gint dst_stride;
+    gint y;
+
+    cairo_surface_flush(surface);
+    dst = cairo_image_surface_get_data(surface);
+    dst_stride = cairo_image_surface_get_stride(surface);
+    width = cairo_image_surface_get_width(surface);
+    height = cairo_image_surface_get_height(surface);
+
+    for (y = 0; y < height; y++)
+        overlayaz_pixel_convert(src + (gsize)y * src_stride, n_channels, dst + (gsize)y * dst_stride, width);
+
+    cairo_surface_mark_dirty(surface);
+}
+
+cairo_surface_t*
+overlayaz_pixel_surface(const GdkPixbuf *pixbuf)
+{
+    cairo_surface_t *surface;
+
+    surface = cairo_image_surface_create(gdk_pixbuf_get_has_alpha(pixbuf) ? CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24,
+                                         gdk_pixbuf_get_width(pixbuf),
+                                         gdk_pixbuf_get_height(pixbuf));
+    overlayaz_pixel_fill(surface, gdk_pixbuf_read_pixels(pixbuf),
+                         gdk_pixbuf_get_rowstride(pixbuf),
+                         gdk_pixbuf_get_n_channels(pixbuf));
+    return surface;
+}
+
+void
+overlayaz_pixel_halve(const guint8 *src,
+                      gint          src_stride,
+                      gint          width,
+                      gint          height,
+                      guint8       *dst,
+                      gint          dst_stride)
+{
+    const guint32 *row[2];
+    guint32 *out;
+    guint32 p[4];
+    guint32 rb, ag;
+    gint x, y, i;
+
+    for (y = 0; y < (height + 1) / 2; y++)
+    {
+        row[0] = (const guint32*)(src + (gsize)(2 * y) * src_stride);
+        row[1] = (const guint32*)(src + (gsize)MIN(2 * y + 1, height - 1) * src_stride);
+        out = (guint32*)(dst + (gsize)y * dst_stride);
+
+        for (x = 0; x < (width + 1) / 2; x++)
+        {
+            p[0] = row[0][2 * x];
+            p[1] = row[0][MIN(2 * x + 1, width - 1)];
+            p[2] = row[1][2 * x];
+            p[3] = row[1][MIN(2 * x + 1, width - 1)];
+
+            /* Two channels at once, the sums of four fit in 16 bits */
+            rb = ag = 0;
+            for (i = 0; i < 4; i++)
+            {
+                rb += p[i] & 0x00FF00FF;
+                ag += (p[i] >> 8) & 0x00FF00FF;
+            }
+
+            out[x] = ((rb + 0x00020002) >> 2 & 0x00FF00FF) |
+                     ((ag + 0x00020002) >> 2 & 0x00FF00FF) << 8;
+        }
+    }
+}
+
+static void
+pixel_convert_rgb(const guint8 *src,
+                  guint32      *dst,
+                  gint          count)
+{
+    gint i;
+
+    for (i = 0; i < count; i++, src += 3)
+        dst[i] = 0xFF000000 | (guint32)src[0] << 16 | (guint32)src[1] << 8 | src[2];
+}
+
+static void
+pixel_convert_rgba(const guint8 *src,
+                   guint32      *dst,
+                   gint          count)
+{
+    guint32 t1, t2, t3;
+    gint i;
+
+    for (i = 0; i < count; i++, src += 4)
+    {
+        if (src[3] == 0)
+            dst[i] = 0;
+        else
+            dst[i] = (guint32)src[3] << 24 |
+                     PIXEL_PREMULTIPLY(src[0], src[3], t1) << 16 |
+                     PIXEL_PREMULTIPLY(src[1], src[3], t2) << 8 |
+                     PIXEL_PREMULTIPLY(src[2], src[3], t3);
+    }
+}
+
+#ifdef PIXEL_X86
+/* Four pixels from 12 bytes: R G B becomes B G R A */
+#define PIXEL_SHUFFLE_RGB 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1
+
+__attribute__((target("ssse3")))
+static gint
+pixel_convert_rgb_ssse3(const guint8 *src,
+                        guint32      *dst,
+                        gint          count)
+{
+    const __m128i shuffle = _mm_setr_epi8(PIXEL_SHUFFLE_RGB);
+    const __m128i alpha = _mm_set1_epi32((gint)0xFF000000);
+    __m128i v;
+    gint i;
+
+    /* Every load takes 16 bytes, but only 12 of them are used */
+    for (i = 0; i + 6 <= count; i += 4)
+    {
+        v = _mm_loadu_si128((const __m128i*)(src + i * 3));
+        v = _mm_or_si128(_mm_shuffle_epi8(v, shuffle), alpha);
+        _mm_storeu_si128((__m128i*)(dst + i), v);
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2")))
+static gint
+pixel_convert_rgb_avx2(const guint8 *src,
+                       guint32      *dst,
+                       gint          count)
+{
+    const __m256i shuffle = _mm256_setr_epi8(PIXEL_SHUFFLE_RGB, PIXEL_SHUFFLE_RGB);
+    const __m256i spread = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+    const __m256i alpha = _mm256_set1_epi32((gint)0xFF000000);
+    __m256i v;
+    gint i;
+
+    /* Eight pixels at once: the second group of 12 bytes is moved to the upper lane */
+    for (i = 0; i + 11 <= count; i += 8)
+    {
+        v = _mm256_loadu_si256((const __m256i*)(src + i * 3));
+        v = _mm256_permutevar8x32_epi32(v, spread);
+        v = _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), alpha);
+        _mm256_storeu_si256((__m256i*)(dst + i), v);
+    }
+
+    return i;
+}
+
+static gint
+pixel_convert_rgba_sse2(const guint8 *src,
+                        guint32      *dst,
+                        gint          count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(0x80);
+    const __m128i mask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+    __m128i v, lo, hi, a;
+    gint i;
+
+    for (i = 0; i + 4 <= count; i += 4)
+    {
+        v = _mm_loadu_si128((const __m128i*)(src + i * 4));
+        lo = _mm_unpacklo_epi8(v, zero);
+        hi = _mm_unpackhi_epi8(v, zero);
+
+        /* Each channel is multiplied by the alpha, which is then put back as it was */
+        a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        a = _mm_or_si128(_mm_andnot_si128(mask, _mm_add_epi16(_mm_mullo_epi16(lo, a), round)), _mm_and_si128(mask, lo));
+        lo = _mm_or_si128(_mm_andnot_si128(mask, _mm_srli_epi16(_mm_add_epi16(_mm_srli_epi16(a, 8), a), 8)), _mm_and_si128(mask, lo));
+
+        a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        a = _mm_or_si128(_mm_andnot_si128(mask, _mm_add_epi16(_mm_mullo_epi16(hi, a), round)), _mm_and_si128(mask, hi));
+        hi = _mm_or_si128(_mm_andnot_si128(mask, _mm_srli_epi16(_mm_add_epi16(_mm_srli_epi16(a, 8), a), 8)), _mm_and_si128(mask, hi));
+
+        /* R G B A becomes B G R A */
+        lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2));
+        hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+
+    return i;
+}
+#endif
+
+#ifdef PIXEL_NEON
+static gint
+pixel_convert_rgb_neon(const guint8 *src,
+                       guint32      *dst,
+                       gint          count)
+{
+    uint8x16x3_t rgb;
+    uint8x16x4_t bgra;
+    gint i;
+
+    bgra.val[3] = vdupq_n_u8(0xFF);
+    for (i = 0; i + 16 <= count; i += 16)
+    {
+        rgb = vld3q_u8(src + i * 3);
+        bgra.val[0] = rgb.val[2];
+        bgra.val[1] = rgb.val[1];
+        bgra.val[2] = rgb.val[0];
+        vst4q_u8((guint8*)(dst + i), bgra);
+    }
+
+    return i;
+}
+#endif
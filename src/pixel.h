@@ -0,0 +1,31 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef OVERLAYAZ_PIXEL_H_
+#define OVERLAYAZ_PIXEL_H_
+
+/* Converts a row of packed RGB or RGBA (3 or 4 channels) pixels
+ * to the native endian xRGB32 or premultiplied ARGB32 of cairo */
+void overlayaz_pixel_convert(const guint8*, gint, guint8*, gint);
+void overlayaz_pixel_convert_scalar(const guint8*, gint, guint8*, gint);
+
+/* Fills a whole image surface from rows of packed pixels */
+void overlayaz_pixel_fill(cairo_surface_t*, const guint8*, gint, gint);
+cairo_surface_t* overlayaz_pixel_surface(const GdkPixbuf*);
+
+/* Averages every 2x2 block of 32-bit pixels, the last odd row and column are repeated */
+void overlayaz_pixel_halve(const guint8*, gint, gint, gint, guint8*, gint);
+
+#endif
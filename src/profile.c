@@ -19,8 +19,6 @@
 #include <math.h>
 #include "overlayaz.h"
 #include "profile.h"
-#include "marker-iter.h"
-#include "marker-list.h"
 
 #define PROFILE_VERSION 1
 
@@ -210,12 +208,14 @@ profile_parse(overlayaz_t *o,
     if (json_object_object_get_ex(root, PROFILE_KEY_MARKER, &object) &&
         json_object_is_type(object, json_type_array))
     {
+        overlayaz_marker_store_begin(overlayaz_get_marker_store(o));
         for (i = 0; i < json_object_array_length(object); i++)
         {
             arr_object = json_object_array_get_idx(object, i);
             if (json_object_is_type(arr_object, json_type_object))
                 profile_parse_marker(o, arr_object);
         }
+        overlayaz_marker_store_commit(overlayaz_get_marker_store(o));
     }
 
     return OVERLAYAZ_PROFILE_LOAD_OK;
@@ -348,76 +348,82 @@ static void
 profile_parse_marker(overlayaz_t *o,
                      json_object *root)
 {
+    overlayaz_marker_store_t *markers = overlayaz_get_marker_store(o);
+    overlayaz_marker_style_t *style = overlayaz_get_marker_style(o);
     json_object *object;
     gdouble value;
-    overlayaz_marker_t *m = overlayaz_marker_new();
+    const gchar *font = overlayaz_font_get(overlayaz_marker_style_get_font(style, OVERLAYAZ_MARKER_STYLE_DEFAULT));
+    GdkRGBA color = *overlayaz_marker_style_get_color(style, OVERLAYAZ_MARKER_STYLE_DEFAULT);
+    GdkRGBA parsed;
+    gint id = overlayaz_marker_store_add(markers);
 
     if (json_object_object_get_ex(root, PROFILE_KEY_MARKER_NAME, &object) &&
         json_object_is_type(object, json_type_string))
     {
-        overlayaz_marker_set_name(m, json_object_get_string(object));
+        overlayaz_marker_store_set_name(markers, id, json_object_get_string(object));
     }
 
     if (json_object_object_get_ex(root, PROFILE_KEY_MARKER_LATITUDE, &object) &&
         profile_json_get_double(object, &value))
     {
-        overlayaz_marker_set_latitude(m, value);
+        overlayaz_marker_store_set_latitude(markers, id, value);
     }
 
     if (json_object_object_get_ex(root, PROFILE_KEY_MARKER_LONGITUDE, &object) &&
         profile_json_get_double(object, &value))
     {
-        overlayaz_marker_set_longitude(m, value);
+        overlayaz_marker_store_set_longitude(markers, id, value);
     }
 
     if (json_object_object_get_ex(root, PROFILE_KEY_MARKER_TICK, &object) &&
         json_object_is_type(object, json_type_string))
     {
         if (g_strcmp0(json_object_get_string(object), PROFILE_VALUE_MARKER_TICK_TOP) == 0)
-            overlayaz_marker_set_tick(m, OVERLAYAZ_MARKER_TICK_TOP);
+            overlayaz_marker_store_set_tick(markers, id, OVERLAYAZ_MARKER_TICK_TOP);
         else if (g_strcmp0(json_object_get_string(object), PROFILE_VALUE_MARKER_TICK_BOTTOM) == 0)
-            overlayaz_marker_set_tick(m, OVERLAYAZ_MARKER_TICK_BOTTOM);
+            overlayaz_marker_store_set_tick(markers, id, OVERLAYAZ_MARKER_TICK_BOTTOM);
         else
-            overlayaz_marker_set_tick(m, OVERLAYAZ_MARKER_TICK_NONE);
+            overlayaz_marker_store_set_tick(markers, id, OVERLAYAZ_MARKER_TICK_NONE);
     }
 
     if (json_object_object_get_ex(root, PROFILE_KEY_MARKER_FONT, &object) &&
         json_object_is_type(object, json_type_string))
     {
-        overlayaz_marker_set_font(m, json_object_get_string(object));
+        font = json_object_get_string(object);
     }
 
     if (json_object_object_get_ex(root, PROFILE_KEY_MARKER_FONT_COLOR, &object) &&
-        json_object_is_type(object, json_type_string))
+        json_object_is_type(object, json_type_string) &&
+        gdk_rgba_parse(&parsed, json_object_get_string(object)))
     {
-        overlayaz_marker_set_font_color(m, json_object_get_string(object));
+        color = parsed;
     }
 
+    overlayaz_marker_store_set_style(markers, id, overlayaz_marker_style_lookup(style, font, &color));
+
     if (json_object_object_get_ex(root, PROFILE_KEY_MARKER_POSITION, &object) &&
         profile_json_get_double(object, &value))
     {
-        overlayaz_marker_set_position(m, value);
+        overlayaz_marker_store_set_position(markers, id, value);
     }
 
     if (json_object_object_get_ex(root, PROFILE_KEY_MARKER_ACTIVE, &object) &&
         json_object_is_type(object, json_type_boolean))
     {
-        overlayaz_marker_set_active(m, json_object_get_boolean(object));
+        overlayaz_marker_store_set_active(markers, id, json_object_get_boolean(object));
     }
 
     if (json_object_object_get_ex(root, PROFILE_KEY_MARKER_SHOW_AZIMUTH, &object) &&
         json_object_is_type(object, json_type_boolean))
     {
-        overlayaz_marker_set_show_azimuth(m, json_object_get_boolean(object));
+        overlayaz_marker_store_set_show_azimuth(markers, id, json_object_get_boolean(object));
     }
 
     if (json_object_object_get_ex(root, PROFILE_KEY_MARKER_SHOW_DISTANCE, &object) &&
         json_object_is_type(object, json_type_boolean))
     {
-        overlayaz_marker_set_show_distance(m, json_object_get_boolean(object));
+        overlayaz_marker_store_set_show_distance(markers, id, json_object_get_boolean(object));
     }
-
-    overlayaz_marker_list_add(overlayaz_get_marker_list(o), m);
 }
 
 static json_object*
@@ -538,24 +544,26 @@ profile_build_markers(const overlayaz_t    *o,
                       json_object          *root,
                       const gchar          *key)
 {
+    const overlayaz_marker_store_t *markers = overlayaz_get_marker_store(o);
+    const overlayaz_marker_style_t *style = overlayaz_get_marker_style(o);
     json_object *array, *root_marker;
-    overlayaz_marker_iter_t *iter;
-    const overlayaz_marker_t *m;
     gchar *color;
+    guint style_id;
+    gint id;
 
-    iter = overlayaz_marker_iter_new(overlayaz_get_marker_list(o), &m);
-    if (iter == NULL)
+    if (overlayaz_marker_store_count(markers) == 0)
         return;
 
     array = json_object_new_array();
-    do
+    for (id = 0; id < overlayaz_marker_store_count(markers); id++)
     {
         root_marker = json_object_new_object();
-        color = gdk_rgba_to_string(overlayaz_marker_get_font_color(m));
-        json_object_object_add(root_marker, PROFILE_KEY_MARKER_NAME, json_object_new_string(overlayaz_marker_get_name(m)));
-        json_object_object_add(root_marker, PROFILE_KEY_MARKER_LATITUDE, profile_json_new_double(overlayaz_marker_get_latitude(m)));
-        json_object_object_add(root_marker, PROFILE_KEY_MARKER_LONGITUDE, profile_json_new_double(overlayaz_marker_get_longitude(m)));
-        switch (overlayaz_marker_get_tick(m))
+        style_id = overlayaz_marker_store_get_style(markers, id);
+        color = gdk_rgba_to_string(overlayaz_marker_style_get_color(style, style_id));
+        json_object_object_add(root_marker, PROFILE_KEY_MARKER_NAME, json_object_new_string(overlayaz_marker_store_get_name(markers, id)));
+        json_object_object_add(root_marker, PROFILE_KEY_MARKER_LATITUDE, profile_json_new_double(overlayaz_marker_store_get_latitude(markers, id)));
+        json_object_object_add(root_marker, PROFILE_KEY_MARKER_LONGITUDE, profile_json_new_double(overlayaz_marker_store_get_longitude(markers, id)));
+        switch (overlayaz_marker_store_get_tick(markers, id))
         {
         case OVERLAYAZ_MARKER_TICK_TOP:
             json_object_object_add(root_marker, PROFILE_KEY_MARKER_TICK, json_object_new_string(PROFILE_VALUE_MARKER_TICK_TOP));
@@ -567,18 +575,17 @@ profile_build_markers(const overlayaz_t    *o,
             json_object_object_add(root_marker, PROFILE_KEY_MARKER_TICK, json_object_new_string(PROFILE_VALUE_MARKER_TICK_NONE));
             break;
         }
-        json_object_object_add(root_marker, PROFILE_KEY_MARKER_FONT, json_object_new_string(overlayaz_font_get(overlayaz_marker_get_font(m))));
+        json_object_object_add(root_marker, PROFILE_KEY_MARKER_FONT, json_object_new_string(overlayaz_font_get(overlayaz_marker_style_get_font(style, style_id))));
         json_object_object_add(root_marker, PROFILE_KEY_MARKER_FONT_COLOR, json_object_new_string(color));
-        json_object_object_add(root_marker, PROFILE_KEY_MARKER_POSITION, profile_json_new_double(overlayaz_marker_get_position(m)));
-        json_object_object_add(root_marker, PROFILE_KEY_MARKER_ACTIVE, json_object_new_boolean(overlayaz_marker_get_active(m)));
-        json_object_object_add(root_marker, PROFILE_KEY_MARKER_SHOW_AZIMUTH, json_object_new_boolean(overlayaz_marker_get_show_azimuth(m)));
-        json_object_object_add(root_marker, PROFILE_KEY_MARKER_SHOW_DISTANCE, json_object_new_boolean(overlayaz_marker_get_show_distance(m)));
+        json_object_object_add(root_marker, PROFILE_KEY_MARKER_POSITION, profile_json_new_double(overlayaz_marker_store_get_position(markers, id)));
+        json_object_object_add(root_marker, PROFILE_KEY_MARKER_ACTIVE, json_object_new_boolean(overlayaz_marker_store_get_active(markers, id)));
+        json_object_object_add(root_marker, PROFILE_KEY_MARKER_SHOW_AZIMUTH, json_object_new_boolean(overlayaz_marker_store_get_show_azimuth(markers, id)));
+        json_object_object_add(root_marker, PROFILE_KEY_MARKER_SHOW_DISTANCE, json_object_new_boolean(overlayaz_marker_store_get_show_distance(markers, id)));
         json_object_array_add(array, root_marker);
         g_free(color);
-    } while (overlayaz_marker_iter_next(iter, &m));
+    }
 
     json_object_object_add(root, key, array);
-    overlayaz_marker_iter_free(iter);
 }
 
 static gboolean
@@ -0,0 +1,263 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include <gtk/gtk.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "rotate.h"
+
+/* Source positions are stepped in 32.32 fixed point */
+#define ROTATE_FRAC_BITS 32
+#define ROTATE_ONE       ((gint64)1 << ROTATE_FRAC_BITS)
+
+/* Bicubic weights are tabulated for this many subpixel phases, in 4.12 fixed point */
+#define ROTATE_PHASE_BITS 6
+#define ROTATE_PHASES     (1 << ROTATE_PHASE_BITS)
+#define ROTATE_CUBIC_BITS 12
+
+#define ROTATE_RGB_MASK 0x00FFFFFF
+
+struct rotate_source
+{
+    const guint8* const *rows;
+    gint width;
+    gint height;
+};
+
+static inline guint32 rotate_pixel(const struct rotate_source*, gint, gint);
+static inline guint32 rotate_fetch(const struct rotate_source*, gint, gint);
+static inline guint32 rotate_lerp(guint32, guint32, guint32);
+static inline guint32 rotate_nearest(const struct rotate_source*, gint64, gint64);
+static inline guint32 rotate_bilinear(const struct rotate_source*, gint64, gint64);
+static inline guint32 rotate_bicubic(const struct rotate_source*, gint64, gint64, const gint (*)[4]);
+static void rotate_cubic_weights(gint (*)[4]);
+
+
+void
+overlayaz_rotate(const guint8* const          *src,
+                 gint                          width,
+                 gint                          height,
+                 gdouble                       rotation,
+                 enum overlayaz_rotate_filter  filter,
+                 guint8                       *dst,
+                 gint                          dst_stride,
+                 gint                          first_row,
+                 gint                          rows)
+{
+    struct rotate_source source = { src, width, height };
+    gint cubic[ROTATE_PHASES][4];
+    gdouble angle = rotation * G_PI / 180.0;
+    gdouble c = cos(angle);
+    gdouble s = sin(angle);
+    gdouble cx = width / 2.0;
+    gdouble cy = height / 2.0;
+    gint64 u, v, du, dv;
+    guint32 *out;
+    gint x, y;
+
+    if (filter == OVERLAYAZ_ROTATE_BICUBIC)
+        rotate_cubic_weights(cubic);
+
+    /* Both steps are constant along a row. Leveling rotations are small,
+       so every destination row walks along one or two source rows. */
+    du = llround(c * ROTATE_ONE);
+    dv = llround(-s * ROTATE_ONE);
+
+    for (y = first_row; y < first_row + rows; y++)
+    {
+        /* Positions are measured from the center of the top left source pixel */
+        u = llround((cx + c * (0.5 - cx) + s * (y + 0.5 - cy) - 0.5) * ROTATE_ONE);
+        v = llround((cy - s * (0.5 - cx) + c * (y + 0.5 - cy) - 0.5) * ROTATE_ONE);
+        out = (guint32*)(dst + (gsize)(y - first_row) * dst_stride);
+
+        switch (filter)
+        {
+        case OVERLAYAZ_ROTATE_NEAREST:
+            for (x = 0; x < width; x++, u += du, v += dv)
+                out[x] = rotate_nearest(&source, u, v);
+            break;
+        case OVERLAYAZ_ROTATE_BILINEAR:
+            for (x = 0; x < width; x++, u += du, v += dv)
+                out[x] = rotate_bilinear(&source, u, v);
+            break;
+        case OVERLAYAZ_ROTATE_BICUBIC:
+            for (x = 0; x < width; x++, u += du, v += dv)
+                out[x] = rotate_bicubic(&source, u, v, (const gint (*)[4])cubic);
+            break;
+        }
+    }
+}
+
+static inline guint32
+rotate_pixel(const struct rotate_source *source,
+             gint                        x,
+             gint                        y)
+{
+    return ((const guint32*)source->rows[y])[x] & ROTATE_RGB_MASK;
+}
+
+static inline guint32
+rotate_fetch(const struct rotate_source *source,
+             gint                        x,
+             gint                        y)
+{
+    if (x < 0 || y < 0 || x >= source->width || y >= source->height)
+        return 0;
+    return rotate_pixel(source, x, y);
+}
+
+/* Blends two pixels with a weight of 0-255, two channels at once */
+static inline guint32
+rotate_lerp(guint32 a,
+            guint32 b,
+            guint32 w)
+{
+    guint32 rb = (((a & 0xFF00FF) * (256 - w) + (b & 0xFF00FF) * w) >> 8) & 0xFF00FF;
+    guint32 g = (((a & 0x00FF00) * (256 - w) + (b & 0x00FF00) * w) >> 8) & 0x00FF00;
+    return rb | g;
+}
+
+static inline guint32
+rotate_nearest(const struct rotate_source *source,
+               gint64                      u,
+               gint64                      v)
+{
+    return rotate_fetch(source,
+                        (gint)((u + ROTATE_ONE / 2) >> ROTATE_FRAC_BITS),
+                        (gint)((v + ROTATE_ONE / 2) >> ROTATE_FRAC_BITS));
+}
+
+static inline guint32
+rotate_bilinear(const struct rotate_source *source,
+                gint64                      u,
+                gint64                      v)
+{
+    gint x = (gint)(u >> ROTATE_FRAC_BITS);
+    gint y = (gint)(v >> ROTATE_FRAC_BITS);
+    guint32 wx = (guint32)(u >> (ROTATE_FRAC_BITS - 8)) & 0xFF;
+    guint32 wy = (guint32)(v >> (ROTATE_FRAC_BITS - 8)) & 0xFF;
+    guint32 p[4];
+
+    if (x >= 0 && y >= 0 && x + 1 < source->width && y + 1 < source->height)
+    {
+        p[0] = rotate_pixel(source, x, y);
+        p[1] = rotate_pixel(source, x + 1, y);
+        p[2] = rotate_pixel(source, x, y + 1);
+        p[3] = rotate_pixel(source, x + 1, y + 1);
+    }
+    else
+    {
+        /* Pixels outside of the source are black, as with CAIRO_EXTEND_NONE over a black target */
+        p[0] = rotate_fetch(source, x, y);
+        p[1] = rotate_fetch(source, x + 1, y);
+        p[2] = rotate_fetch(source, x, y + 1);
+        p[3] = rotate_fetch(source, x + 1, y + 1);
+    }
+
+    return rotate_lerp(rotate_lerp(p[0], p[1], wx),
+                       rotate_lerp(p[2], p[3], wx),
+                       wy);
+}
+
+static inline guint32
+rotate_bicubic(const struct rotate_source *source,
+               gint64                      u,
+               gint64                      v,
+               const gint                (*cubic)[4])
+{
+    gint x = (gint)(u >> ROTATE_FRAC_BITS);
+    gint y = (gint)(v >> ROTATE_FRAC_BITS);
+    const gint *wx = cubic[(u >> (ROTATE_FRAC_BITS - ROTATE_PHASE_BITS)) & (ROTATE_PHASES - 1)];
+    const gint *wy = cubic[(v >> (ROTATE_FRAC_BITS - ROTATE_PHASE_BITS)) & (ROTATE_PHASES - 1)];
+    gint row[3];
+    gint sum[3] = { 0, 0, 0 };
+    guint32 p;
+    gint i, j, k;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(1 << (ROTATE_CUBIC_BITS - 1));
+    __m128i w02, w13, w01, w23;
+    __m128i taps, lo, hi, rows[4], pair;
+    __m128i total;
+
+    if (x >= 1 && y > 0 && x + 2 < source->width && y + 2 < source->height)
+    {
+        /* The four taps of a row are adjacent: the channels of pixels 0 and 2, then 1 and 3
+           are interleaved, so that a multiply-add sums them with their weights */
+        w02 = _mm_set_epi16(wx[2], wx[0], wx[2], wx[0], wx[2], wx[0], wx[2], wx[0]);
+        w13 = _mm_set_epi16(wx[3], wx[1], wx[3], wx[1], wx[3], wx[1], wx[3], wx[1]);
+        for (j = 0; j < 4; j++)
+        {
+            taps = _mm_loadu_si128((const __m128i*)((const guint32*)source->rows[y + j - 1] + x - 1));
+            lo = _mm_unpacklo_epi8(taps, zero);
+            hi = _mm_unpackhi_epi8(taps, zero);
+            rows[j] = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(lo, hi), w02),
+                                    _mm_madd_epi16(_mm_unpackhi_epi16(lo, hi), w13));
+            rows[j] = _mm_srai_epi32(_mm_add_epi32(rows[j], round), ROTATE_CUBIC_BITS);
+        }
+
+        /* Same for the columns, the rows fit in 16 bits again */
+        w01 = _mm_set_epi16(wy[1], wy[0], wy[1], wy[0], wy[1], wy[0], wy[1], wy[0]);
+        w23 = _mm_set_epi16(wy[3], wy[2], wy[3], wy[2], wy[3], wy[2], wy[3], wy[2]);
+        pair = _mm_unpacklo_epi16(_mm_packs_epi32(rows[0], rows[0]), _mm_packs_epi32(rows[1], rows[1]));
+        total = _mm_madd_epi16(pair, w01);
+        pair = _mm_unpacklo_epi16(_mm_packs_epi32(rows[2], rows[2]), _mm_packs_epi32(rows[3], rows[3]));
+        total = _mm_add_epi32(total, _mm_madd_epi16(pair, w23));
+        total = _mm_srai_epi32(_mm_add_epi32(total, round), ROTATE_CUBIC_BITS);
+        total = _mm_packs_epi32(total, total);
+        return (guint32)_mm_cvtsi128_si32(_mm_packus_epi16(total, total)) & ROTATE_RGB_MASK;
+    }
+#endif
+
+    for (j = 0; j < 4; j++)
+    {
+        row[0] = row[1] = row[2] = 0;
+        for (i = 0; i < 4; i++)
+        {
+            p = rotate_fetch(source, x + i - 1, y + j - 1);
+            row[0] += (gint)(p >> 16) * wx[i];
+            row[1] += (gint)((p >> 8) & 0xFF) * wx[i];
+            row[2] += (gint)(p & 0xFF) * wx[i];
+        }
+
+        for (k = 0; k < 3; k++)
+            sum[k] += ((row[k] + (1 << (ROTATE_CUBIC_BITS - 1))) >> ROTATE_CUBIC_BITS) * wy[j];
+    }
+
+    for (k = 0; k < 3; k++)
+        sum[k] = CLAMP((sum[k] + (1 << (ROTATE_CUBIC_BITS - 1))) >> ROTATE_CUBIC_BITS, 0, 255);
+
+    return (guint32)sum[0] << 16 | (guint32)sum[1] << 8 | (guint32)sum[2];
+}
+
+/* Catmull-Rom spline, as used by cairo for CAIRO_FILTER_BEST */
+static void
+rotate_cubic_weights(gint (*cubic)[4])
+{
+    gdouble one = 1 << ROTATE_CUBIC_BITS;
+    gdouble t;
+    gint i;
+
+    for (i = 0; i < ROTATE_PHASES; i++)
+    {
+        t = i / (gdouble)ROTATE_PHASES;
+        cubic[i][0] = (gint)lround(one * ((-t + 2.0) * t - 1.0) * t / 2.0);
+        cubic[i][2] = (gint)lround(one * ((-3.0 * t + 4.0) * t + 1.0) * t / 2.0);
+        cubic[i][3] = (gint)lround(one * (t - 1.0) * t * t / 2.0);
+        cubic[i][1] = (1 << ROTATE_CUBIC_BITS) - cubic[i][0] - cubic[i][2] - cubic[i][3];
+    }
+}
@@ -0,0 +1,32 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef OVERLAYAZ_ROTATE_H_
+#define OVERLAYAZ_ROTATE_H_
+
+enum overlayaz_rotate_filter
+{
+    OVERLAYAZ_ROTATE_NEAREST,
+    OVERLAYAZ_ROTATE_BILINEAR,
+    OVERLAYAZ_ROTATE_BICUBIC
+};
+
+/* Rotates 32-bit xRGB pixels around the image center, like overlayaz_draw_rotate(),
+ * and writes the rows [first_row, first_row + rows) of the result to dst.
+ * The source is given as a table of its rows, which do not have to be contiguous.
+ * The stride is given in bytes, areas outside of the source are black. */
+void overlayaz_rotate(const guint8* const*, gint, gint, gdouble, enum overlayaz_rotate_filter, guint8*, gint, gint, gint);
+
+#endif
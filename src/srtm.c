@@ -15,10 +15,13 @@
 
 #include <glib.h>
 #include <glib/gstdio.h>
-#include <stdio.h>
-#include <sys/stat.h>
+#include <gio/gio.h>
 #include <stdint.h>
+#include <string.h>
 #include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "srtm.h"
 
 #define SRTM_VALUE_SIZEOF 2
@@ -31,7 +34,143 @@
 
 #define SRTM_INVALID -32768
 
-static enum overlayaz_srtm_error srtm_parse(const gchar*, gdouble, gdouble, int16_t*);
+/* Void marker as read from the file (big-endian 0x8000) */
+#define SRTM_INVALID_RAW GUINT16_FROM_BE(0x8000)
+
+/* Number of points interpolated at once */
+#define SRTM_SAMPLER_LANES 8
+
+/* Number of tiles kept mapped in memory */
+#define SRTM_CACHE_TILES 16
+
+/* Posts per side of the finest min/max pyramid block */
+#define SRTM_PYRAMID_BLOCK  16
+#define SRTM_PYRAMID_LEVELS 16
+
+/* Maximum number of blocks per side visited by a single query */
+#define SRTM_PYRAMID_SPAN 3
+
+#define SRTM_EXTENSION     ".hgt"
+#define SRTM_EXTENSION_GZ  ".hgt.gz"
+#define SRTM_EXTENSION_ZIP ".hgt.zip"
+
+/* Decoded tiles are kept in the user cache directory */
+#define SRTM_DECODED_DIR "overlayaz/srtm"
+
+#define SRTM_ZIP_SIGNATURE        0x04034b50
+#define SRTM_ZIP_HEADER_SIZE      30
+#define SRTM_ZIP_FLAG_DESCRIPTOR  (1 << 3)
+#define SRTM_ZIP_METHOD_STORED    0
+#define SRTM_ZIP_METHOD_DEFLATED  8
+#define SRTM_ZIP_U16(p) ((guint16)((p)[0] | (p)[1] << 8))
+#define SRTM_ZIP_U32(p) ((guint32)SRTM_ZIP_U16(p) | (guint32)SRTM_ZIP_U16((p) + 2) << 16)
+
+typedef struct srtm_pyramid
+{
+    gint levels;
+    gint size[SRTM_PYRAMID_LEVELS];
+    gint16 *min[SRTM_PYRAMID_LEVELS];
+    gint16 *max[SRTM_PYRAMID_LEVELS];
+} srtm_pyramid_t;
+
+typedef struct srtm_tile
+{
+    gchar *key;
+    GMappedFile *file;
+    GBytes *bytes;
+    const guint8 *data;
+    gint grid;
+    gint ref_count;
+    srtm_pyramid_t *pyramid;
+} srtm_tile_t;
+
+struct srtm_cache
+{
+    GMutex lock;
+    GHashTable *tiles;
+    GQueue lru;
+};
+
+struct srtm_index
+{
+    GMutex lock;
+    gchar *directory;
+    GHashTable *files;
+    GFileMonitor *monitor;
+    guint watch_source;
+};
+
+struct overlayaz_srtm_sampler
+{
+    gchar *directory;
+    srtm_tile_t *tile;
+    gboolean tile_valid;
+    gint tile_lat;
+    gint tile_lon;
+    enum overlayaz_srtm_error tile_error;
+};
+
+struct srtm_lookup
+{
+    gchar *directory;
+    gdouble latitude;
+    gdouble longitude;
+    gdouble value;
+};
+
+struct srtm_lanes
+{
+    guint16 raw[4][SRTM_SAMPLER_LANES];
+    gfloat wx[SRTM_SAMPLER_LANES];
+    gfloat wy[SRTM_SAMPLER_LANES];
+    gfloat out[SRTM_SAMPLER_LANES];
+    gint index[SRTM_SAMPLER_LANES];
+    gint count;
+};
+
+static struct srtm_cache cache;
+static struct srtm_index dir_index;
+
+static void srtm_lookup_thread(GTask*, gpointer, gpointer, GCancellable*);
+static void srtm_lookup_free(gpointer);
+
+static void srtm_index_build(const gchar*);
+static void srtm_index_clear(void);
+static gboolean srtm_index_watch(gpointer);
+static gchar* srtm_index_lookup(const gchar*, const gchar*, enum overlayaz_srtm_error*);
+static void srtm_index_changed(GFileMonitor*, GFile*, GFile*, GFileMonitorEvent, gpointer);
+static void srtm_index_add(GFile*);
+static void srtm_index_insert(gchar*, gchar*);
+static void srtm_index_remove(GFile*);
+static gchar* srtm_index_key(const gchar*);
+static gboolean srtm_compressed(const gchar*);
+static guint srtm_index_hash(gconstpointer);
+static gboolean srtm_index_equal(gconstpointer, gconstpointer);
+
+static srtm_tile_t* srtm_tile_get(const gchar*, gdouble, gdouble, enum overlayaz_srtm_error*);
+static srtm_tile_t* srtm_tile_open(const gchar*, enum overlayaz_srtm_error*);
+static gint srtm_tile_grid(gsize);
+static GBytes* srtm_decode(const gchar*, enum overlayaz_srtm_error*);
+static GInputStream* srtm_decode_zip(GInputStream*, const gchar*, gsize*);
+static gchar* srtm_decoded_path(const gchar*);
+static const gchar* srtm_decoded_dir(void);
+static gboolean srtm_decoded_valid(const gchar*, const gchar*);
+static void srtm_tile_drop(const gchar*);
+static void srtm_tile_unref(srtm_tile_t*);
+static void srtm_tile_free(srtm_tile_t*);
+static int16_t srtm_tile_read(const srtm_tile_t*, gdouble, gdouble);
+static const srtm_pyramid_t* srtm_tile_pyramid(srtm_tile_t*);
+
+static srtm_pyramid_t* srtm_pyramid_build(const srtm_tile_t*);
+static void srtm_pyramid_query(const srtm_pyramid_t*, const gint*, gint16*, gint16*);
+static void srtm_pyramid_free(srtm_pyramid_t*);
+
+static gboolean srtm_sampler_tile(overlayaz_srtm_sampler_t*, gdouble, gdouble);
+static void srtm_sampler_flush(struct srtm_lanes*, gdouble*);
+static void srtm_bilinear(const guint16[4][SRTM_SAMPLER_LANES], const gfloat*, const gfloat*, gfloat*);
+
+static guint64 srtm_batch_key(gdouble, gdouble);
+static gint srtm_batch_compare(gconstpointer, gconstpointer, gpointer);
 
 
 gchar*
@@ -51,112 +190,1310 @@ overlayaz_srtm_lookup(const gchar *directory,
                       gdouble      longitude,
                       gdouble     *out)
 {
-    GDir *dir;
-    gchar *srtm_filename;
-    const gchar *filename;
-    gchar *path;
+    srtm_tile_t *tile;
+    enum overlayaz_srtm_error error;
     int16_t value;
+
+    tile = srtm_tile_get(directory, latitude, longitude, &error);
+    if (tile == NULL)
+        return error;
+
+    value = srtm_tile_read(tile, latitude, longitude);
+    srtm_tile_unref(tile);
+
+    *out = value;
+    if (value == SRTM_INVALID)
+    {
+        g_warning("%s: Invalid value (%d)", __func__, SRTM_INVALID);
+        return OVERLAYAZ_SRTM_ERROR_INVALID;
+    }
+
+    return OVERLAYAZ_SRTM_OK;
+}
+
+void
+overlayaz_srtm_lookup_async(const gchar         *directory,
+                            gdouble              latitude,
+                            gdouble              longitude,
+                            GCancellable        *cancellable,
+                            GAsyncReadyCallback  callback,
+                            gpointer             user_data)
+{
+    struct srtm_lookup *lookup = g_malloc0(sizeof(struct srtm_lookup));
+    GTask *task;
+
+    lookup->directory = g_strdup(directory);
+    lookup->latitude = latitude;
+    lookup->longitude = longitude;
+
+    task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_task_data(task, lookup, srtm_lookup_free);
+    /* A lookup stuck on a slow file system must not hold the caller back */
+    g_task_set_return_on_cancel(task, TRUE);
+    g_task_run_in_thread(task, srtm_lookup_thread);
+    g_object_unref(task);
+}
+
+enum overlayaz_srtm_error
+overlayaz_srtm_lookup_finish(GAsyncResult *result,
+                             gdouble      *out)
+{
+    const struct srtm_lookup *lookup;
+    gssize error;
+
+    g_return_val_if_fail(g_task_is_valid(result, NULL), OVERLAYAZ_SRTM_ERROR_CANCELLED);
+
+    /* The only error a task returns is the cancellation */
+    error = g_task_propagate_int(G_TASK(result), NULL);
+    if (error < 0)
+        return OVERLAYAZ_SRTM_ERROR_CANCELLED;
+
+    lookup = g_task_get_task_data(G_TASK(result));
+    *out = lookup->value;
+    return (enum overlayaz_srtm_error)error;
+}
+
+gint
+overlayaz_srtm_lookup_batch(const gchar               *directory,
+                            const gdouble             *latitude,
+                            const gdouble             *longitude,
+                            gint                       count,
+                            gdouble                   *out,
+                            enum overlayaz_srtm_error *errors)
+{
+    guint64 *keys;
+    gint *order;
+    srtm_tile_t *tile;
     enum overlayaz_srtm_error error;
+    int16_t value;
+    gint i, j, k, n;
+    gint found = 0;
+
+    keys = g_new(guint64, count);
+    order = g_new(gint, count);
+
+    for (i = 0, n = 0; i < count; i++)
+    {
+        if (!isfinite(latitude[i]) || !isfinite(longitude[i]))
+        {
+            errors[i] = OVERLAYAZ_SRTM_ERROR_INVALID;
+            continue;
+        }
+
+        keys[i] = srtm_batch_key(latitude[i], longitude[i]);
+        order[n++] = i;
+    }
+
+    /* Group the points by tile and read each tile in memory order */
+    g_qsort_with_data(order, n, sizeof(gint), srtm_batch_compare, keys);
+
+    for (i = 0; i < n; i = j)
+    {
+        k = order[i];
+        tile = srtm_tile_get(directory, latitude[k], longitude[k], &error);
+
+        for (j = i; j < n && (keys[order[j]] >> 32) == (keys[k] >> 32); j++)
+        {
+            if (tile == NULL)
+            {
+                errors[order[j]] = error;
+                continue;
+            }
+
+            value = srtm_tile_read(tile, latitude[order[j]], longitude[order[j]]);
+            out[order[j]] = value;
+            if (value == SRTM_INVALID)
+                errors[order[j]] = OVERLAYAZ_SRTM_ERROR_INVALID;
+            else
+            {
+                errors[order[j]] = OVERLAYAZ_SRTM_OK;
+                found++;
+            }
+        }
+
+        if (tile)
+            srtm_tile_unref(tile);
+    }
+
+    g_free(order);
+    g_free(keys);
+    return found;
+}
+
+overlayaz_srtm_sampler_t*
+overlayaz_srtm_sampler_new(const gchar *directory)
+{
+    overlayaz_srtm_sampler_t *sampler = g_malloc0(sizeof(overlayaz_srtm_sampler_t));
+    sampler->directory = g_strdup(directory);
+    return sampler;
+}
+
+void
+overlayaz_srtm_sampler_free(overlayaz_srtm_sampler_t *sampler)
+{
+    if (sampler)
+    {
+        if (sampler->tile)
+            srtm_tile_unref(sampler->tile);
+        g_free(sampler->directory);
+        g_free(sampler);
+    }
+}
+
+enum overlayaz_srtm_error
+overlayaz_srtm_sampler_get(overlayaz_srtm_sampler_t *sampler,
+                           gdouble                   latitude,
+                           gdouble                   longitude,
+                           gdouble                  *out)
+{
+    enum overlayaz_srtm_error error;
+    overlayaz_srtm_sampler_get_n(sampler, &latitude, &longitude, 1, out, &error);
+    return error;
+}
+
+gint
+overlayaz_srtm_sampler_get_n(overlayaz_srtm_sampler_t  *sampler,
+                             const gdouble             *latitude,
+                             const gdouble             *longitude,
+                             gint                       count,
+                             gdouble                   *out,
+                             enum overlayaz_srtm_error *errors)
+{
+    struct srtm_lanes lanes;
+    const guint8 *data;
+    gdouble fx, fy;
+    gint x, y, grid, lane;
+    gsize offset;
+    gint i;
+    gint found = 0;
+
+    lanes.count = 0;
+    for (i = 0; i < count; i++)
+    {
+        if (!isfinite(latitude[i]) || !isfinite(longitude[i]))
+        {
+            errors[i] = OVERLAYAZ_SRTM_ERROR_INVALID;
+            continue;
+        }
+
+        if (!srtm_sampler_tile(sampler, latitude[i], longitude[i]))
+        {
+            errors[i] = sampler->tile_error;
+            continue;
+        }
+
+        grid = sampler->tile->grid;
+        data = sampler->tile->data;
+
+        /* Position within the tile, measured from its south-west corner */
+        fy = (latitude[i] - sampler->tile_lat) * (grid-1);
+        fx = (longitude[i] - sampler->tile_lon) * (grid-1);
+        y = MIN((gint)fy, grid-2);
+        x = MIN((gint)fx, grid-2);
+
+        /* Rows are stored from north to south */
+        offset = ((gsize)(grid-y-2) * grid + x) * SRTM_VALUE_SIZEOF;
+
+        lane = lanes.count;
+        memcpy(&lanes.raw[0][lane], data + offset, SRTM_VALUE_SIZEOF);
+        memcpy(&lanes.raw[1][lane], data + offset + SRTM_VALUE_SIZEOF, SRTM_VALUE_SIZEOF);
+        offset += (gsize)grid * SRTM_VALUE_SIZEOF;
+        memcpy(&lanes.raw[2][lane], data + offset, SRTM_VALUE_SIZEOF);
+        memcpy(&lanes.raw[3][lane], data + offset + SRTM_VALUE_SIZEOF, SRTM_VALUE_SIZEOF);
+
+        if (lanes.raw[0][lane] == SRTM_INVALID_RAW ||
+            lanes.raw[1][lane] == SRTM_INVALID_RAW ||
+            lanes.raw[2][lane] == SRTM_INVALID_RAW ||
+            lanes.raw[3][lane] == SRTM_INVALID_RAW)
+        {
+            /* Do not interpolate across voids, use the nearest post */
+            out[i] = srtm_tile_read(sampler->tile, latitude[i], longitude[i]);
+            if (out[i] == SRTM_INVALID)
+                errors[i] = OVERLAYAZ_SRTM_ERROR_INVALID;
+            else
+            {
+                errors[i] = OVERLAYAZ_SRTM_OK;
+                found++;
+            }
+            continue;
+        }
+
+        lanes.wx[lane] = (gfloat)(fx - x);
+        lanes.wy[lane] = (gfloat)(fy - y);
+        lanes.index[lane] = i;
+        errors[i] = OVERLAYAZ_SRTM_OK;
+        found++;
+
+        if (++lanes.count == SRTM_SAMPLER_LANES)
+            srtm_sampler_flush(&lanes, out);
+    }
+
+    if (lanes.count)
+        srtm_sampler_flush(&lanes, out);
+
+    return found;
+}
+
+enum overlayaz_srtm_error
+overlayaz_srtm_sampler_range(overlayaz_srtm_sampler_t *sampler,
+                             gdouble                   lat_min,
+                             gdouble                   lon_min,
+                             gdouble                   lat_max,
+                             gdouble                   lon_max,
+                             gdouble                  *min,
+                             gdouble                  *max)
+{
+    const srtm_pyramid_t *pyramid;
+    gint16 range_min = G_MAXINT16;
+    gint16 range_max = SRTM_INVALID;
+    gint rect[4];
+    gint lat, lon;
+    gint grid;
+
+    if (!isfinite(lat_min) || !isfinite(lon_min) ||
+        !isfinite(lat_max) || !isfinite(lon_max) ||
+        lat_min > lat_max || lon_min > lon_max)
+        return OVERLAYAZ_SRTM_ERROR_INVALID;
+
+    for (lat = (gint)floor(lat_min); lat <= (gint)floor(lat_max); lat++)
+    {
+        for (lon = (gint)floor(lon_min); lon <= (gint)floor(lon_max); lon++)
+        {
+            if (!srtm_sampler_tile(sampler, lat + 0.5, lon + 0.5))
+                return sampler->tile_error;
+
+            grid = sampler->tile->grid;
+            pyramid = srtm_tile_pyramid(sampler->tile);
+
+            /* Every post the interpolation may reach, rows from north to south */
+            rect[0] = (gint)floor((MAX(lon_min, lon) - lon) * (grid-1));
+            rect[1] = (gint)ceil((MIN(lon_max, lon + 1) - lon) * (grid-1));
+            rect[2] = grid - 1 - (gint)ceil((MIN(lat_max, lat + 1) - lat) * (grid-1));
+            rect[3] = grid - 1 - (gint)floor((MAX(lat_min, lat) - lat) * (grid-1));
+
+            srtm_pyramid_query(pyramid, rect, &range_min, &range_max);
+        }
+    }
+
+    /* There are voids only */
+    if (range_max == SRTM_INVALID)
+        return OVERLAYAZ_SRTM_ERROR_INVALID;
+
+    if (min)
+        *min = range_min;
+    if (max)
+        *max = range_max;
+    return OVERLAYAZ_SRTM_OK;
+}
+
+void
+overlayaz_srtm_set_directory(const gchar *directory)
+{
+    g_mutex_lock(&dir_index.lock);
+    if (dir_index.files == NULL ||
+        g_strcmp0(dir_index.directory, directory) != 0)
+    {
+        srtm_index_build(directory);
+    }
+    g_mutex_unlock(&dir_index.lock);
+}
+
+void
+overlayaz_srtm_free(void)
+{
+    srtm_tile_t *tile;
+
+    g_mutex_lock(&dir_index.lock);
+    srtm_index_clear();
+    g_mutex_unlock(&dir_index.lock);
+
+    g_mutex_lock(&cache.lock);
+    while ((tile = g_queue_pop_head(&cache.lru)))
+    {
+        if (--tile->ref_count == 0)
+            srtm_tile_free(tile);
+    }
+    if (cache.tiles)
+    {
+        g_hash_table_destroy(cache.tiles);
+        cache.tiles = NULL;
+    }
+    g_mutex_unlock(&cache.lock);
+}
+
+static void
+srtm_lookup_thread(GTask        *task,
+                   gpointer      source_object,
+                   gpointer      task_data,
+                   GCancellable *cancellable)
+{
+    struct srtm_lookup *lookup = (struct srtm_lookup*)task_data;
+    enum overlayaz_srtm_error error;
+
+    error = overlayaz_srtm_lookup(lookup->directory,
+                                  lookup->latitude,
+                                  lookup->longitude,
+                                  &lookup->value);
+
+    g_task_return_int(task, error);
+}
+
+static void
+srtm_lookup_free(gpointer data)
+{
+    struct srtm_lookup *lookup = (struct srtm_lookup*)data;
+
+    g_free(lookup->directory);
+    g_free(lookup);
+}
+
+static void
+srtm_index_build(const gchar *directory)
+{
+    GDir *dir;
+    const gchar *filename;
+    gchar *key;
+
+    srtm_index_clear();
+    dir_index.directory = g_strdup(directory);
 
     dir = g_dir_open(directory, 0, NULL);
     if (dir == NULL)
     {
         g_warning("%s: Failed to open directory %s", __func__, directory);
-        return OVERLAYAZ_SRTM_ERROR_DIR;
+        return;
     }
 
-    srtm_filename = overlayaz_srtm_filename(latitude, longitude);
-    error = OVERLAYAZ_SRTM_ERROR_MISSING;
+    /* Keys are compared case-insensitively, values hold the real path */
+    dir_index.files = g_hash_table_new_full(srtm_index_hash, srtm_index_equal, g_free, g_free);
     while ((filename = g_dir_read_name(dir)))
     {
-        if (g_ascii_strcasecmp(srtm_filename, filename) == 0)
+        key = srtm_index_key(filename);
+        if (key)
+            srtm_index_insert(key, g_build_filename(directory, filename, NULL));
+    }
+    g_dir_close(dir);
+
+    /* The monitor delivers its events to the context it was created in,
+       so it is created from the main loop, not from the calling thread */
+    dir_index.watch_source = g_idle_add(srtm_index_watch, NULL);
+}
+
+static void
+srtm_index_clear(void)
+{
+    if (dir_index.watch_source)
+    {
+        g_source_remove(dir_index.watch_source);
+        dir_index.watch_source = 0;
+    }
+
+    if (dir_index.monitor)
+    {
+        g_file_monitor_cancel(dir_index.monitor);
+        g_object_unref(dir_index.monitor);
+        dir_index.monitor = NULL;
+    }
+
+    if (dir_index.files)
+    {
+        g_hash_table_destroy(dir_index.files);
+        dir_index.files = NULL;
+    }
+
+    g_free(dir_index.directory);
+    dir_index.directory = NULL;
+}
+
+static gboolean
+srtm_index_watch(gpointer user_data)
+{
+    GFile *file;
+    GError *err = NULL;
+
+    g_mutex_lock(&dir_index.lock);
+    dir_index.watch_source = 0;
+
+    if (dir_index.files && dir_index.monitor == NULL)
+    {
+        file = g_file_new_for_path(dir_index.directory);
+        dir_index.monitor = g_file_monitor_directory(file, G_FILE_MONITOR_WATCH_MOVES, NULL, &err);
+        g_object_unref(file);
+
+        if (dir_index.monitor)
+            g_signal_connect(dir_index.monitor, "changed", G_CALLBACK(srtm_index_changed), NULL);
+        else
         {
-            path = g_build_filename(directory, filename, NULL);
-            error = srtm_parse(path, latitude, longitude, &value);
-            g_free(path);
-            break;
+            g_warning("%s: Unable to monitor %s: %s", __func__, dir_index.directory, err->message);
+            g_error_free(err);
         }
     }
 
-    if (error == OVERLAYAZ_SRTM_ERROR_MISSING)
-        g_warning("%s: Missing file %s", __func__, srtm_filename);
-    else if (error == OVERLAYAZ_SRTM_OK)
+    g_mutex_unlock(&dir_index.lock);
+    return G_SOURCE_REMOVE;
+}
+
+static gchar*
+srtm_index_lookup(const gchar               *directory,
+                  const gchar               *srtm_filename,
+                  enum overlayaz_srtm_error *error)
+{
+    gchar *path = NULL;
+
+    g_mutex_lock(&dir_index.lock);
+
+    /* The index is built on first use and whenever the directory changes.
+     * An unreadable directory is only retried by overlayaz_srtm_set_directory(). */
+    if (g_strcmp0(dir_index.directory, directory) != 0)
+    {
+        srtm_index_build(directory);
+    }
+
+    if (dir_index.files == NULL)
+        *error = OVERLAYAZ_SRTM_ERROR_DIR;
+    else
     {
-        *out = value;
-        if (value == SRTM_INVALID)
+        path = g_strdup(g_hash_table_lookup(dir_index.files, srtm_filename));
+        if (path == NULL)
         {
-            error = OVERLAYAZ_SRTM_ERROR_INVALID;
-            g_warning("%s: Invalid value (%d)", __func__, SRTM_INVALID);
+            g_warning("%s: Missing file %s", __func__, srtm_filename);
+            *error = OVERLAYAZ_SRTM_ERROR_MISSING;
         }
     }
 
+    g_mutex_unlock(&dir_index.lock);
+    return path;
+}
+
+static void
+srtm_index_changed(GFileMonitor      *monitor,
+                   GFile             *file,
+                   GFile             *other_file,
+                   GFileMonitorEvent  event_type,
+                   gpointer           user_data)
+{
+    gchar *path;
+
+    switch (event_type)
+    {
+    case G_FILE_MONITOR_EVENT_CREATED:
+    case G_FILE_MONITOR_EVENT_MOVED_IN:
+        srtm_index_add(file);
+        break;
+
+    case G_FILE_MONITOR_EVENT_DELETED:
+    case G_FILE_MONITOR_EVENT_MOVED_OUT:
+        srtm_index_remove(file);
+        break;
+
+    case G_FILE_MONITOR_EVENT_RENAMED:
+        srtm_index_remove(file);
+        srtm_index_add(other_file);
+        break;
+
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+        /* The tile was rewritten, map it again on next use */
+        path = g_file_get_path(file);
+        if (path)
+            srtm_tile_drop(path);
+        g_free(path);
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void
+srtm_index_add(GFile *file)
+{
+    gchar *filename;
+    gchar *key;
+
+    if (file == NULL)
+        return;
+
+    filename = g_file_get_basename(file);
+    key = (filename ? srtm_index_key(filename) : NULL);
+    g_free(filename);
+    if (key == NULL)
+        return;
+
+    g_mutex_lock(&dir_index.lock);
+    if (dir_index.files)
+        srtm_index_insert(key, g_file_get_path(file));
+    else
+        g_free(key);
+    g_mutex_unlock(&dir_index.lock);
+}
+
+static void
+srtm_index_insert(gchar *key,
+                  gchar *path)
+{
+    const gchar *current;
+
+    /* An uncompressed tile is preferred over a compressed one */
+    current = g_hash_table_lookup(dir_index.files, key);
+    if (current &&
+        srtm_compressed(path) &&
+        !srtm_compressed(current))
+    {
+        g_free(key);
+        g_free(path);
+        return;
+    }
+
+    g_hash_table_replace(dir_index.files, key, path);
+}
+
+static void
+srtm_index_remove(GFile *file)
+{
+    gchar *filename;
+    gchar *key;
+    gchar *path;
+
+    if (file == NULL)
+        return;
+
+    filename = g_file_get_basename(file);
+    key = (filename ? srtm_index_key(filename) : NULL);
+    path = g_file_get_path(file);
+
+    g_mutex_lock(&dir_index.lock);
+    /* Only forget the tile if it was this very file that provided it */
+    if (dir_index.files && key && path &&
+        g_strcmp0(g_hash_table_lookup(dir_index.files, key), path) == 0)
+    {
+        g_hash_table_remove(dir_index.files, key);
+    }
+    g_mutex_unlock(&dir_index.lock);
+
+    if (path)
+        srtm_tile_drop(path);
+
+    g_free(filename);
+    g_free(key);
+    g_free(path);
+}
+
+static gchar*
+srtm_index_key(const gchar *filename)
+{
+    gchar *lower = g_ascii_strdown(filename, -1);
+    gchar *key = NULL;
+    gsize length = strlen(filename);
+
+    /* Compressed tiles are indexed under the name of the plain tile */
+    if (g_str_has_suffix(lower, SRTM_EXTENSION))
+        key = g_strdup(filename);
+    else if (g_str_has_suffix(lower, SRTM_EXTENSION_GZ))
+        key = g_strndup(filename, length - strlen(SRTM_EXTENSION_GZ) + strlen(SRTM_EXTENSION));
+    else if (g_str_has_suffix(lower, SRTM_EXTENSION_ZIP))
+        key = g_strndup(filename, length - strlen(SRTM_EXTENSION_ZIP) + strlen(SRTM_EXTENSION));
+
+    g_free(lower);
+    return key;
+}
+
+static gboolean
+srtm_compressed(const gchar *path)
+{
+    gchar *lower = g_ascii_strdown(path, -1);
+    gboolean compressed;
+
+    compressed = (g_str_has_suffix(lower, SRTM_EXTENSION_GZ) ||
+                  g_str_has_suffix(lower, SRTM_EXTENSION_ZIP));
+
+    g_free(lower);
+    return compressed;
+}
+
+static guint
+srtm_index_hash(gconstpointer key)
+{
+    const gchar *p;
+    guint hash = 5381;
+
+    for (p = key; *p; p++)
+        hash = (hash << 5) + hash + (guint)g_ascii_tolower(*p);
+
+    return hash;
+}
+
+static gboolean
+srtm_index_equal(gconstpointer a,
+                 gconstpointer b)
+{
+    return g_ascii_strcasecmp(a, b) == 0;
+}
+
+static srtm_tile_t*
+srtm_tile_get(const gchar               *directory,
+              gdouble                    latitude,
+              gdouble                    longitude,
+              enum overlayaz_srtm_error *error)
+{
+    gchar *srtm_filename;
+    gchar *path;
+    srtm_tile_t *tile;
+    srtm_tile_t *other;
+
+    srtm_filename = overlayaz_srtm_filename(latitude, longitude);
+    path = srtm_index_lookup(directory, srtm_filename, error);
     g_free(srtm_filename);
-    g_dir_close(dir);
-    return error;
+    if (path == NULL)
+        return NULL;
+
+    g_mutex_lock(&cache.lock);
+    if (cache.tiles == NULL)
+        cache.tiles = g_hash_table_new(g_str_hash, g_str_equal);
+
+    tile = g_hash_table_lookup(cache.tiles, path);
+    if (tile)
+    {
+        /* Most recently used tiles are kept at the head */
+        g_queue_remove(&cache.lru, tile);
+        g_queue_push_head(&cache.lru, tile);
+        tile->ref_count++;
+    }
+    g_mutex_unlock(&cache.lock);
+
+    if (tile)
+    {
+        g_free(path);
+        return tile;
+    }
+
+    tile = srtm_tile_open(path, error);
+    if (tile == NULL)
+    {
+        g_free(path);
+        return NULL;
+    }
+
+    tile->key = path;
+
+    g_mutex_lock(&cache.lock);
+    other = g_hash_table_lookup(cache.tiles, path);
+    if (other)
+    {
+        /* Another thread has mapped the same tile in the meantime */
+        other->ref_count++;
+        srtm_tile_free(tile);
+        tile = other;
+    }
+    else
+    {
+        /* One reference is owned by the cache, another one by the caller */
+        tile->ref_count = 2;
+        g_hash_table_insert(cache.tiles, tile->key, tile);
+        g_queue_push_head(&cache.lru, tile);
+
+        while (g_queue_get_length(&cache.lru) > SRTM_CACHE_TILES)
+        {
+            other = g_queue_pop_tail(&cache.lru);
+            g_hash_table_remove(cache.tiles, other->key);
+            if (--other->ref_count == 0)
+                srtm_tile_free(other);
+        }
+    }
+    g_mutex_unlock(&cache.lock);
+
+    return tile;
 }
 
-static enum overlayaz_srtm_error
-srtm_parse(const gchar *path,
-           gdouble      latitude,
-           gdouble      longitude,
-           int16_t     *out)
+static srtm_tile_t*
+srtm_tile_open(const gchar               *path,
+               enum overlayaz_srtm_error *error)
 {
-    FILE *fp;
-    struct stat sb;
-    gint grid, x, y;
-    gint offset;
-    uint8_t buffer[SRTM_VALUE_SIZEOF];
+    GMappedFile *file = NULL;
+    GBytes *bytes = NULL;
+    GError *err = NULL;
+    srtm_tile_t *tile;
+    gchar *decoded = NULL;
+    gsize length;
+    gint grid;
 
-    if (stat(path, &sb) != 0)
+    if (srtm_compressed(path))
     {
-        g_warning("%s: Unable to stat %s", __func__, path);
-        return OVERLAYAZ_SRTM_ERROR_OPEN;
+        /* Compressed tiles are decoded once, later on the decoded copy is mapped */
+        decoded = srtm_decoded_path(path);
+        if (!srtm_decoded_valid(decoded, path))
+        {
+            bytes = srtm_decode(path, error);
+            if (bytes == NULL)
+            {
+                g_free(decoded);
+                return NULL;
+            }
+
+            if (g_file_set_contents(decoded, g_bytes_get_data(bytes, NULL), (gssize)g_bytes_get_size(bytes), NULL))
+            {
+                g_bytes_unref(bytes);
+                bytes = NULL;
+            }
+        }
+    }
+
+    if (bytes == NULL)
+    {
+        file = g_mapped_file_new(decoded ? decoded : path, FALSE, &err);
+        if (file == NULL)
+        {
+            g_warning("%s: Failed to open %s: %s", __func__, decoded ? decoded : path, err->message);
+            g_error_free(err);
+            g_free(decoded);
+            *error = OVERLAYAZ_SRTM_ERROR_OPEN;
+            return NULL;
+        }
+        length = g_mapped_file_get_length(file);
+    }
+    else
+        length = g_bytes_get_size(bytes);
+
+    grid = srtm_tile_grid(length);
+    if (grid == 0)
+    {
+        g_warning("%s: Unknown format of %s", __func__, path);
+        if (file)
+            g_mapped_file_unref(file);
+        if (bytes)
+            g_bytes_unref(bytes);
+        if (decoded)
+            g_remove(decoded);
+        g_free(decoded);
+        *error = OVERLAYAZ_SRTM_ERROR_FORMAT;
+        return NULL;
     }
 
-    switch (sb.st_size)
+    tile = g_malloc0(sizeof(srtm_tile_t));
+    tile->file = file;
+    tile->bytes = bytes;
+    tile->data = (file ? (const guint8*)g_mapped_file_get_contents(file) : g_bytes_get_data(bytes, NULL));
+    tile->grid = grid;
+    tile->ref_count = 1;
+
+    g_free(decoded);
+    *error = OVERLAYAZ_SRTM_OK;
+    return tile;
+}
+
+static gint
+srtm_tile_grid(gsize length)
+{
+    switch (length)
     {
     case SRTM_SIZE_3ARC:
-        grid = SRTM_GRID_3ARC;
-        break;
+        return SRTM_GRID_3ARC;
     case SRTM_SIZE_1ARC:
-        grid = SRTM_GRID_1ARC;
-        break;
+        return SRTM_GRID_1ARC;
     default:
-        g_warning("%s: Unknown format of %s", __func__, path);
-        return OVERLAYAZ_SRTM_ERROR_FORMAT;
+        return 0;
     }
+}
 
-    fp = g_fopen(path, "r");
-    if (fp == NULL)
+static GBytes*
+srtm_decode(const gchar               *path,
+            enum overlayaz_srtm_error *error)
+{
+    GFile *file;
+    GFileInputStream *file_stream;
+    GInputStream *stream = NULL;
+    GConverter *converter;
+    GError *err = NULL;
+    guint8 *buffer;
+    gsize limit = SRTM_SIZE_1ARC + 1;
+    gsize length = 0;
+    gchar *lower;
+
+    file = g_file_new_for_path(path);
+    file_stream = g_file_read(file, NULL, &err);
+    g_object_unref(file);
+    if (file_stream == NULL)
     {
-        g_warning("%s: Failed to open %s", __func__, path);
-        return OVERLAYAZ_SRTM_ERROR_OPEN;
+        g_warning("%s: Failed to open %s: %s", __func__, path, err->message);
+        g_error_free(err);
+        *error = OVERLAYAZ_SRTM_ERROR_OPEN;
+        return NULL;
     }
 
-    if (latitude < 0)
-        latitude *= -1;
-    if (longitude < 0)
-        longitude *= -1;
+    lower = g_ascii_strdown(path, -1);
+    if (g_str_has_suffix(lower, SRTM_EXTENSION_GZ))
+    {
+        converter = G_CONVERTER(g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+        stream = g_converter_input_stream_new(G_INPUT_STREAM(file_stream), converter);
+        g_object_unref(converter);
+    }
+    else
+        stream = srtm_decode_zip(G_INPUT_STREAM(file_stream), path, &limit);
+    g_object_unref(file_stream);
+    g_free(lower);
 
-    x = (gint)round((latitude - (gint)latitude) * (grid-1));
-    y = (gint)round((longitude - (gint)longitude) * (grid-1));
+    if (stream == NULL)
+    {
+        *error = OVERLAYAZ_SRTM_ERROR_FORMAT;
+        return NULL;
+    }
 
-    offset = ((grid-x-1)*grid + y) * SRTM_VALUE_SIZEOF;
-    if (fseek(fp, offset, SEEK_SET) != 0)
+    /* One byte more than the largest tile, to catch the oversized ones */
+    buffer = g_malloc(limit);
+    if (!g_input_stream_read_all(stream, buffer, limit, &length, NULL, &err))
     {
-        g_warning("%s: Unable to fseek %s", __func__, path);
-        fclose(fp);
-        return OVERLAYAZ_SRTM_ERROR_READ;
+        g_warning("%s: Failed to decode %s: %s", __func__, path, err->message);
+        g_error_free(err);
+        g_object_unref(stream);
+        g_free(buffer);
+        *error = OVERLAYAZ_SRTM_ERROR_READ;
+        return NULL;
     }
+    g_object_unref(stream);
+
+    return g_bytes_new_take(g_realloc(buffer, MAX(length, 1)), length);
+}
+
+static GInputStream*
+srtm_decode_zip(GInputStream *stream,
+                const gchar  *path,
+                gsize        *limit)
+{
+    guint8 header[SRTM_ZIP_HEADER_SIZE];
+    GConverter *converter;
+    GInputStream *entry;
+    gchar *name, *lower;
+    guint16 flags, method, name_length, extra_length;
+    guint32 compressed_size;
+    gsize length;
+    gboolean found;
 
-    if (fread(buffer, 1, SRTM_VALUE_SIZEOF, fp) != SRTM_VALUE_SIZEOF)
+    /* Walk the local file headers until the first elevation tile */
+    while (g_input_stream_read_all(stream, header, sizeof(header), &length, NULL, NULL) &&
+           length == sizeof(header) &&
+           SRTM_ZIP_U32(header) == SRTM_ZIP_SIGNATURE)
     {
-        g_warning("%s: Unable to fread %s", __func__, path);
-        fclose(fp);
-        return OVERLAYAZ_SRTM_ERROR_READ;
+        flags = SRTM_ZIP_U16(header + 6);
+        method = SRTM_ZIP_U16(header + 8);
+        compressed_size = SRTM_ZIP_U32(header + 18);
+        name_length = SRTM_ZIP_U16(header + 26);
+        extra_length = SRTM_ZIP_U16(header + 28);
+
+        name = g_malloc0(name_length + 1);
+        if (!g_input_stream_read_all(stream, name, name_length, &length, NULL, NULL) ||
+            length != name_length)
+        {
+            g_free(name);
+            break;
+        }
+
+        lower = g_ascii_strdown(name, -1);
+        found = g_str_has_suffix(lower, SRTM_EXTENSION);
+        g_free(lower);
+        g_free(name);
+
+        if (g_input_stream_skip(stream, extra_length, NULL, NULL) != extra_length)
+            break;
+
+        if (found && method == SRTM_ZIP_METHOD_DEFLATED)
+        {
+            converter = G_CONVERTER(g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_RAW));
+            entry = g_converter_input_stream_new(stream, converter);
+            g_object_unref(converter);
+            return entry;
+        }
+
+        if (found && method == SRTM_ZIP_METHOD_STORED &&
+            !(flags & SRTM_ZIP_FLAG_DESCRIPTOR))
+        {
+            /* A stored entry is followed by the rest of the archive */
+            *limit = MIN(compressed_size, *limit);
+            return g_object_ref(stream);
+        }
+
+        /* The size of an entry is not known in advance when followed by a data descriptor */
+        if (found || (flags & SRTM_ZIP_FLAG_DESCRIPTOR))
+            break;
+
+        if (g_input_stream_skip(stream, compressed_size, NULL, NULL) != compressed_size)
+            break;
     }
 
-    *out = (int16_t) (buffer[0] << 8 | buffer[1]);
-    fclose(fp);
-    return OVERLAYAZ_SRTM_OK;
+    g_warning("%s: No supported tile in %s", __func__, path);
+    return NULL;
+}
+
+static gchar*
+srtm_decoded_path(const gchar *path)
+{
+    gchar *checksum;
+    gchar *basename;
+    gchar *key;
+    gchar *filename;
+    gchar *decoded;
+
+    /* Tiles of the same name may come from different directories */
+    checksum = g_compute_checksum_for_string(G_CHECKSUM_MD5, path, -1);
+    basename = g_path_get_basename(path);
+    key = srtm_index_key(basename);
+    filename = g_strdup_printf("%s-%s", checksum, key);
+    decoded = g_build_filename(srtm_decoded_dir(), filename, NULL);
+
+    g_free(checksum);
+    g_free(basename);
+    g_free(key);
+    g_free(filename);
+    return decoded;
+}
+
+static const gchar*
+srtm_decoded_dir(void)
+{
+    static gchar *directory = NULL;
+    gchar *path;
+
+    /* The cache directory is created once, on the first decoded tile */
+    if (g_once_init_enter(&directory))
+    {
+        path = g_build_filename(g_get_user_cache_dir(), SRTM_DECODED_DIR, NULL);
+        if (g_mkdir_with_parents(path, 0700) != 0)
+            g_warning("%s: Failed to create %s", __func__, path);
+        g_once_init_leave(&directory, path);
+    }
+
+    return directory;
+}
+
+static gboolean
+srtm_decoded_valid(const gchar *decoded,
+                   const gchar *path)
+{
+    GStatBuf decoded_stat;
+    GStatBuf path_stat;
+
+    if (g_stat(decoded, &decoded_stat) != 0 ||
+        g_stat(path, &path_stat) != 0)
+        return FALSE;
+
+    /* The decoded copy is outdated if the archive has been replaced since */
+    return (decoded_stat.st_mtime >= path_stat.st_mtime &&
+            srtm_tile_grid((gsize)decoded_stat.st_size) != 0);
+}
+
+static void
+srtm_tile_drop(const gchar *path)
+{
+    srtm_tile_t *tile;
+
+    g_mutex_lock(&cache.lock);
+    tile = cache.tiles ? g_hash_table_lookup(cache.tiles, path) : NULL;
+    if (tile)
+    {
+        g_queue_remove(&cache.lru, tile);
+        g_hash_table_remove(cache.tiles, tile->key);
+        if (--tile->ref_count == 0)
+            srtm_tile_free(tile);
+    }
+    g_mutex_unlock(&cache.lock);
+}
+
+static void
+srtm_tile_unref(srtm_tile_t *tile)
+{
+    gboolean last;
+
+    g_mutex_lock(&cache.lock);
+    last = (--tile->ref_count == 0);
+    g_mutex_unlock(&cache.lock);
+
+    if (last)
+        srtm_tile_free(tile);
+}
+
+static void
+srtm_tile_free(srtm_tile_t *tile)
+{
+    if (tile->file)
+        g_mapped_file_unref(tile->file);
+    if (tile->bytes)
+        g_bytes_unref(tile->bytes);
+    if (tile->pyramid)
+        srtm_pyramid_free(tile->pyramid);
+    g_free(tile->key);
+    g_free(tile);
+}
+
+static int16_t
+srtm_tile_read(const srtm_tile_t *tile,
+               gdouble            latitude,
+               gdouble            longitude)
+{
+    gint x, y;
+    gsize offset;
+
+    /* Distance from the south-west corner of the tile */
+    x = (gint)round((latitude - floor(latitude)) * (tile->grid-1));
+    y = (gint)round((longitude - floor(longitude)) * (tile->grid-1));
+
+    offset = ((gsize)(tile->grid-x-1)*tile->grid + y) * SRTM_VALUE_SIZEOF;
+    return (int16_t) (tile->data[offset] << 8 | tile->data[offset+1]);
+}
+
+static const srtm_pyramid_t*
+srtm_tile_pyramid(srtm_tile_t *tile)
+{
+    srtm_pyramid_t *pyramid;
+
+    /* Built on the first use, plain lookups do not need it */
+    if (g_once_init_enter(&tile->pyramid))
+    {
+        pyramid = srtm_pyramid_build(tile);
+        g_once_init_leave(&tile->pyramid, pyramid);
+    }
+
+    return tile->pyramid;
+}
+
+static srtm_pyramid_t*
+srtm_pyramid_build(const srtm_tile_t *tile)
+{
+    srtm_pyramid_t *pyramid = g_malloc0(sizeof(srtm_pyramid_t));
+    const guint8 *data = tile->data;
+    gint16 value;
+    gint size, level;
+    gint row, col;
+    gint x, y, i;
+    gsize block;
+
+    /* The finest level holds the range of each block of posts */
+    size = (tile->grid + SRTM_PYRAMID_BLOCK - 1) / SRTM_PYRAMID_BLOCK;
+    pyramid->size[0] = size;
+    pyramid->min[0] = g_new(gint16, size * size);
+    pyramid->max[0] = g_new(gint16, size * size);
+    for (i = 0; i < size * size; i++)
+    {
+        pyramid->min[0][i] = G_MAXINT16;
+        pyramid->max[0][i] = SRTM_INVALID;
+    }
+
+    for (row = 0; row < tile->grid; row++)
+    {
+        for (col = 0; col < tile->grid; col++, data += SRTM_VALUE_SIZEOF)
+        {
+            value = (gint16)(data[0] << 8 | data[1]);
+            if (value == SRTM_INVALID)
+                continue;
+
+            block = (gsize)(row / SRTM_PYRAMID_BLOCK) * size + col / SRTM_PYRAMID_BLOCK;
+            pyramid->min[0][block] = MIN(pyramid->min[0][block], value);
+            pyramid->max[0][block] = MAX(pyramid->max[0][block], value);
+        }
+    }
+
+    /* Each coarser level merges 2x2 blocks of the previous one */
+    for (level = 1; size > 1 && level < SRTM_PYRAMID_LEVELS; level++)
+    {
+        size = (size + 1) / 2;
+        pyramid->size[level] = size;
+        pyramid->min[level] = g_new(gint16, size * size);
+        pyramid->max[level] = g_new(gint16, size * size);
+
+        for (y = 0; y < size; y++)
+        {
+            for (x = 0; x < size; x++)
+            {
+                block = (gsize)y * size + x;
+                pyramid->min[level][block] = G_MAXINT16;
+                pyramid->max[level][block] = SRTM_INVALID;
+
+                for (i = 0; i < 4; i++)
+                {
+                    row = y * 2 + i / 2;
+                    col = x * 2 + i % 2;
+                    if (row >= pyramid->size[level-1] || col >= pyramid->size[level-1])
+                        continue;
+
+                    pyramid->min[level][block] = MIN(pyramid->min[level][block],
+                                                     pyramid->min[level-1][row * pyramid->size[level-1] + col]);
+                    pyramid->max[level][block] = MAX(pyramid->max[level][block],
+                                                     pyramid->max[level-1][row * pyramid->size[level-1] + col]);
+                }
+            }
+        }
+    }
+
+    pyramid->levels = level;
+    return pyramid;
+}
+
+/* rect holds the first and the last column, then the first and the last row.
+ * The range of the blocks covering it is returned, which may be wider. */
+static void
+srtm_pyramid_query(const srtm_pyramid_t *pyramid,
+                   const gint           *rect,
+                   gint16               *min,
+                   gint16               *max)
+{
+    gint x_first = rect[0] / SRTM_PYRAMID_BLOCK;
+    gint x_last = rect[1] / SRTM_PYRAMID_BLOCK;
+    gint y_first = rect[2] / SRTM_PYRAMID_BLOCK;
+    gint y_last = rect[3] / SRTM_PYRAMID_BLOCK;
+    gint level = 0;
+    gint x, y;
+    gsize block;
+
+    /* Go up until the rectangle is covered by a few blocks only */
+    while (level < pyramid->levels - 1 &&
+           (x_last - x_first >= SRTM_PYRAMID_SPAN || y_last - y_first >= SRTM_PYRAMID_SPAN))
+    {
+        x_first /= 2;
+        x_last /= 2;
+        y_first /= 2;
+        y_last /= 2;
+        level++;
+    }
+
+    for (y = y_first; y <= y_last; y++)
+    {
+        for (x = x_first; x <= x_last; x++)
+        {
+            block = (gsize)y * pyramid->size[level] + x;
+            *min = MIN(*min, pyramid->min[level][block]);
+            *max = MAX(*max, pyramid->max[level][block]);
+        }
+    }
+}
+
+static void
+srtm_pyramid_free(srtm_pyramid_t *pyramid)
+{
+    gint level;
+
+    for (level = 0; level < pyramid->levels; level++)
+    {
+        g_free(pyramid->min[level]);
+        g_free(pyramid->max[level]);
+    }
+    g_free(pyramid);
+}
+
+static gboolean
+srtm_sampler_tile(overlayaz_srtm_sampler_t *sampler,
+                  gdouble                   latitude,
+                  gdouble                   longitude)
+{
+    gint lat_int = (gint)floor(latitude);
+    gint lon_int = (gint)floor(longitude);
+
+    if (!sampler->tile_valid ||
+        lat_int != sampler->tile_lat ||
+        lon_int != sampler->tile_lon)
+    {
+        /* Failed lookups are kept too, so that a missing tile is reported once */
+        if (sampler->tile)
+            srtm_tile_unref(sampler->tile);
+        sampler->tile = srtm_tile_get(sampler->directory, latitude, longitude, &sampler->tile_error);
+        sampler->tile_lat = lat_int;
+        sampler->tile_lon = lon_int;
+        sampler->tile_valid = TRUE;
+    }
+
+    return sampler->tile != NULL;
+}
+
+static void
+srtm_sampler_flush(struct srtm_lanes *lanes,
+                   gdouble           *out)
+{
+    gint i;
+
+    /* Unused lanes are interpolated too, results are discarded */
+    for (i = lanes->count; i < SRTM_SAMPLER_LANES; i++)
+    {
+        lanes->raw[0][i] = lanes->raw[1][i] = lanes->raw[2][i] = lanes->raw[3][i] = 0;
+        lanes->wx[i] = lanes->wy[i] = 0.0f;
+    }
+
+    srtm_bilinear((const guint16 (*)[SRTM_SAMPLER_LANES])lanes->raw, lanes->wx, lanes->wy, lanes->out);
+
+    for (i = 0; i < lanes->count; i++)
+        out[lanes->index[i]] = lanes->out[i];
+
+    lanes->count = 0;
+}
+
+/* Bilinear interpolation of SRTM_SAMPLER_LANES points at once.
+ * raw[] holds big-endian posts: north-west, north-east, south-west, south-east.
+ * wx is measured eastwards from the west posts, wy northwards from the south posts. */
+static void
+srtm_bilinear(const guint16  raw[4][SRTM_SAMPLER_LANES],
+              const gfloat  *wx,
+              const gfloat  *wy,
+              gfloat        *out)
+{
+#ifdef __SSE2__
+    __m128 post[4][2];
+    __m128i v;
+    __m128 north, south, x, y;
+    gint q, h;
+
+    for (q = 0; q < 4; q++)
+    {
+        /* Swap bytes and sign-extend to 32 bits */
+        v = _mm_loadu_si128((const __m128i*)raw[q]);
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        post[q][0] = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+        post[q][1] = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+    }
+
+    for (h = 0; h < 2; h++)
+    {
+        x = _mm_loadu_ps(wx + h*4);
+        y = _mm_loadu_ps(wy + h*4);
+        north = _mm_add_ps(post[0][h], _mm_mul_ps(_mm_sub_ps(post[1][h], post[0][h]), x));
+        south = _mm_add_ps(post[2][h], _mm_mul_ps(_mm_sub_ps(post[3][h], post[2][h]), x));
+        _mm_storeu_ps(out + h*4, _mm_add_ps(south, _mm_mul_ps(_mm_sub_ps(north, south), y)));
+    }
+#else
+    gfloat post[4];
+    gfloat north, south;
+    gint i, q;
+
+    for (i = 0; i < SRTM_SAMPLER_LANES; i++)
+    {
+        for (q = 0; q < 4; q++)
+            post[q] = (gint16)GUINT16_FROM_BE(raw[q][i]);
+
+        north = post[0] + (post[1] - post[0]) * wx[i];
+        south = post[2] + (post[3] - post[2]) * wx[i];
+        out[i] = south + (north - south) * wy[i];
+    }
+#endif
+}
+
+static guint64
+srtm_batch_key(gdouble latitude,
+               gdouble longitude)
+{
+    gint lat_int = (gint)floor(latitude);
+    gint lon_int = (gint)floor(longitude);
+    guint64 tile_id, pos;
+
+    /* Upper half identifies the tile, lower half orders the samples
+     * within it (rows from north to south, as stored in the file). */
+    tile_id = (guint64)(lat_int + 90) * 361 + (guint64)(lon_int + 180);
+    pos = (guint64)round((1.0 - (latitude - lat_int)) * (SRTM_GRID_1ARC-1)) * SRTM_GRID_1ARC;
+    pos += (guint64)round((longitude - lon_int) * (SRTM_GRID_1ARC-1));
+    return (tile_id << 32) | pos;
+}
+
+static gint
+srtm_batch_compare(gconstpointer a,
+                   gconstpointer b,
+                   gpointer      user_data)
+{
+    const guint64 *keys = user_data;
+    guint64 key_a = keys[*(const gint*)a];
+    guint64 key_b = keys[*(const gint*)b];
+
+    return (key_a > key_b) - (key_a < key_b);
 }
@@ -15,6 +15,7 @@
 
 #ifndef OVERLAYAZ_SRTM_H_
 #define OVERLAYAZ_SRTM_H_
+#include <gio/gio.h>
 
 enum overlayaz_srtm_error
 {
@@ -24,11 +25,26 @@ enum overlayaz_srtm_error
     OVERLAYAZ_SRTM_ERROR_FORMAT,
     OVERLAYAZ_SRTM_ERROR_OPEN,
     OVERLAYAZ_SRTM_ERROR_READ,
-    OVERLAYAZ_SRTM_ERROR_INVALID
+    OVERLAYAZ_SRTM_ERROR_INVALID,
+    OVERLAYAZ_SRTM_ERROR_CANCELLED
 };
 
+typedef struct overlayaz_srtm_sampler overlayaz_srtm_sampler_t;
+
 gchar* overlayaz_srtm_filename(gdouble, gdouble);
 enum overlayaz_srtm_error overlayaz_srtm_lookup(const gchar*, gdouble, gdouble, gdouble*);
 enum overlayaz_srtm_error overlayaz_srtm_lookup_default(gdouble, gdouble, gdouble*);
+void overlayaz_srtm_lookup_async(const gchar*, gdouble, gdouble, GCancellable*, GAsyncReadyCallback, gpointer);
+enum overlayaz_srtm_error overlayaz_srtm_lookup_finish(GAsyncResult*, gdouble*);
+gint overlayaz_srtm_lookup_batch(const gchar*, const gdouble*, const gdouble*, gint, gdouble*, enum overlayaz_srtm_error*);
+
+overlayaz_srtm_sampler_t* overlayaz_srtm_sampler_new(const gchar*);
+void overlayaz_srtm_sampler_free(overlayaz_srtm_sampler_t*);
+enum overlayaz_srtm_error overlayaz_srtm_sampler_get(overlayaz_srtm_sampler_t*, gdouble, gdouble, gdouble*);
+gint overlayaz_srtm_sampler_get_n(overlayaz_srtm_sampler_t*, const gdouble*, const gdouble*, gint, gdouble*, enum overlayaz_srtm_error*);
+enum overlayaz_srtm_error overlayaz_srtm_sampler_range(overlayaz_srtm_sampler_t*, gdouble, gdouble, gdouble, gdouble, gdouble*, gdouble*);
+
+void overlayaz_srtm_set_directory(const gchar*);
+void overlayaz_srtm_free(void);
 
 #endif
\ No newline at end of file
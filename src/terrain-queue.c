@@ -0,0 +1,130 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include <glib.h>
+#include "terrain-queue.h"
+
+static gboolean terrain_queue_notify(gpointer);
+
+
+void
+overlayaz_terrain_queue_lock(struct overlayaz_terrain_queue *queue)
+{
+    g_mutex_lock(&queue->lock);
+}
+
+void
+overlayaz_terrain_queue_unlock(struct overlayaz_terrain_queue *queue)
+{
+    g_mutex_unlock(&queue->lock);
+}
+
+guint
+overlayaz_terrain_queue_generation(const struct overlayaz_terrain_queue *queue)
+{
+    return queue->generation;
+}
+
+void
+overlayaz_terrain_queue_reset(struct overlayaz_terrain_queue *queue)
+{
+    queue->generation++;
+    g_cond_broadcast(&queue->cond);
+}
+
+void
+overlayaz_terrain_queue_push(struct overlayaz_terrain_queue *queue,
+                             GFunc                           worker,
+                             gpointer                        job)
+{
+    if (queue->pool == NULL)
+        queue->pool = g_thread_pool_new(worker, NULL, (gint)g_get_num_processors(), FALSE, NULL);
+
+    queue->pending++;
+    g_thread_pool_push(queue->pool, job, NULL);
+}
+
+gboolean
+overlayaz_terrain_queue_wait(struct overlayaz_terrain_queue *queue,
+                             guint                           generation)
+{
+    /* Export has no main loop to redraw with, so it waits for the jobs
+       it needs. Results of a reset cache are never coming. */
+    if (queue->generation != generation)
+        return FALSE;
+
+    g_cond_wait(&queue->cond, &queue->lock);
+    return TRUE;
+}
+
+void
+overlayaz_terrain_queue_done(struct overlayaz_terrain_queue *queue)
+{
+    g_cond_broadcast(&queue->cond);
+    if (--queue->pending == 0 && queue->notify && queue->notify_source == 0)
+        queue->notify_source = g_idle_add(terrain_queue_notify, queue);
+}
+
+void
+overlayaz_terrain_queue_set_notify(struct overlayaz_terrain_queue *queue,
+                                   overlayaz_terrain_notify_t      notify,
+                                   gpointer                        data)
+{
+    g_mutex_lock(&queue->lock);
+    queue->notify = notify;
+    queue->notify_data = data;
+    if (notify == NULL && queue->notify_source)
+    {
+        g_source_remove(queue->notify_source);
+        queue->notify_source = 0;
+    }
+    g_mutex_unlock(&queue->lock);
+}
+
+void
+overlayaz_terrain_queue_free(struct overlayaz_terrain_queue *queue)
+{
+    /* Jobs still in the queue are dropped without any work */
+    g_mutex_lock(&queue->lock);
+    overlayaz_terrain_queue_reset(queue);
+    g_mutex_unlock(&queue->lock);
+
+    if (queue->pool)
+        g_thread_pool_free(queue->pool, FALSE, TRUE);
+    if (queue->notify_source)
+        g_source_remove(queue->notify_source);
+
+    queue->pool = NULL;
+    queue->notify_source = 0;
+}
+
+static gboolean
+terrain_queue_notify(gpointer user_data)
+{
+    struct overlayaz_terrain_queue *queue = (struct overlayaz_terrain_queue*)user_data;
+    overlayaz_terrain_notify_t notify;
+    gpointer data;
+
+    g_mutex_lock(&queue->lock);
+    notify = queue->notify;
+    data = queue->notify_data;
+    queue->notify_source = 0;
+    g_mutex_unlock(&queue->lock);
+
+    if (notify)
+        notify(data);
+
+    return G_SOURCE_REMOVE;
+}
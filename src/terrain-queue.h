@@ -0,0 +1,51 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef OVERLAYAZ_TERRAIN_QUEUE_H_
+#define OVERLAYAZ_TERRAIN_QUEUE_H_
+#include <glib.h>
+
+typedef void (*overlayaz_terrain_notify_t)(gpointer);
+
+/* Background jobs of a terrain cache. The lock also guards the results
+   of the cache, a zero-initialized queue is ready to use. Jobs take
+   the generation at the time they were pushed, their results are
+   dropped once the cache has been reset since. When the queue runs
+   out of work, the notify function is called from the main loop. */
+struct overlayaz_terrain_queue
+{
+    GMutex lock;
+    GCond cond;
+    GThreadPool *pool;
+    guint generation;
+    gint pending;
+    overlayaz_terrain_notify_t notify;
+    gpointer notify_data;
+    guint notify_source;
+};
+
+void overlayaz_terrain_queue_lock(struct overlayaz_terrain_queue*);
+void overlayaz_terrain_queue_unlock(struct overlayaz_terrain_queue*);
+
+guint overlayaz_terrain_queue_generation(const struct overlayaz_terrain_queue*);
+void overlayaz_terrain_queue_reset(struct overlayaz_terrain_queue*);
+void overlayaz_terrain_queue_push(struct overlayaz_terrain_queue*, GFunc, gpointer);
+gboolean overlayaz_terrain_queue_wait(struct overlayaz_terrain_queue*, guint);
+void overlayaz_terrain_queue_done(struct overlayaz_terrain_queue*);
+
+void overlayaz_terrain_queue_set_notify(struct overlayaz_terrain_queue*, overlayaz_terrain_notify_t, gpointer);
+void overlayaz_terrain_queue_free(struct overlayaz_terrain_queue*);
+
+#endif
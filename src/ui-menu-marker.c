@@ -17,14 +17,18 @@
 #include "ui.h"
 #include "ui-menu-marker.h"
 #include "geo.h"
-#include "marker-list.h"
+#include "marker-model.h"
 #include "dialog.h"
+#include "draw.h"
 
 struct overlayaz_ui_menu_marker
 {
     overlayaz_ui_t *ui;
     struct overlayaz_menu_marker *m;
     overlayaz_t *o;
+    overlayaz_marker_store_t *markers;
+    overlayaz_marker_style_t *style;
+    overlayaz_marker_model_t *model;
     gboolean lock;
 };
 
@@ -58,6 +62,7 @@ static void ui_menu_marker_button_show_azi_apply(GtkButton*, overlayaz_ui_menu_m
 static void ui_menu_marker_button_show_dist_apply(GtkButton*, overlayaz_ui_menu_marker_t*);
 
 static gboolean ui_marker_dialog_apply(overlayaz_ui_t*, const gchar*);
+static cairo_region_t* ui_menu_marker_area(overlayaz_ui_menu_marker_t*, gint, cairo_region_t*);
 
 
 overlayaz_ui_menu_marker_t*
@@ -71,13 +76,14 @@ overlayaz_ui_menu_marker_new(overlayaz_ui_t               *ui,
     ui_m->ui = ui;
     ui_m->m = m;
     ui_m->o = o;
+    ui_m->markers = overlayaz_get_marker_store(o);
+    ui_m->style = overlayaz_get_marker_style(o);
+    ui_m->model = overlayaz_marker_model_new(ui_m->markers, GTK_COMBO_BOX(ui_m->m->combo_marker));
 
-    gtk_combo_box_set_model(GTK_COMBO_BOX(ui_m->m->combo_marker),
-                            GTK_TREE_MODEL(overlayaz_get_marker_list(o)));
     gtk_cell_layout_set_cell_data_func(GTK_CELL_LAYOUT(ui_m->m->combo_marker),
                                        ui_m->m->renderer_marker,
                                        ui_menu_marker_format_name,
-                                       NULL, NULL);
+                                       ui_m, NULL);
     g_signal_connect(ui_m->m->combo_marker, "changed", G_CALLBACK(ui_menu_marker_combo_changed), ui_m);
 
     g_signal_connect(ui_m->m->button_down, "clicked", G_CALLBACK(ui_menu_marker_button_down), ui_m);
@@ -115,6 +121,7 @@ overlayaz_ui_menu_marker_new(overlayaz_ui_t               *ui,
 void
 overlayaz_ui_menu_marker_free(overlayaz_ui_menu_marker_t *ui_m)
 {
+    overlayaz_marker_model_free(ui_m->model);
     g_free(ui_m);
 }
 
@@ -122,12 +129,9 @@ void
 overlayaz_ui_menu_marker_sync(overlayaz_ui_menu_marker_t *ui_m,
                               gboolean                    active)
 {
-    GtkTreeModel *model;
-
     gtk_widget_set_sensitive(ui_m->m->combo_marker, active);
 
-    model = gtk_combo_box_get_model(GTK_COMBO_BOX(ui_m->m->combo_marker));
-    if (gtk_tree_model_iter_n_children(model, NULL))
+    if (overlayaz_marker_store_count(ui_m->markers))
         gtk_combo_box_set_active(GTK_COMBO_BOX(ui_m->m->combo_marker), 0);
     else
         ui_menu_marker_combo_changed(GTK_COMBO_BOX(ui_m->m->combo_marker), ui_m);
@@ -146,21 +150,6 @@ overlayaz_ui_menu_marker_get_id(overlayaz_ui_menu_marker_t *ui_m)
     return gtk_combo_box_get_active(GTK_COMBO_BOX(ui_m->m->combo_marker)) + 1;
 }
 
-
-const overlayaz_marker_t*
-overlayaz_ui_menu_marker_get_current(overlayaz_ui_menu_marker_t *ui_m)
-{
-    GtkTreeModel *model = gtk_combo_box_get_model(GTK_COMBO_BOX(ui_m->m->combo_marker));
-    GtkTreeIter iter;
-    overlayaz_marker_t *m;
-
-    if (!gtk_combo_box_get_active_iter(GTK_COMBO_BOX(ui_m->m->combo_marker), &iter))
-        return NULL;
-
-    m = overlayaz_marker_list_get(GTK_LIST_STORE(model), &iter);
-    return m;
-}
-
 static void
 ui_menu_marker_format_name(GtkCellLayout   *cell_layout,
                            GtkCellRenderer *renderer,
@@ -168,17 +157,17 @@ ui_menu_marker_format_name(GtkCellLayout   *cell_layout,
                            GtkTreeIter     *iter,
                            gpointer         user_data)
 {
+    overlayaz_ui_menu_marker_t *ui_m = (overlayaz_ui_menu_marker_t*)user_data;
     GtkTreePath *path;
     gchar *name, *tmp;
-    gint *n;
-    overlayaz_marker_t *m;
+    gint id;
     size_t i, len;
 
     path = gtk_tree_model_get_path(model, iter);
-    n = gtk_tree_path_get_indices(path);
-    m = overlayaz_marker_list_get(GTK_LIST_STORE(model), iter);
+    id = gtk_tree_path_get_indices(path)[0];
+    gtk_tree_path_free(path);
 
-    name = g_strdup_printf("%d. %s", n[0]+1, overlayaz_marker_get_name(m));
+    name = g_strdup_printf("%d. %s", id+1, overlayaz_marker_store_get_name(ui_m->markers, id));
 
     if (g_utf8_strlen(name, -1) > 24+1)
     {
@@ -197,28 +186,27 @@ ui_menu_marker_format_name(GtkCellLayout   *cell_layout,
 
     g_object_set(renderer,
                  "text", name,
-                 "strikethrough", !overlayaz_marker_get_active(m),
+                 "strikethrough", !overlayaz_marker_store_get_active(ui_m->markers, id),
                  NULL);
 
     g_free(name);
-    gtk_tree_path_free(path);
 }
 
 static void
 ui_menu_marker_combo_changed(GtkComboBox                *widget,
                              overlayaz_ui_menu_marker_t *ui_m)
 {
-    GtkTreeModel *model = gtk_combo_box_get_model(widget);
     GtkTextBuffer *text_buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(ui_m->m->textview_name));
-    overlayaz_marker_t *m;
-    GtkTreeIter iter;
     gboolean active;
+    gint id;
     gint count;
+    guint style;
     static const GdkRGBA color = {0};
 
     overlayaz_ui_update_view(ui_m->ui, OVERLAYAZ_UI_UPDATE_MAP);
 
-    active = gtk_combo_box_get_active_iter(widget, &iter);
+    id = gtk_combo_box_get_active(widget);
+    active = (id >= 0);
     gtk_widget_set_sensitive(ui_m->m->button_up, active);
     gtk_widget_set_sensitive(ui_m->m->button_down, active);
     gtk_widget_set_sensitive(ui_m->m->button_remove, active);
@@ -241,7 +229,7 @@ ui_menu_marker_combo_changed(GtkComboBox                *widget,
     gtk_widget_set_sensitive(ui_m->m->button_show_azi_apply, active);
     gtk_widget_set_sensitive(ui_m->m->button_show_dist_apply, active);
 
-    count = gtk_tree_model_iter_n_children(model, NULL);
+    count = overlayaz_marker_store_count(ui_m->markers);
     gtk_widget_set_sensitive(ui_m->m->button_clear, (count != 0));
 
     if (!active)
@@ -264,19 +252,18 @@ ui_menu_marker_combo_changed(GtkComboBox                *widget,
     }
     else
     {
-        m = overlayaz_marker_list_get(GTK_LIST_STORE(model), &iter);
-
+        style = overlayaz_marker_store_get_style(ui_m->markers, id);
         ui_m->lock = TRUE;
-        gtk_text_buffer_set_text(text_buffer, overlayaz_marker_get_name(m), -1);
-        gtk_spin_button_set_value(GTK_SPIN_BUTTON(ui_m->m->spin_lat), overlayaz_marker_get_latitude(m));
-        gtk_spin_button_set_value(GTK_SPIN_BUTTON(ui_m->m->spin_lon), overlayaz_marker_get_longitude(m));
-        gtk_combo_box_set_active(GTK_COMBO_BOX(ui_m->m->combo_tick), overlayaz_marker_get_tick(m));
-        gtk_font_chooser_set_font(GTK_FONT_CHOOSER(ui_m->m->font_marker), overlayaz_font_get(overlayaz_marker_get_font(m)));
-        gtk_color_chooser_set_rgba(GTK_COLOR_CHOOSER(ui_m->m->color_marker_font), overlayaz_marker_get_font_color(m));
-        gtk_range_set_value(GTK_RANGE(ui_m->m->scale_pos), overlayaz_marker_get_position(m));
-        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(ui_m->m->check_active), overlayaz_marker_get_active(m));
-        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(ui_m->m->check_show_azi), overlayaz_marker_get_show_azimuth(m));
-        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(ui_m->m->check_show_dist), overlayaz_marker_get_show_distance(m));
+        gtk_text_buffer_set_text(text_buffer, overlayaz_marker_store_get_name(ui_m->markers, id), -1);
+        gtk_spin_button_set_value(GTK_SPIN_BUTTON(ui_m->m->spin_lat), overlayaz_marker_store_get_latitude(ui_m->markers, id));
+        gtk_spin_button_set_value(GTK_SPIN_BUTTON(ui_m->m->spin_lon), overlayaz_marker_store_get_longitude(ui_m->markers, id));
+        gtk_combo_box_set_active(GTK_COMBO_BOX(ui_m->m->combo_tick), overlayaz_marker_store_get_tick(ui_m->markers, id));
+        gtk_font_chooser_set_font(GTK_FONT_CHOOSER(ui_m->m->font_marker), overlayaz_font_get(overlayaz_marker_style_get_font(ui_m->style, style)));
+        gtk_color_chooser_set_rgba(GTK_COLOR_CHOOSER(ui_m->m->color_marker_font), overlayaz_marker_style_get_color(ui_m->style, style));
+        gtk_range_set_value(GTK_RANGE(ui_m->m->scale_pos), overlayaz_marker_store_get_position(ui_m->markers, id));
+        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(ui_m->m->check_active), overlayaz_marker_store_get_active(ui_m->markers, id));
+        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(ui_m->m->check_show_azi), overlayaz_marker_store_get_show_azimuth(ui_m->markers, id));
+        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(ui_m->m->check_show_dist), overlayaz_marker_store_get_show_distance(ui_m->markers, id));
         ui_m->lock = FALSE;
 
         /* Force update of azimuth and distance fields */
@@ -288,21 +275,13 @@ static void
 ui_menu_marker_button_down(GtkButton                  *widget,
                            overlayaz_ui_menu_marker_t *ui_m)
 {
-    GtkTreeIter iter;
-    GtkTreeIter next;
-    GtkTreeModel *model;
-
-    if (!gtk_combo_box_get_active_iter(GTK_COMBO_BOX(ui_m->m->combo_marker), &iter))
-        return;
+    gint id = gtk_combo_box_get_active(GTK_COMBO_BOX(ui_m->m->combo_marker));
 
-    model = gtk_combo_box_get_model(GTK_COMBO_BOX(ui_m->m->combo_marker));
-    next = iter;
-
-    if (!gtk_tree_model_iter_next(model, &next))
+    if (id < 0 || id + 1 >= overlayaz_marker_store_count(ui_m->markers))
         return;
 
-    gtk_list_store_move_after(GTK_LIST_STORE(model), &iter, &next);
-    gtk_widget_queue_draw(ui_m->m->combo_marker);
+    overlayaz_marker_store_swap(ui_m->markers, id);
+    gtk_combo_box_set_active(GTK_COMBO_BOX(ui_m->m->combo_marker), id + 1);
     overlayaz_ui_update_view(ui_m->ui, OVERLAYAZ_UI_UPDATE_MAP);
 }
 
@@ -310,26 +289,13 @@ static void
 ui_menu_marker_button_up(GtkButton                  *widget,
                          overlayaz_ui_menu_marker_t *ui_m)
 {
-    GtkTreeIter iter;
-    GtkTreeIter prev;
-    GtkTreePath *path;
-    GtkTreeModel *model;
+    gint id = gtk_combo_box_get_active(GTK_COMBO_BOX(ui_m->m->combo_marker));
 
-    if (!gtk_combo_box_get_active_iter(GTK_COMBO_BOX(ui_m->m->combo_marker), &iter))
+    if (id <= 0)
         return;
 
-    model = gtk_combo_box_get_model(GTK_COMBO_BOX(ui_m->m->combo_marker));
-    path = gtk_tree_model_get_path(model, &iter);
-    gtk_tree_path_prev(path);
-
-    if (gtk_tree_model_get_iter(model, &prev, path))
-    {
-        gtk_list_store_move_before(GTK_LIST_STORE(model), &iter, &prev);
-        gtk_widget_queue_draw(ui_m->m->combo_marker);
-    }
-
-    gtk_tree_path_free(path);
-
+    overlayaz_marker_store_swap(ui_m->markers, id - 1);
+    gtk_combo_box_set_active(GTK_COMBO_BOX(ui_m->m->combo_marker), id - 1);
     overlayaz_ui_update_view(ui_m->ui, OVERLAYAZ_UI_UPDATE_MAP);
 }
 
@@ -337,12 +303,10 @@ static void
 ui_menu_marker_button_remove(GtkButton                  *widget,
                              overlayaz_ui_menu_marker_t *ui_m)
 {
-    GtkTreeIter iter;
-    GtkTreeIter next;
-    GtkTreePath *path;
-    GtkTreeModel *model;
+    gint id = gtk_combo_box_get_active(GTK_COMBO_BOX(ui_m->m->combo_marker));
+    gint count = overlayaz_marker_store_count(ui_m->markers);
 
-    if (!gtk_combo_box_get_active_iter(GTK_COMBO_BOX(ui_m->m->combo_marker), &iter))
+    if (id < 0)
         return;
 
     if (!overlayaz_dialog_ask_yesno(overlayaz_ui_get_parent(ui_m->ui),
@@ -352,21 +316,13 @@ ui_menu_marker_button_remove(GtkButton                  *widget,
         return;
     }
 
-    model = gtk_combo_box_get_model(GTK_COMBO_BOX(ui_m->m->combo_marker));
-    next = iter;
+    /* Select the next marker (or the previous one) before the removal */
+    if (id + 1 < count)
+        gtk_combo_box_set_active(GTK_COMBO_BOX(ui_m->m->combo_marker), id + 1);
+    else if (id > 0)
+        gtk_combo_box_set_active(GTK_COMBO_BOX(ui_m->m->combo_marker), id - 1);
 
-    if (gtk_tree_model_iter_next(model, &next))
-        gtk_combo_box_set_active_iter(GTK_COMBO_BOX(ui_m->m->combo_marker), &next);
-    else
-    {
-        path = gtk_tree_model_get_path(model, &iter);
-        gtk_tree_path_prev(path);
-        if (gtk_tree_model_get_iter(model, &next, path))
-            gtk_combo_box_set_active_iter(GTK_COMBO_BOX(ui_m->m->combo_marker), &next);
-        gtk_tree_path_free(path);
-    }
-
-    overlayaz_marker_list_remove(GTK_LIST_STORE(model), &iter);
+    overlayaz_marker_store_remove(ui_m->markers, id);
     overlayaz_ui_update_view(ui_m->ui, OVERLAYAZ_UI_UPDATE_IMAGE | OVERLAYAZ_UI_UPDATE_MAP);
 }
 
@@ -374,13 +330,10 @@ static void
 ui_menu_marker_button_clear(GtkButton                  *widget,
                             overlayaz_ui_menu_marker_t *ui_m)
 {
-    GtkTreeModel *model;
-
     if (!overlayaz_dialog_ask_yesno(overlayaz_ui_get_parent(ui_m->ui), "Remove all markers", "Do you really want to remove all markers?"))
         return;
 
-    model = gtk_combo_box_get_model(GTK_COMBO_BOX(ui_m->m->combo_marker));
-    overlayaz_marker_list_clear(GTK_LIST_STORE(model));
+    overlayaz_marker_store_clear(ui_m->markers);
     overlayaz_ui_update_view(ui_m->ui, OVERLAYAZ_UI_UPDATE_IMAGE | OVERLAYAZ_UI_UPDATE_MAP);
 }
 
@@ -397,27 +350,30 @@ static void
 ui_menu_marker_textbuffer_name_changed(GtkTextBuffer              *buffer,
                                        overlayaz_ui_menu_marker_t *ui_m)
 {
-    GtkListStore *model = GTK_LIST_STORE(gtk_combo_box_get_model(GTK_COMBO_BOX(ui_m->m->combo_marker)));
-    GtkTreeIter iter;
-    overlayaz_marker_t *m;
+    gint id;
+    cairo_region_t *area;
+    guint revision;
     GtkTextIter start, end;
     gchar *text;
 
     if (ui_m->lock)
         return;
 
-    if (!gtk_combo_box_get_active_iter(GTK_COMBO_BOX(ui_m->m->combo_marker), &iter))
+    id = gtk_combo_box_get_active(GTK_COMBO_BOX(ui_m->m->combo_marker));
+    if (id < 0)
         return;
 
     gtk_text_buffer_get_bounds(buffer, &start, &end);
     text = gtk_text_buffer_get_text(buffer, &start, &end, FALSE);
 
-    m = overlayaz_marker_list_get(GTK_LIST_STORE(model), &iter);
-    overlayaz_marker_set_name(m, text);
-    overlayaz_marker_list_update(GTK_LIST_STORE(model), &iter);
+    revision = overlayaz_get_revision(ui_m->o);
+    area = ui_menu_marker_area(ui_m, id, NULL);
+    overlayaz_marker_store_set_name(ui_m->markers, id, text);
+    ui_menu_marker_area(ui_m, id, area);
 
     g_free(text);
-    overlayaz_ui_update_view(ui_m->ui, OVERLAYAZ_UI_UPDATE_IMAGE);
+    overlayaz_ui_update_image_area(ui_m->ui, revision, area);
+    cairo_region_destroy(area);
 }
 
 static void
@@ -425,19 +381,16 @@ ui_menu_marker_spin_lat_changed(GtkSpinButton              *widget,
                                 overlayaz_ui_menu_marker_t *ui_m)
 {
 
-    GtkListStore *model = GTK_LIST_STORE(gtk_combo_box_get_model(GTK_COMBO_BOX(ui_m->m->combo_marker)));
-    GtkTreeIter iter;
-    overlayaz_marker_t *m;
+    gint id;
 
     if (ui_m->lock)
         return;
 
-    if (!gtk_combo_box_get_active_iter(GTK_COMBO_BOX(ui_m->m->combo_marker), &iter))
+    id = gtk_combo_box_get_active(GTK_COMBO_BOX(ui_m->m->combo_marker));
+    if (id < 0)
         return;
 
-    m = overlayaz_marker_list_get(GTK_LIST_STORE(model), &iter);
-    overlayaz_marker_set_latitude(m, gtk_spin_button_get_value(widget));
-    overlayaz_marker_list_update(GTK_LIST_STORE(model), &iter);
+    overlayaz_marker_store_set_latitude(ui_m->markers, id, gtk_spin_button_get_value(widget));
 
     overlayaz_ui_update_view(ui_m->ui, OVERLAYAZ_UI_UPDATE_IMAGE | OVERLAYAZ_UI_UPDATE_MAP);
 }
@@ -446,19 +399,16 @@ static void
 ui_menu_marker_spin_lon_changed(GtkSpinButton              *widget,
                                 overlayaz_ui_menu_marker_t *ui_m)
 {
-    GtkListStore *model = GTK_LIST_STORE(gtk_combo_box_get_model(GTK_COMBO_BOX(ui_m->m->combo_marker)));
-    GtkTreeIter iter;
-    overlayaz_marker_t *m;
+    gint id;
 
     if (ui_m->lock)
         return;
 
-    if (!gtk_combo_box_get_active_iter(GTK_COMBO_BOX(ui_m->m->combo_marker), &iter))
+    id = gtk_combo_box_get_active(GTK_COMBO_BOX(ui_m->m->combo_marker));
+    if (id < 0)
         return;
 
-    m = overlayaz_marker_list_get(GTK_LIST_STORE(model), &iter);
-    overlayaz_marker_set_longitude(m, gtk_spin_button_get_value(widget));
-    overlayaz_marker_list_update(GTK_LIST_STORE(model), &iter);
+    overlayaz_marker_store_set_longitude(ui_m->markers, id, gtk_spin_button_get_value(widget));
 
     overlayaz_ui_update_view(ui_m->ui, OVERLAYAZ_UI_UPDATE_IMAGE | OVERLAYAZ_UI_UPDATE_MAP);
 }
@@ -467,109 +417,125 @@ static void
 ui_menu_marker_combo_changed_tick(GtkComboBox                *widget,
                                   overlayaz_ui_menu_marker_t *ui_m)
 {
-    GtkListStore *model = GTK_LIST_STORE(gtk_combo_box_get_model(GTK_COMBO_BOX(ui_m->m->combo_marker)));
-    GtkTreeIter iter;
-    overlayaz_marker_t *m;
+    gint id;
+    cairo_region_t *area;
+    guint revision;
 
     if (ui_m->lock)
         return;
 
-    if (!gtk_combo_box_get_active_iter(GTK_COMBO_BOX(ui_m->m->combo_marker), &iter))
+    id = gtk_combo_box_get_active(GTK_COMBO_BOX(ui_m->m->combo_marker));
+    if (id < 0)
         return;
 
-    m = overlayaz_marker_list_get(GTK_LIST_STORE(model), &iter);
-    overlayaz_marker_set_tick(m, gtk_combo_box_get_active(widget));
-    overlayaz_marker_list_update(GTK_LIST_STORE(model), &iter);
+    revision = overlayaz_get_revision(ui_m->o);
+    area = ui_menu_marker_area(ui_m, id, NULL);
+    overlayaz_marker_store_set_tick(ui_m->markers, id, gtk_combo_box_get_active(widget));
+    ui_menu_marker_area(ui_m, id, area);
 
-    overlayaz_ui_update_view(ui_m->ui, OVERLAYAZ_UI_UPDATE_IMAGE);
+    overlayaz_ui_update_image_area(ui_m->ui, revision, area);
+    cairo_region_destroy(area);
 }
 
 static void
 ui_menu_marker_font_set(GtkFontButton              *widget,
                         overlayaz_ui_menu_marker_t *ui_m)
 {
-    GtkListStore *model = GTK_LIST_STORE(gtk_combo_box_get_model(GTK_COMBO_BOX(ui_m->m->combo_marker)));
-    GtkTreeIter iter;
-    overlayaz_marker_t *m;
+    gint id;
+    cairo_region_t *area;
+    guint revision;
     gchar *font;
+    guint style;
 
     if (ui_m->lock)
         return;
 
-    if (!gtk_combo_box_get_active_iter(GTK_COMBO_BOX(ui_m->m->combo_marker), &iter))
+    id = gtk_combo_box_get_active(GTK_COMBO_BOX(ui_m->m->combo_marker));
+    if (id < 0)
         return;
 
     font = gtk_font_chooser_get_font(GTK_FONT_CHOOSER(widget));
+    style = overlayaz_marker_store_get_style(ui_m->markers, id);
+    style = overlayaz_marker_style_lookup(ui_m->style, font, overlayaz_marker_style_get_color(ui_m->style, style));
 
-    m = overlayaz_marker_list_get(GTK_LIST_STORE(model), &iter);
-    overlayaz_marker_set_font(m, font);
-    overlayaz_marker_list_update(GTK_LIST_STORE(model), &iter);
+    revision = overlayaz_get_revision(ui_m->o);
+    area = ui_menu_marker_area(ui_m, id, NULL);
+    overlayaz_marker_store_set_style(ui_m->markers, id, style);
+    ui_menu_marker_area(ui_m, id, area);
 
     g_free(font);
-    overlayaz_ui_update_view(ui_m->ui, OVERLAYAZ_UI_UPDATE_IMAGE);
+    overlayaz_ui_update_image_area(ui_m->ui, revision, area);
+    cairo_region_destroy(area);
 }
 
 static void
 ui_menu_marker_font_color_set(GtkColorButton             *widget,
                               overlayaz_ui_menu_marker_t *ui_m)
 {
-    GtkListStore *model = GTK_LIST_STORE(gtk_combo_box_get_model(GTK_COMBO_BOX(ui_m->m->combo_marker)));
-    GtkTreeIter iter;
+    gint id;
     GdkRGBA color;
-    overlayaz_marker_t *m;
+    cairo_region_t *area;
+    guint revision;
+    guint style;
 
     if (ui_m->lock)
         return;
 
-    if (!gtk_combo_box_get_active_iter(GTK_COMBO_BOX(ui_m->m->combo_marker), &iter))
+    id = gtk_combo_box_get_active(GTK_COMBO_BOX(ui_m->m->combo_marker));
+    if (id < 0)
         return;
 
     gtk_color_chooser_get_rgba(GTK_COLOR_CHOOSER(widget), &color);
-    m = overlayaz_marker_list_get(GTK_LIST_STORE(model), &iter);
-    overlayaz_marker_set_font_color_rgba(m, &color);
-    overlayaz_marker_list_update(GTK_LIST_STORE(model), &iter);
+    style = overlayaz_marker_store_get_style(ui_m->markers, id);
+    style = overlayaz_marker_style_lookup(ui_m->style, overlayaz_font_get(overlayaz_marker_style_get_font(ui_m->style, style)), &color);
 
-    overlayaz_ui_update_view(ui_m->ui, OVERLAYAZ_UI_UPDATE_IMAGE);
+    revision = overlayaz_get_revision(ui_m->o);
+    area = ui_menu_marker_area(ui_m, id, NULL);
+    overlayaz_marker_store_set_style(ui_m->markers, id, style);
+    ui_menu_marker_area(ui_m, id, area);
+
+    overlayaz_ui_update_image_area(ui_m->ui, revision, area);
+    cairo_region_destroy(area);
 }
 
 static void
 ui_menu_marker_scale_pos_changed(GtkRange                   *widget,
                                  overlayaz_ui_menu_marker_t *ui_m)
 {
-    GtkListStore *model = GTK_LIST_STORE(gtk_combo_box_get_model(GTK_COMBO_BOX(ui_m->m->combo_marker)));
-    GtkTreeIter iter;
-    overlayaz_marker_t *m;
+    gint id;
+    cairo_region_t *area;
+    guint revision;
 
     if (ui_m->lock)
         return;
 
-    if (!gtk_combo_box_get_active_iter(GTK_COMBO_BOX(ui_m->m->combo_marker), &iter))
+    id = gtk_combo_box_get_active(GTK_COMBO_BOX(ui_m->m->combo_marker));
+    if (id < 0)
         return;
 
-    m = overlayaz_marker_list_get(GTK_LIST_STORE(model), &iter);
-    overlayaz_marker_set_position(m, gtk_range_get_value(widget));
-    overlayaz_marker_list_update(GTK_LIST_STORE(model), &iter);
+    revision = overlayaz_get_revision(ui_m->o);
+    area = ui_menu_marker_area(ui_m, id, NULL);
+    overlayaz_marker_store_set_position(ui_m->markers, id, gtk_range_get_value(widget));
+    ui_menu_marker_area(ui_m, id, area);
 
-    overlayaz_ui_update_view(ui_m->ui, OVERLAYAZ_UI_UPDATE_IMAGE);
+    overlayaz_ui_update_image_area(ui_m->ui, revision, area);
+    cairo_region_destroy(area);
 }
 
 static void
 ui_menu_marker_check_active_toggled(GtkToggleButton            *widget,
                                     overlayaz_ui_menu_marker_t *ui_m)
 {
-    GtkListStore *model = GTK_LIST_STORE(gtk_combo_box_get_model(GTK_COMBO_BOX(ui_m->m->combo_marker)));
-    GtkTreeIter iter;
-    overlayaz_marker_t *m;
+    gint id;
 
     if (ui_m->lock)
         return;
 
-    if (!gtk_combo_box_get_active_iter(GTK_COMBO_BOX(ui_m->m->combo_marker), &iter))
+    id = gtk_combo_box_get_active(GTK_COMBO_BOX(ui_m->m->combo_marker));
+    if (id < 0)
         return;
 
-    m = overlayaz_marker_list_get(GTK_LIST_STORE(model), &iter);
-    overlayaz_marker_set_active(m, gtk_toggle_button_get_active(widget));
-    overlayaz_marker_list_update(GTK_LIST_STORE(model), &iter);
+    overlayaz_marker_store_set_active(ui_m->markers, id, gtk_toggle_button_get_active(widget));
 
     overlayaz_ui_update_view(ui_m->ui, OVERLAYAZ_UI_UPDATE_IMAGE | OVERLAYAZ_UI_UPDATE_MAP);
 }
@@ -578,42 +544,48 @@ static void
 ui_menu_marker_check_show_azi_toggled(GtkToggleButton            *widget,
                                       overlayaz_ui_menu_marker_t *ui_m)
 {
-    GtkListStore *model = GTK_LIST_STORE(gtk_combo_box_get_model(GTK_COMBO_BOX(ui_m->m->combo_marker)));
-    GtkTreeIter iter;
-    overlayaz_marker_t *m;
+    gint id;
+    cairo_region_t *area;
+    guint revision;
 
     if (ui_m->lock)
         return;
 
-    if (!gtk_combo_box_get_active_iter(GTK_COMBO_BOX(ui_m->m->combo_marker), &iter))
+    id = gtk_combo_box_get_active(GTK_COMBO_BOX(ui_m->m->combo_marker));
+    if (id < 0)
         return;
 
-    m = overlayaz_marker_list_get(GTK_LIST_STORE(model), &iter);
-    overlayaz_marker_set_show_azimuth(m, gtk_toggle_button_get_active(widget));
-    overlayaz_marker_list_update(GTK_LIST_STORE(model), &iter);
+    revision = overlayaz_get_revision(ui_m->o);
+    area = ui_menu_marker_area(ui_m, id, NULL);
+    overlayaz_marker_store_set_show_azimuth(ui_m->markers, id, gtk_toggle_button_get_active(widget));
+    ui_menu_marker_area(ui_m, id, area);
 
-    overlayaz_ui_update_view(ui_m->ui, OVERLAYAZ_UI_UPDATE_IMAGE);
+    overlayaz_ui_update_image_area(ui_m->ui, revision, area);
+    cairo_region_destroy(area);
 }
 
 static void
 ui_menu_marker_check_show_dist_toggled(GtkToggleButton            *widget,
                                        overlayaz_ui_menu_marker_t *ui_m)
 {
-    GtkListStore *model = GTK_LIST_STORE(gtk_combo_box_get_model(GTK_COMBO_BOX(ui_m->m->combo_marker)));
-    GtkTreeIter iter;
-    overlayaz_marker_t *m;
+    gint id;
+    cairo_region_t *area;
+    guint revision;
 
     if (ui_m->lock)
         return;
 
-    if (!gtk_combo_box_get_active_iter(GTK_COMBO_BOX(ui_m->m->combo_marker), &iter))
+    id = gtk_combo_box_get_active(GTK_COMBO_BOX(ui_m->m->combo_marker));
+    if (id < 0)
         return;
 
-    m = overlayaz_marker_list_get(GTK_LIST_STORE(model), &iter);
-    overlayaz_marker_set_show_distance(m, gtk_toggle_button_get_active(widget));
-    overlayaz_marker_list_update(GTK_LIST_STORE(model), &iter);
+    revision = overlayaz_get_revision(ui_m->o);
+    area = ui_menu_marker_area(ui_m, id, NULL);
+    overlayaz_marker_store_set_show_distance(ui_m->markers, id, gtk_toggle_button_get_active(widget));
+    ui_menu_marker_area(ui_m, id, area);
 
-    overlayaz_ui_update_view(ui_m->ui, OVERLAYAZ_UI_UPDATE_IMAGE);
+    overlayaz_ui_update_image_area(ui_m->ui, revision, area);
+    cairo_region_destroy(area);
 }
 
 static void
@@ -623,12 +595,13 @@ ui_menu_marker_spin_latlon_changed(GtkSpinButton              *widget,
     struct overlayaz_location home;
     gdouble lat, lon;
     gdouble azi, dist;
-    GtkTreeIter iter;
+    gint id;
 
     if (ui_m->lock)
         return;
 
-    if (!gtk_combo_box_get_active_iter(GTK_COMBO_BOX(ui_m->m->combo_marker), &iter))
+    id = gtk_combo_box_get_active(GTK_COMBO_BOX(ui_m->m->combo_marker));
+    if (id < 0)
         return;
 
     if (!overlayaz_get_location(ui_m->o, &home))
@@ -672,23 +645,20 @@ static void
 ui_menu_marker_button_tick_apply(GtkButton                  *widget,
                                  overlayaz_ui_menu_marker_t *ui_m)
 {
-    GtkTreeModel *model = gtk_combo_box_get_model(GTK_COMBO_BOX(ui_m->m->combo_marker));
+    gint count = overlayaz_marker_store_count(ui_m->markers);
     gint value = gtk_combo_box_get_active(GTK_COMBO_BOX(ui_m->m->combo_tick));
-    GtkTreeIter iter;
-    overlayaz_marker_t *m;
+    gint id;
 
-    if (!gtk_tree_model_get_iter_first(model, &iter))
+    if (count == 0)
         return;
 
     if (!ui_marker_dialog_apply(ui_m->ui, "tick"))
         return;
 
-    do
-    {
-        m = overlayaz_marker_list_get(GTK_LIST_STORE(model), &iter);
-        overlayaz_marker_set_tick(m, value);
-        overlayaz_marker_list_update(GTK_LIST_STORE(model), &iter);
-    } while (gtk_tree_model_iter_next(model, &iter));
+    overlayaz_marker_store_begin(ui_m->markers);
+    for (id = 0; id < count; id++)
+        overlayaz_marker_store_set_tick(ui_m->markers, id, value);
+    overlayaz_marker_store_commit(ui_m->markers);
 
     overlayaz_ui_update_view(ui_m->ui, OVERLAYAZ_UI_UPDATE_IMAGE);
 }
@@ -697,13 +667,13 @@ static void
 ui_menu_marker_button_font_apply(GtkButton                  *widget,
                                  overlayaz_ui_menu_marker_t *ui_m)
 {
-    GtkTreeModel *model = gtk_combo_box_get_model(GTK_COMBO_BOX(ui_m->m->combo_marker));
+    gint count = overlayaz_marker_store_count(ui_m->markers);
     gchar *value;
     GdkRGBA color;
-    GtkTreeIter iter;
-    overlayaz_marker_t *m;
+    guint style;
+    gint id;
 
-    if (!gtk_tree_model_get_iter_first(model, &iter))
+    if (count == 0)
         return;
 
     if (!ui_marker_dialog_apply(ui_m->ui, "font"))
@@ -711,14 +681,12 @@ ui_menu_marker_button_font_apply(GtkButton                  *widget,
 
     value = gtk_font_chooser_get_font(GTK_FONT_CHOOSER(ui_m->m->font_marker));
     gtk_color_chooser_get_rgba(GTK_COLOR_CHOOSER(ui_m->m->color_marker_font), &color);
+    style = overlayaz_marker_style_lookup(ui_m->style, value, &color);
 
-    do
-    {
-        m = overlayaz_marker_list_get(GTK_LIST_STORE(model), &iter);
-        overlayaz_marker_set_font(m, value);
-        overlayaz_marker_set_font_color_rgba(m, &color);
-        overlayaz_marker_list_update(GTK_LIST_STORE(model), &iter);
-    } while (gtk_tree_model_iter_next(model, &iter));
+    overlayaz_marker_store_begin(ui_m->markers);
+    for (id = 0; id < count; id++)
+        overlayaz_marker_store_set_style(ui_m->markers, id, style);
+    overlayaz_marker_store_commit(ui_m->markers);
 
     overlayaz_ui_update_view(ui_m->ui, OVERLAYAZ_UI_UPDATE_IMAGE);
     g_free(value);
@@ -729,23 +697,20 @@ ui_menu_marker_button_pos_apply(GtkButton                  *widget,
                                 overlayaz_ui_menu_marker_t *ui_m)
 {
 
-    GtkTreeModel *model = gtk_combo_box_get_model(GTK_COMBO_BOX(ui_m->m->combo_marker));
+    gint count = overlayaz_marker_store_count(ui_m->markers);
     gdouble value = gtk_range_get_value(GTK_RANGE(ui_m->m->scale_pos));
-    GtkTreeIter iter;
-    overlayaz_marker_t *m;
+    gint id;
 
-    if (!gtk_tree_model_get_iter_first(model, &iter))
+    if (count == 0)
         return;
 
     if (!ui_marker_dialog_apply(ui_m->ui, "position"))
         return;
 
-    do
-    {
-        m = overlayaz_marker_list_get(GTK_LIST_STORE(model), &iter);
-        overlayaz_marker_set_position(m, value);
-        overlayaz_marker_list_update(GTK_LIST_STORE(model), &iter);
-    } while (gtk_tree_model_iter_next(model, &iter));
+    overlayaz_marker_store_begin(ui_m->markers);
+    for (id = 0; id < count; id++)
+        overlayaz_marker_store_set_position(ui_m->markers, id, value);
+    overlayaz_marker_store_commit(ui_m->markers);
 
     overlayaz_ui_update_view(ui_m->ui, OVERLAYAZ_UI_UPDATE_IMAGE);
 }
@@ -754,23 +719,20 @@ static void
 ui_menu_marker_button_active_apply(GtkButton                  *widget,
                                    overlayaz_ui_menu_marker_t *ui_m)
 {
-    GtkTreeModel *model = gtk_combo_box_get_model(GTK_COMBO_BOX(ui_m->m->combo_marker));
+    gint count = overlayaz_marker_store_count(ui_m->markers);
     gboolean value = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(ui_m->m->check_active));
-    GtkTreeIter iter;
-    overlayaz_marker_t *m;
+    gint id;
 
-    if (!gtk_tree_model_get_iter_first(model, &iter))
+    if (count == 0)
         return;
 
     if (!ui_marker_dialog_apply(ui_m->ui, "active flag"))
         return;
 
-    do
-    {
-        m = overlayaz_marker_list_get(GTK_LIST_STORE(model), &iter);
-        overlayaz_marker_set_active(m, value);
-        overlayaz_marker_list_update(GTK_LIST_STORE(model), &iter);
-    } while (gtk_tree_model_iter_next(model, &iter));
+    overlayaz_marker_store_begin(ui_m->markers);
+    for (id = 0; id < count; id++)
+        overlayaz_marker_store_set_active(ui_m->markers, id, value);
+    overlayaz_marker_store_commit(ui_m->markers);
 
     overlayaz_ui_update_view(ui_m->ui, OVERLAYAZ_UI_UPDATE_IMAGE | OVERLAYAZ_UI_UPDATE_MAP);
 }
@@ -779,23 +741,20 @@ static void
 ui_menu_marker_button_show_azi_apply(GtkButton                  *widget,
                                      overlayaz_ui_menu_marker_t *ui_m)
 {
-    GtkTreeModel *model = gtk_combo_box_get_model(GTK_COMBO_BOX(ui_m->m->combo_marker));
+    gint count = overlayaz_marker_store_count(ui_m->markers);
     gboolean value = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(ui_m->m->check_show_azi));
-    GtkTreeIter iter;
-    overlayaz_marker_t *m;
+    gint id;
 
-    if (!gtk_tree_model_get_iter_first(model, &iter))
+    if (count == 0)
         return;
 
     if (!ui_marker_dialog_apply(ui_m->ui, "show azimuth flag"))
         return;
 
-    do
-    {
-        m = overlayaz_marker_list_get(GTK_LIST_STORE(model), &iter);
-        overlayaz_marker_set_show_azimuth(m, value);
-        overlayaz_marker_list_update(GTK_LIST_STORE(model), &iter);
-    } while (gtk_tree_model_iter_next(model, &iter));
+    overlayaz_marker_store_begin(ui_m->markers);
+    for (id = 0; id < count; id++)
+        overlayaz_marker_store_set_show_azimuth(ui_m->markers, id, value);
+    overlayaz_marker_store_commit(ui_m->markers);
 
     overlayaz_ui_update_view(ui_m->ui, OVERLAYAZ_UI_UPDATE_IMAGE);
 }
@@ -804,23 +763,20 @@ static void
 ui_menu_marker_button_show_dist_apply(GtkButton                  *widget,
                                       overlayaz_ui_menu_marker_t *ui_m)
 {
-    GtkTreeModel *model = gtk_combo_box_get_model(GTK_COMBO_BOX(ui_m->m->combo_marker));
+    gint count = overlayaz_marker_store_count(ui_m->markers);
     gboolean value = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(ui_m->m->check_show_dist));
-    GtkTreeIter iter;
-    overlayaz_marker_t *m;
+    gint id;
 
-    if (!gtk_tree_model_get_iter_first(model, &iter))
+    if (count == 0)
         return;
 
     if (!ui_marker_dialog_apply(ui_m->ui, "show distance flag"))
         return;
 
-    do
-    {
-        m = overlayaz_marker_list_get(GTK_LIST_STORE(model), &iter);
-        overlayaz_marker_set_show_distance(m, value);
-        overlayaz_marker_list_update(GTK_LIST_STORE(model), &iter);
-    } while (gtk_tree_model_iter_next(model, &iter));
+    overlayaz_marker_store_begin(ui_m->markers);
+    for (id = 0; id < count; id++)
+        overlayaz_marker_store_set_show_distance(ui_m->markers, id, value);
+    overlayaz_marker_store_commit(ui_m->markers);
 
     overlayaz_ui_update_view(ui_m->ui, OVERLAYAZ_UI_UPDATE_IMAGE);
 }
@@ -836,3 +792,20 @@ ui_marker_dialog_apply(overlayaz_ui_t *ui,
     g_free(text);
     return ret;
 }
+
+static cairo_region_t*
+ui_menu_marker_area(overlayaz_ui_menu_marker_t *ui_m,
+                    gint                        id,
+                    cairo_region_t             *area)
+{
+    cairo_rectangle_int_t rect;
+
+    if (area == NULL)
+        area = cairo_region_create();
+
+    /* Called before and after a change, the area covers both label placements */
+    if (overlayaz_draw_marker_extents(ui_m->o, id, &rect))
+        cairo_region_union_rectangle(area, &rect);
+
+    return area;
+}
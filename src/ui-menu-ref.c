@@ -513,7 +513,7 @@ ui_menu_ref_button_ref_clicked(GtkButton               *button,
 
     /* Redraw canvas to highlight the reference which is going to be modified */
     if (button != GTK_BUTTON(ui_r->r->button_coord_ref))
-        overlayaz_ui_update_view(ui_r->ui, OVERLAYAZ_UI_UPDATE_IMAGE);
+        overlayaz_ui_update_view(ui_r->ui, OVERLAYAZ_UI_UPDATE_REFS);
 }
 
 static void
@@ -17,6 +17,8 @@
 #include <osm-gps-map-source.h>
 #include "ui-preferences.h"
 #include "conf.h"
+#include "srtm.h"
+#include "depth.h"
 #ifdef G_OS_WIN32
 #include "mingw.h"
 #endif
@@ -40,7 +42,15 @@ typedef struct overlayaz_dialog_prefs
     GtkWidget *spin_longitude;
     GtkWidget *label_altitude;
     GtkWidget *spin_altitude;
+    GtkWidget *label_marker_occlusion;
+    GtkWidget *combo_marker_occlusion;
+    GtkWidget *label_horizon_distance;
+    GtkWidget *spin_horizon_distance;
+    GtkWidget *check_horizon;
+    GtkWidget *label_depth_resolution;
+    GtkWidget *spin_depth_resolution;
     GtkWidget *check_dark_theme;
+    gboolean image_update;
     gboolean map_update;
     gboolean map_source_change;
 } overlayaz_dialog_prefs_t;
@@ -51,6 +61,8 @@ static void ui_preferences_from_config(overlayaz_dialog_prefs_t*);
 static void ui_preferences_to_config(overlayaz_dialog_prefs_t*);
 static void ui_preferences_combo_map_source_changed(GtkComboBox*, gpointer);
 static void ui_preferences_spin_map_grid_distance_changed(GtkSpinButton*, gpointer);
+static void ui_preferences_combo_marker_occlusion_changed(GtkComboBox*, gpointer);
+static void ui_preferences_horizon_changed(GtkWidget*, gpointer);
 static void ui_preferences_button_location_clicked(GtkButton*, gpointer);
 
 
@@ -64,6 +76,7 @@ overlayaz_ui_preferences(overlayaz_ui_t    *ui,
     GtkCellRenderer *renderer;
 
     p.o = o;
+    p.image_update = FALSE;
     p.map_update = FALSE;
     p.map_source_change = FALSE;
     p.dialog = gtk_dialog_new_with_buttons("Preferences",
@@ -148,6 +161,35 @@ overlayaz_ui_preferences(overlayaz_ui_t    *ui,
     p.spin_altitude = gtk_spin_button_new_with_range(OVERLAYAZ_WINDOW_ALT_MIN, OVERLAYAZ_WINDOW_ALT_MAX, OVERLAYAZ_WINDOW_ALT_STEP);
     gtk_grid_attach(GTK_GRID (p.grid), p.spin_altitude, 2, grid_pos, 1, 1);
 
+    p.label_marker_occlusion = gtk_label_new("Hidden markers:");
+    gtk_widget_set_halign(GTK_WIDGET(p.label_marker_occlusion), GTK_ALIGN_START);
+    gtk_grid_attach(GTK_GRID (p.grid), p.label_marker_occlusion, 1, ++grid_pos, 1, 1);
+
+    p.combo_marker_occlusion = gtk_combo_box_text_new();
+    gtk_combo_box_text_insert_text(GTK_COMBO_BOX_TEXT(p.combo_marker_occlusion), OVERLAYAZ_CONF_MARKER_OCCLUSION_SHOW, "Show");
+    gtk_combo_box_text_insert_text(GTK_COMBO_BOX_TEXT(p.combo_marker_occlusion), OVERLAYAZ_CONF_MARKER_OCCLUSION_DIM, "Dim");
+    gtk_combo_box_text_insert_text(GTK_COMBO_BOX_TEXT(p.combo_marker_occlusion), OVERLAYAZ_CONF_MARKER_OCCLUSION_HIDE, "Hide");
+    gtk_widget_set_tooltip_text(p.combo_marker_occlusion, "Markers obscured by terrain (requires SRTM data)");
+    gtk_grid_attach(GTK_GRID (p.grid), p.combo_marker_occlusion, 2, grid_pos, 1, 1);
+
+    p.label_horizon_distance = gtk_label_new("Terrain range [km]:");
+    gtk_widget_set_halign(GTK_WIDGET(p.label_horizon_distance), GTK_ALIGN_START);
+    gtk_grid_attach(GTK_GRID (p.grid), p.label_horizon_distance, 1, ++grid_pos, 1, 1);
+
+    p.spin_horizon_distance = gtk_spin_button_new_with_range(1.0, 500.0, 1.0);
+    gtk_grid_attach(GTK_GRID (p.grid), p.spin_horizon_distance, 2, grid_pos, 1, 1);
+
+    p.label_depth_resolution = gtk_label_new("Distance map cell [px]:");
+    gtk_widget_set_halign(GTK_WIDGET(p.label_depth_resolution), GTK_ALIGN_START);
+    gtk_grid_attach(GTK_GRID (p.grid), p.label_depth_resolution, 1, ++grid_pos, 1, 1);
+
+    p.spin_depth_resolution = gtk_spin_button_new_with_range(1.0, 64.0, 1.0);
+    gtk_grid_attach(GTK_GRID (p.grid), p.spin_depth_resolution, 2, grid_pos, 1, 1);
+
+    p.check_horizon = gtk_check_button_new_with_label("Draw terrain horizon (requires SRTM data)");
+    gtk_widget_set_halign(GTK_WIDGET(p.check_horizon), GTK_ALIGN_START);
+    gtk_grid_attach(GTK_GRID (p.grid), p.check_horizon, 1, ++grid_pos, 2, 1);
+
     p.check_dark_theme = gtk_check_button_new_with_label("Prefer dark theme (restart required)");
     gtk_widget_set_halign(GTK_WIDGET(p.check_dark_theme), GTK_ALIGN_START);
     gtk_grid_attach(GTK_GRID (p.grid), p.check_dark_theme, 1, ++grid_pos, 2, 1);
@@ -160,6 +202,9 @@ overlayaz_ui_preferences(overlayaz_ui_t    *ui,
     g_signal_connect(p.combo_map_source, "changed", G_CALLBACK(ui_preferences_combo_map_source_changed), &p);
     g_signal_connect(p.spin_map_grid_distance, "value-changed", G_CALLBACK(ui_preferences_spin_map_grid_distance_changed), &p);
     g_signal_connect(p.button_location, "clicked", G_CALLBACK(ui_preferences_button_location_clicked), &p);
+    g_signal_connect(p.combo_marker_occlusion, "changed", G_CALLBACK(ui_preferences_combo_marker_occlusion_changed), &p);
+    g_signal_connect(p.spin_horizon_distance, "value-changed", G_CALLBACK(ui_preferences_horizon_changed), &p);
+    g_signal_connect(p.check_horizon, "toggled", G_CALLBACK(ui_preferences_horizon_changed), &p);
 
     if (gtk_dialog_run(GTK_DIALOG(p.dialog)) == GTK_RESPONSE_APPLY)
         ui_preferences_to_config(&p);
@@ -170,6 +215,9 @@ overlayaz_ui_preferences(overlayaz_ui_t    *ui,
     if (p.map_update)
         overlayaz_ui_update_view(ui, OVERLAYAZ_UI_UPDATE_MAP);
 
+    if (p.image_update)
+        overlayaz_ui_update_view(ui, OVERLAYAZ_UI_UPDATE_IMAGE | OVERLAYAZ_UI_UPDATE_OVERLAY);
+
     gtk_widget_destroy(p.dialog);
 }
 
@@ -221,6 +269,11 @@ ui_preferences_from_config(overlayaz_dialog_prefs_t *p)
     gtk_spin_button_set_value(GTK_SPIN_BUTTON(p->spin_longitude), overlayaz_conf_get_longitude());
     gtk_spin_button_set_value(GTK_SPIN_BUTTON(p->spin_altitude), overlayaz_conf_get_altitude());
 
+    gtk_combo_box_set_active(GTK_COMBO_BOX(p->combo_marker_occlusion), overlayaz_conf_get_marker_occlusion());
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(p->spin_horizon_distance), overlayaz_conf_get_horizon_distance());
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(p->check_horizon), overlayaz_conf_get_horizon());
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(p->spin_depth_resolution), overlayaz_conf_get_depth_resolution());
+
     gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(p->check_dark_theme), overlayaz_conf_get_dark_theme());
 
     g_free(srtm_path);
@@ -233,7 +286,10 @@ ui_preferences_to_config(overlayaz_dialog_prefs_t *p)
 
     srtm_path = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(p->file_chooser_srtm));
     if (srtm_path && strlen(srtm_path))
+    {
         overlayaz_conf_set_srtm_path(srtm_path);
+        overlayaz_srtm_set_directory(srtm_path);
+    }
 
     overlayaz_conf_set_map_source(gtk_combo_box_get_active(GTK_COMBO_BOX(p->combo_map_source)));
     overlayaz_conf_set_map_grid_distance(gtk_spin_button_get_value(GTK_SPIN_BUTTON(p->spin_map_grid_distance)));
@@ -242,9 +298,19 @@ ui_preferences_to_config(overlayaz_dialog_prefs_t *p)
     overlayaz_conf_set_longitude(gtk_spin_button_get_value(GTK_SPIN_BUTTON(p->spin_longitude)));
     overlayaz_conf_set_altitude(gtk_spin_button_get_value(GTK_SPIN_BUTTON(p->spin_altitude)));
 
+    overlayaz_conf_set_marker_occlusion(gtk_combo_box_get_active(GTK_COMBO_BOX(p->combo_marker_occlusion)));
+    overlayaz_conf_set_horizon_distance(gtk_spin_button_get_value(GTK_SPIN_BUTTON(p->spin_horizon_distance)));
+    overlayaz_conf_set_horizon(gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(p->check_horizon)));
+    overlayaz_conf_set_depth_resolution(gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(p->spin_depth_resolution)));
+
     overlayaz_conf_set_dark_theme(gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(p->check_dark_theme)));
 
     g_free(srtm_path);
+    srtm_path = overlayaz_conf_get_srtm_path();
+    overlayaz_depth_set_terrain(srtm_path,
+                                overlayaz_conf_get_depth_resolution(),
+                                overlayaz_conf_get_horizon_distance() * 1000.0);
+    g_free(srtm_path);
 }
 
 static void
@@ -277,3 +343,19 @@ ui_preferences_spin_map_grid_distance_changed(GtkSpinButton *spin_button,
     overlayaz_dialog_prefs_t *prefs = (overlayaz_dialog_prefs_t*)user_data;
     prefs->map_update = TRUE;
 }
+
+static void
+ui_preferences_combo_marker_occlusion_changed(GtkComboBox *combo_box,
+                                              gpointer     user_data)
+{
+    overlayaz_dialog_prefs_t *prefs = (overlayaz_dialog_prefs_t*)user_data;
+    prefs->image_update = TRUE;
+}
+
+static void
+ui_preferences_horizon_changed(GtkWidget *widget,
+                               gpointer   user_data)
+{
+    overlayaz_dialog_prefs_t *prefs = (overlayaz_dialog_prefs_t*)user_data;
+    prefs->image_update = TRUE;
+}
@@ -60,7 +60,7 @@ overlayaz_ui_util_format_distance(gdouble value)
 {
     gint precision;
 
-    if (value < 1000)
+    if (isnan(value) || value < 1000)
         return format_value_and_unit(value, 0, " m");
 
     value /= 1000.0;
@@ -19,23 +19,60 @@
 #include "ui-view-img.h"
 #include "ui-util.h"
 #include "draw.h"
+#include "depth.h"
+#include "pixel.h"
 
 #define UI_VIEW_IMG_ZOOM_LIMIT 10.0
 #define UI_VIEW_IMG_ZOOM_FACTOR 1.25
 #define UI_VIEW_IMG_ROTATION_STEP 0.05
 
+/* Each mipmap level halves the previous one, down to this size */
+#define UI_VIEW_IMG_MIPMAP_LEVELS 16
+#define UI_VIEW_IMG_MIPMAP_MIN_SIZE 256
+
+/* Levels are rasterized on demand in square tiles, at most 128 MiB of them are kept.
+   The full resolution is not cached, its tiles are taken from the bands of the image. */
+#define UI_VIEW_IMG_TILE_SIZE OVERLAYAZ_IMAGE_BAND_HEIGHT
+#define UI_VIEW_IMG_TILE_CACHE 512
+
+/* The overlay is rendered with this margin around the viewport, so short pans only composite it */
+#define UI_VIEW_IMG_OVERLAY_MARGIN 512
+
+struct ui_view_img_tile
+{
+    gint64 key;
+    cairo_surface_t *surface;
+};
+
 struct overlayaz_ui_view_img
 {
     overlayaz_ui_t *ui;
     GtkDrawingArea *image;
     const overlayaz_t *o;
-    cairo_surface_t *surface;
+    GHashTable *tiles;
+    GQueue lru;
+    gint levels;
+    gint level_width[UI_VIEW_IMG_MIPMAP_LEVELS];
+    gint level_height[UI_VIEW_IMG_MIPMAP_LEVELS];
+    cairo_surface_t *overlay;
+    guint overlay_revision;
+    gdouble overlay_scale;
+    gdouble overlay_x;
+    gdouble overlay_y;
+    gint overlay_width;
+    gint overlay_height;
+    cairo_region_t *damage;
+    guint damage_revision;
+    cairo_surface_t *preview;
     gdouble scale;
     gdouble start_x;
     gdouble start_y;
     gdouble offset_x;
     gdouble offset_y;
     gboolean left_hold;
+    gboolean pointer;
+    gdouble pointer_x;
+    gdouble pointer_y;
 };
 
 static gboolean ui_view_img_draw(GtkWidget*, cairo_t*, overlayaz_ui_view_img_t*);
@@ -44,7 +81,14 @@ static gboolean ui_view_img_motion(GtkWidget*, GdkEventMotion*, overlayaz_ui_vie
 static gboolean ui_view_img_scroll(GtkWidget*, GdkEventScroll*, overlayaz_ui_view_img_t*);
 static gboolean ui_view_img_leave(GtkWidget*, GdkEvent*, overlayaz_ui_view_img_t*);
 
-static cairo_surface_t* ui_view_img_cache_surface(overlayaz_ui_view_img_t*, cairo_surface_t*);
+static void ui_view_img_cache_levels(overlayaz_ui_view_img_t*);
+static void ui_view_img_cache_draw(overlayaz_ui_view_img_t*, cairo_t*);
+static cairo_surface_t* ui_view_img_cache_tile(overlayaz_ui_view_img_t*, cairo_surface_t*, gint, gint, gint);
+static void ui_view_img_cache_free(overlayaz_ui_view_img_t*);
+static void ui_view_img_cache_tile_free(gpointer);
+static void ui_view_img_overlay_draw(overlayaz_ui_view_img_t*, cairo_t*, gint, gint);
+static void ui_view_img_overlay_repair(overlayaz_ui_view_img_t*);
+static void ui_view_img_preview_draw(overlayaz_ui_view_img_t*, cairo_t*, gint, gint);
 
 static void ui_view_img_measure(overlayaz_ui_view_img_t*, gdouble, gdouble);
 
@@ -59,6 +103,8 @@ overlayaz_ui_view_img_new(overlayaz_ui_t    *ui,
     ui_img->ui = ui;
     ui_img->image = GTK_DRAWING_AREA(image);
     ui_img->o = o;
+    ui_img->tiles = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, ui_view_img_cache_tile_free);
+    g_queue_init(&ui_img->lru);
 
     g_signal_connect(ui_img->image, "draw", G_CALLBACK(ui_view_img_draw), ui_img);
     g_signal_connect(ui_img->image, "button-press-event", G_CALLBACK(ui_view_img_click), ui_img);
@@ -73,9 +119,11 @@ overlayaz_ui_view_img_new(overlayaz_ui_t    *ui,
 void
 overlayaz_ui_view_img_free(overlayaz_ui_view_img_t *ui_img)
 {
-    if (ui_img->surface)
-        cairo_surface_destroy(ui_img->surface);
-
+    ui_view_img_cache_free(ui_img);
+    g_hash_table_destroy(ui_img->tiles);
+    overlayaz_ui_view_img_invalidate(ui_img);
+    if (ui_img->preview)
+        cairo_surface_destroy(ui_img->preview);
     g_free(ui_img);
 }
 
@@ -86,12 +134,9 @@ overlayaz_ui_view_img_sync(overlayaz_ui_view_img_t *ui_img,
     /* Reset the scale, it will be recalculated during redraw */
     ui_img->scale = 0.0;
 
-    if (ui_img->surface)
-    {
-        /* Remove cached surface */
-        cairo_surface_destroy(ui_img->surface);
-        ui_img->surface = NULL;
-    }
+    /* Remove cached surfaces */
+    ui_view_img_cache_free(ui_img);
+    overlayaz_ui_view_img_invalidate(ui_img);
 }
 
 void
@@ -100,6 +145,117 @@ overlayaz_ui_view_img_update(overlayaz_ui_view_img_t *ui_img)
     gtk_widget_queue_draw(GTK_WIDGET(ui_img->image));
 }
 
+void
+overlayaz_ui_view_img_update_area(overlayaz_ui_view_img_t *ui_img,
+                                  guint                    revision,
+                                  const cairo_region_t    *area)
+{
+    cairo_rectangle_int_t rect;
+    gdouble x1, y1, x2, y2;
+    gint i;
+
+    /* The area must cover every change made since the overlay was drawn or last damaged */
+    if (ui_img->overlay == NULL ||
+        ui_img->scale == 0.0 ||
+        (ui_img->overlay_revision != revision &&
+         (ui_img->damage == NULL || ui_img->damage_revision != revision)))
+    {
+        overlayaz_ui_view_img_update(ui_img);
+        return;
+    }
+
+    if (ui_img->damage == NULL)
+        ui_img->damage = cairo_region_create();
+    cairo_region_union(ui_img->damage, area);
+    ui_img->damage_revision = overlayaz_get_revision(ui_img->o);
+
+    for (i = 0; i < cairo_region_num_rectangles(area); i++)
+    {
+        /* A pixel of margin is left for the antialiasing */
+        cairo_region_get_rectangle(area, i, &rect);
+        x1 = floor((rect.x - ui_img->offset_x) * ui_img->scale) - 1.0;
+        y1 = floor((rect.y - ui_img->offset_y) * ui_img->scale) - 1.0;
+        x2 = ceil((rect.x + rect.width - ui_img->offset_x) * ui_img->scale) + 1.0;
+        y2 = ceil((rect.y + rect.height - ui_img->offset_y) * ui_img->scale) + 1.0;
+        gtk_widget_queue_draw_area(GTK_WIDGET(ui_img->image), x1, y1, x2 - x1, y2 - y1);
+    }
+}
+
+void
+overlayaz_ui_view_img_update_terrain(overlayaz_ui_view_img_t *ui_img)
+{
+    /* The distance map got ready without the pointer moving */
+    if (ui_img->pointer &&
+        ui_img->scale != 0.0)
+        ui_view_img_measure(ui_img, ui_img->pointer_x, ui_img->pointer_y);
+}
+
+void
+overlayaz_ui_view_img_update_refs(overlayaz_ui_view_img_t *ui_img)
+{
+    gint widget_width = gtk_widget_get_allocated_width(GTK_WIDGET(ui_img->image));
+    gint widget_height = gtk_widget_get_allocated_height(GTK_WIDGET(ui_img->image));
+    enum overlayaz_ref_type t;
+    enum overlayaz_ref_id i;
+    gdouble pos;
+    gint margin;
+
+    if (ui_img->scale == 0.0)
+        return;
+
+    /* Only the strips under the reference lines are redrawn */
+    margin = (gint)ceil(MAX(1.0*ui_img->scale, 1.0)) + 1;
+    for (t = 0; t < OVERLAYAZ_REF_TYPES; t++)
+    {
+        for (i = 0; i < OVERLAYAZ_REF_IDS; i++)
+        {
+            if (!overlayaz_get_ref_position(ui_img->o, t, i, &pos))
+                break;
+
+            if (t == OVERLAYAZ_REF_AZ)
+                gtk_widget_queue_draw_area(GTK_WIDGET(ui_img->image),
+                                           (gint)floor((pos - ui_img->offset_x) * ui_img->scale) - margin, 0,
+                                           2 * margin, widget_height);
+            else
+                gtk_widget_queue_draw_area(GTK_WIDGET(ui_img->image),
+                                           0, (gint)floor((pos - ui_img->offset_y) * ui_img->scale) - margin,
+                                           widget_width, 2 * margin);
+        }
+    }
+}
+
+void
+overlayaz_ui_view_img_invalidate(overlayaz_ui_view_img_t *ui_img)
+{
+    if (ui_img->overlay)
+    {
+        cairo_surface_destroy(ui_img->overlay);
+        ui_img->overlay = NULL;
+    }
+
+    if (ui_img->damage)
+    {
+        cairo_region_destroy(ui_img->damage);
+        ui_img->damage = NULL;
+    }
+}
+
+void
+overlayaz_ui_view_img_set_preview(overlayaz_ui_view_img_t *ui_img,
+                                  const GdkPixbuf         *preview)
+{
+    if (ui_img->preview)
+    {
+        cairo_surface_destroy(ui_img->preview);
+        ui_img->preview = NULL;
+    }
+
+    if (preview)
+        ui_img->preview = overlayaz_pixel_surface(preview);
+
+    overlayaz_ui_view_img_update(ui_img);
+}
+
 void
 overlayaz_ui_view_img_zoom_fit(overlayaz_ui_view_img_t *ui_img)
 {
@@ -147,11 +303,15 @@ ui_view_img_draw(GtkWidget               *widget,
     gdouble pos;
     gdouble r, g, b;
 
-    if (!overlayaz_get_pixbuf(ui_img->o))
+    if (!overlayaz_get_image(ui_img->o))
+    {
+        if (ui_img->preview)
+            ui_view_img_preview_draw(ui_img, cr, widget_width, widget_height);
         return GDK_EVENT_PROPAGATE;
+    }
 
-    if (ui_img->surface == NULL)
-        ui_img->surface = ui_view_img_cache_surface(ui_img, cairo_get_target(cr));
+    if (ui_img->levels == 0)
+        ui_view_img_cache_levels(ui_img);
 
     gint pb_x = overlayaz_get_width(ui_img->o);
     gint pb_y = overlayaz_get_height(ui_img->o);
@@ -179,9 +339,14 @@ ui_view_img_draw(GtkWidget               *widget,
     cairo_save(cr);
     cairo_scale(cr, ui_img->scale, ui_img->scale);
     cairo_translate(cr, -ui_img->offset_x, -ui_img->offset_y);
-    overlayaz_draw(cr, CAIRO_FILTER_BILINEAR, ui_img->surface, ui_img->o);
+    cairo_save(cr);
+    overlayaz_draw_rotate(cr, ui_img->o);
+    ui_view_img_cache_draw(ui_img, cr);
+    cairo_restore(cr);
     cairo_restore(cr);
 
+    ui_view_img_overlay_draw(ui_img, cr, widget_width, widget_height);
+
     valid_ref = overlayaz_ui_get_ref(ui_img->ui, &ref_type, &ref_id);
 
     for (t = 0; t < OVERLAYAZ_REF_TYPES; t++)
@@ -290,6 +455,9 @@ ui_view_img_motion(GtkWidget               *widget,
         overlayaz_ui_view_img_update(ui_img);
     }
 
+    ui_img->pointer = TRUE;
+    ui_img->pointer_x = event->x;
+    ui_img->pointer_y = event->y;
     ui_view_img_measure(ui_img, event->x, event->y);
     return GDK_EVENT_PROPAGATE;
 }
@@ -356,30 +524,298 @@ ui_view_img_leave(GtkWidget               *widget,
                   GdkEvent                *event,
                   overlayaz_ui_view_img_t *ui_img)
 {
+    ui_img->pointer = FALSE;
     overlayaz_ui_show_azimuth(ui_img->ui, NAN);
     overlayaz_ui_show_elevation(ui_img->ui, NAN);
+    overlayaz_ui_show_terrain(ui_img->ui, NAN);
     return GDK_EVENT_PROPAGATE;
 }
 
 
+static void
+ui_view_img_cache_levels(overlayaz_ui_view_img_t *ui_img)
+{
+    gint width = overlayaz_get_width(ui_img->o);
+    gint height = overlayaz_get_height(ui_img->o);
+
+    ui_img->level_width[0] = width;
+    ui_img->level_height[0] = height;
+    ui_img->levels = 1;
+
+    while (ui_img->levels < UI_VIEW_IMG_MIPMAP_LEVELS &&
+           MAX(width, height) / 2 >= UI_VIEW_IMG_MIPMAP_MIN_SIZE)
+    {
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+        ui_img->level_width[ui_img->levels] = width;
+        ui_img->level_height[ui_img->levels] = height;
+        ui_img->levels++;
+    }
+}
+
+static void
+ui_view_img_cache_draw(overlayaz_ui_view_img_t *ui_img,
+                       cairo_t                 *cr)
+{
+    cairo_surface_t *tile;
+    gint level = 0;
+    gint level_width, level_height;
+    gdouble factor_x, factor_y;
+    gdouble x1, y1, x2, y2;
+    gdouble left, top, right, bottom;
+    gint tx_first, tx_last, ty_first, ty_last;
+    gint tx, ty;
+
+    /* Use the smallest level that is still not magnified */
+    while (level + 1 < ui_img->levels &&
+           ui_img->scale <= 1.0 / (1 << (level + 1)))
+        level++;
+
+    level_width = ui_img->level_width[level];
+    level_height = ui_img->level_height[level];
+    factor_x = level_width / (gdouble)ui_img->level_width[0];
+    factor_y = level_height / (gdouble)ui_img->level_height[0];
+
+    /* Only the tiles within the visible part of the image are needed */
+    cairo_clip_extents(cr, &x1, &y1, &x2, &y2);
+    tx_first = CLAMP((gint)floor(x1 * factor_x) / UI_VIEW_IMG_TILE_SIZE, 0, (level_width - 1) / UI_VIEW_IMG_TILE_SIZE);
+    tx_last = CLAMP((gint)ceil(x2 * factor_x) / UI_VIEW_IMG_TILE_SIZE, 0, (level_width - 1) / UI_VIEW_IMG_TILE_SIZE);
+    ty_first = CLAMP((gint)floor(y1 * factor_y) / UI_VIEW_IMG_TILE_SIZE, 0, (level_height - 1) / UI_VIEW_IMG_TILE_SIZE);
+    ty_last = CLAMP((gint)ceil(y2 * factor_y) / UI_VIEW_IMG_TILE_SIZE, 0, (level_height - 1) / UI_VIEW_IMG_TILE_SIZE);
+
+    for (ty = ty_first; ty <= ty_last; ty++)
+    {
+        for (tx = tx_first; tx <= tx_last; tx++)
+        {
+            tile = ui_view_img_cache_tile(ui_img, cairo_get_target(cr), level, tx, ty);
+
+            left = tx * UI_VIEW_IMG_TILE_SIZE / factor_x;
+            top = ty * UI_VIEW_IMG_TILE_SIZE / factor_y;
+            right = MIN((tx + 1) * UI_VIEW_IMG_TILE_SIZE, level_width) / factor_x;
+            bottom = MIN((ty + 1) * UI_VIEW_IMG_TILE_SIZE, level_height) / factor_y;
+
+            /* Tiles overlap their right and bottom neighbours by a pixel to hide the seams */
+            if ((tx + 1) * UI_VIEW_IMG_TILE_SIZE < level_width)
+                right += 1.0 / factor_x;
+            if ((ty + 1) * UI_VIEW_IMG_TILE_SIZE < level_height)
+                bottom += 1.0 / factor_y;
+
+            cairo_set_source_surface(cr, tile, left, top);
+            cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_BILINEAR);
+            cairo_pattern_set_extend(cairo_get_source(cr), CAIRO_EXTEND_PAD);
+            cairo_rectangle(cr, left, top, right - left, bottom - top);
+            cairo_fill(cr);
+            cairo_surface_destroy(tile);
+        }
+    }
+}
+
 static cairo_surface_t*
-ui_view_img_cache_surface(overlayaz_ui_view_img_t *ui_img,
-                          cairo_surface_t         *other)
+ui_view_img_cache_tile(overlayaz_ui_view_img_t *ui_img,
+                       cairo_surface_t         *other,
+                       gint                     level,
+                       gint                     tx,
+                       gint                     ty)
 {
-    cairo_surface_t *surface;
+    const overlayaz_image_t *image = overlayaz_get_image(ui_img->o);
+    struct ui_view_img_tile *tile;
+    cairo_surface_t *child;
+    gint64 key;
+    gint width, height;
+    gint cx, cy;
+    gdouble factor_x, factor_y;
+
+    width = MIN(UI_VIEW_IMG_TILE_SIZE, ui_img->level_width[level] - tx * UI_VIEW_IMG_TILE_SIZE);
+    height = MIN(UI_VIEW_IMG_TILE_SIZE, ui_img->level_height[level] - ty * UI_VIEW_IMG_TILE_SIZE);
+
+    /* The full resolution tiles share the pixels of the image */
+    if (level == 0)
+        return overlayaz_image_surface(image, tx * UI_VIEW_IMG_TILE_SIZE, ty * UI_VIEW_IMG_TILE_SIZE, width, height);
+
+    key = (gint64)level << 48 | (gint64)ty << 24 | tx;
+    tile = g_hash_table_lookup(ui_img->tiles, &key);
+    if (tile)
+    {
+        /* Most recently used tiles are kept at the head */
+        g_queue_remove(&ui_img->lru, tile);
+        g_queue_push_head(&ui_img->lru, tile);
+        return cairo_surface_reference(tile->surface);
+    }
+
+    factor_x = ui_img->level_width[level] / (gdouble)ui_img->level_width[0];
+    factor_y = ui_img->level_height[level] / (gdouble)ui_img->level_height[0];
+
+    tile = g_malloc(sizeof(struct ui_view_img_tile));
+    tile->key = key;
+    tile->surface = cairo_surface_create_similar_image(other,
+                                                       overlayaz_image_get_has_alpha(image) ? CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24,
+                                                       width, height);
+    cairo_surface_flush(tile->surface);
+
+    /* Every quarter of the tile is halved from a tile of the previous level */
+    for (cy = 0; cy < 2; cy++)
+    {
+        for (cx = 0; cx < 2; cx++)
+        {
+            if ((2 * tx + cx) * UI_VIEW_IMG_TILE_SIZE >= ui_img->level_width[level - 1] ||
+                (2 * ty + cy) * UI_VIEW_IMG_TILE_SIZE >= ui_img->level_height[level - 1])
+                continue;
+
+            child = ui_view_img_cache_tile(ui_img, other, level - 1, 2 * tx + cx, 2 * ty + cy);
+            cairo_surface_flush(child);
+            overlayaz_pixel_halve(cairo_image_surface_get_data(child),
+                                  cairo_image_surface_get_stride(child),
+                                  cairo_image_surface_get_width(child),
+                                  cairo_image_surface_get_height(child),
+                                  cairo_image_surface_get_data(tile->surface) +
+                                  (gsize)cy * UI_VIEW_IMG_TILE_SIZE / 2 * cairo_image_surface_get_stride(tile->surface) +
+                                  (gsize)cx * UI_VIEW_IMG_TILE_SIZE / 2 * 4,
+                                  cairo_image_surface_get_stride(tile->surface));
+            cairo_surface_destroy(child);
+        }
+    }
+
+    cairo_surface_mark_dirty(tile->surface);
+
+    /* Every tile keeps the image scale in user space through its device scale.
+       Tiles hold image pixels only, a HiDPI target scales them when painting. */
+    cairo_surface_set_device_scale(tile->surface, factor_x, factor_y);
+
+    g_hash_table_insert(ui_img->tiles, &tile->key, tile);
+    g_queue_push_head(&ui_img->lru, tile);
+
+    /* The returned tiles are referenced, so an evicted one stays valid until it is painted */
+    while (g_queue_get_length(&ui_img->lru) > UI_VIEW_IMG_TILE_CACHE)
+        g_hash_table_remove(ui_img->tiles, &((struct ui_view_img_tile*)g_queue_pop_tail(&ui_img->lru))->key);
+
+    return cairo_surface_reference(tile->surface);
+}
+
+static void
+ui_view_img_cache_free(overlayaz_ui_view_img_t *ui_img)
+{
+    g_queue_clear(&ui_img->lru);
+    g_hash_table_remove_all(ui_img->tiles);
+    ui_img->levels = 0;
+}
+
+static void
+ui_view_img_cache_tile_free(gpointer data)
+{
+    struct ui_view_img_tile *tile = (struct ui_view_img_tile*)data;
+
+    cairo_surface_destroy(tile->surface);
+    g_free(tile);
+}
+
+static void
+ui_view_img_overlay_draw(overlayaz_ui_view_img_t *ui_img,
+                         cairo_t                 *cr,
+                         gint                     widget_width,
+                         gint                     widget_height)
+{
+    gdouble view_x = ui_img->offset_x * ui_img->scale;
+    gdouble view_y = ui_img->offset_y * ui_img->scale;
+    gdouble shift_x, shift_y;
+    cairo_t *cr_overlay;
+
+    if (ui_img->overlay &&
+        ui_img->damage &&
+        ui_img->damage_revision == overlayaz_get_revision(ui_img->o) &&
+        ui_img->overlay_scale == ui_img->scale)
+        ui_view_img_overlay_repair(ui_img);
+
+    if (ui_img->overlay)
+    {
+        shift_x = ui_img->overlay_x - view_x;
+        shift_y = ui_img->overlay_y - view_y;
+
+        /* Reuse the overlay only if it covers the viewport and is still aligned to the pixel grid */
+        if (ui_img->overlay_revision != overlayaz_get_revision(ui_img->o) ||
+            ui_img->overlay_scale != ui_img->scale ||
+            shift_x > 0.0 || shift_x + ui_img->overlay_width < widget_width ||
+            shift_y > 0.0 || shift_y + ui_img->overlay_height < widget_height ||
+            fabs(shift_x - round(shift_x)) > 1e-6 ||
+            fabs(shift_y - round(shift_y)) > 1e-6)
+            overlayaz_ui_view_img_invalidate(ui_img);
+    }
+
+    if (ui_img->overlay == NULL)
+    {
+        ui_img->overlay_revision = overlayaz_get_revision(ui_img->o);
+        ui_img->overlay_scale = ui_img->scale;
+        ui_img->overlay_x = view_x - UI_VIEW_IMG_OVERLAY_MARGIN;
+        ui_img->overlay_y = view_y - UI_VIEW_IMG_OVERLAY_MARGIN;
+        ui_img->overlay_width = widget_width + 2 * UI_VIEW_IMG_OVERLAY_MARGIN;
+        ui_img->overlay_height = widget_height + 2 * UI_VIEW_IMG_OVERLAY_MARGIN;
+        ui_img->overlay = cairo_surface_create_similar(cairo_get_target(cr), CAIRO_CONTENT_COLOR_ALPHA,
+                                                       ui_img->overlay_width, ui_img->overlay_height);
+
+        cr_overlay = cairo_create(ui_img->overlay);
+        cairo_translate(cr_overlay, -ui_img->overlay_x, -ui_img->overlay_y);
+        cairo_scale(cr_overlay, ui_img->scale, ui_img->scale);
+        overlayaz_draw_overlay(cr_overlay, ui_img->o, FALSE);
+        cairo_destroy(cr_overlay);
+    }
+
+    cairo_set_source_surface(cr, ui_img->overlay,
+                             round(ui_img->overlay_x - view_x),
+                             round(ui_img->overlay_y - view_y));
+    cairo_paint(cr);
+}
+
+static void
+ui_view_img_overlay_repair(overlayaz_ui_view_img_t *ui_img)
+{
+    cairo_rectangle_int_t rect;
     cairo_t *cr;
+    gint i;
 
-    surface = cairo_surface_create_similar(other,
-                                           cairo_surface_get_content(other),
-                                           overlayaz_get_width(ui_img->o),
-                                           overlayaz_get_height(ui_img->o));
+    cr = cairo_create(ui_img->overlay);
+    cairo_translate(cr, -ui_img->overlay_x, -ui_img->overlay_y);
+    cairo_scale(cr, ui_img->scale, ui_img->scale);
 
-    cr = cairo_create(surface);
-    gdk_cairo_set_source_pixbuf(cr, overlayaz_get_pixbuf(ui_img->o), 0, 0);
-    cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_FAST);
+    for (i = 0; i < cairo_region_num_rectangles(ui_img->damage); i++)
+    {
+        cairo_region_get_rectangle(ui_img->damage, i, &rect);
+        cairo_rectangle(cr,
+                        rect.x - 1.0 / ui_img->scale,
+                        rect.y - 1.0 / ui_img->scale,
+                        rect.width + 2.0 / ui_img->scale,
+                        rect.height + 2.0 / ui_img->scale);
+    }
+
+    /* Everything within the damaged area is drawn again over a cleared background */
+    cairo_clip(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
     cairo_paint(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+    overlayaz_draw_overlay(cr, ui_img->o, FALSE);
     cairo_destroy(cr);
-    return surface;
+
+    ui_img->overlay_revision = ui_img->damage_revision;
+    cairo_region_destroy(ui_img->damage);
+    ui_img->damage = NULL;
+}
+
+static void
+ui_view_img_preview_draw(overlayaz_ui_view_img_t *ui_img,
+                         cairo_t                 *cr,
+                         gint                     widget_width,
+                         gint                     widget_height)
+{
+    gint width = cairo_image_surface_get_width(ui_img->preview);
+    gint height = cairo_image_surface_get_height(ui_img->preview);
+    gdouble scale = MIN(widget_width / (gdouble)width, widget_height / (gdouble)height);
+
+    /* The preview is only fitted to the viewport until the full image is decoded */
+    cairo_save(cr);
+    cairo_translate(cr, (widget_width - width * scale) / 2.0, (widget_height - height * scale) / 2.0);
+    cairo_scale(cr, scale, scale);
+    cairo_set_source_surface(cr, ui_img->preview, 0, 0);
+    cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_GOOD);
+    cairo_paint(cr);
+    cairo_restore(cr);
 }
 
 static void
@@ -388,10 +824,18 @@ ui_view_img_measure(overlayaz_ui_view_img_t *ui_img,
                     gdouble                  y)
 {
     gdouble angle;
+    gdouble distance;
 
-    overlayaz_get_angle(ui_img->o, OVERLAYAZ_REF_AZ, x / ui_img->scale + ui_img->offset_x, &angle);
+    x = x / ui_img->scale + ui_img->offset_x;
+    y = y / ui_img->scale + ui_img->offset_y;
+
+    overlayaz_get_angle(ui_img->o, OVERLAYAZ_REF_AZ, x, &angle);
     overlayaz_ui_show_azimuth(ui_img->ui, angle);
 
-    overlayaz_get_angle(ui_img->o, OVERLAYAZ_REF_EL, y / ui_img->scale + ui_img->offset_y, &angle);
+    overlayaz_get_angle(ui_img->o, OVERLAYAZ_REF_EL, y, &angle);
     overlayaz_ui_show_elevation(ui_img->ui, angle);
+
+    /* The distance map is computed in the background on first use */
+    overlayaz_depth_get(ui_img->o, x, y, &distance);
+    overlayaz_ui_show_terrain(ui_img->ui, distance);
 }
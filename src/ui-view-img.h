@@ -22,6 +22,11 @@ overlayaz_ui_view_img_t* overlayaz_ui_view_img_new(overlayaz_ui_t*, GtkWidget*,
 void overlayaz_ui_view_img_free(overlayaz_ui_view_img_t*);
 void overlayaz_ui_view_img_sync(overlayaz_ui_view_img_t*, gboolean);
 void overlayaz_ui_view_img_update(overlayaz_ui_view_img_t*);
+void overlayaz_ui_view_img_update_area(overlayaz_ui_view_img_t*, guint, const cairo_region_t*);
+void overlayaz_ui_view_img_update_refs(overlayaz_ui_view_img_t*);
+void overlayaz_ui_view_img_update_terrain(overlayaz_ui_view_img_t*);
+void overlayaz_ui_view_img_invalidate(overlayaz_ui_view_img_t*);
+void overlayaz_ui_view_img_set_preview(overlayaz_ui_view_img_t*, const GdkPixbuf*);
 void overlayaz_ui_view_img_zoom_fit(overlayaz_ui_view_img_t*);
 void overlayaz_ui_view_img_zoom_in(overlayaz_ui_view_img_t*);
 
@@ -21,7 +21,6 @@
 #include "icon.h"
 #include "geo.h"
 #include "conf.h"
-#include "marker-iter.h"
 #include "util.h"
 #include "ui-util.h"
 
@@ -247,52 +246,45 @@ static void
 ui_view_map_update_markers(overlayaz_ui_view_map_t *ui_map)
 {
     struct overlayaz_location home;
-    overlayaz_marker_iter_t *iter;
-    const overlayaz_marker_t *m;
-    gdouble angle, dist;
+    struct overlayaz_marker_arrays markers;
+    gint selected = overlayaz_ui_get_marker_id(ui_map->ui) - 1;
     OsmGpsMapImage *image;
-    gint pixbuf_id;
+    gint id, pixbuf_id;
 
     if (!overlayaz_get_location(ui_map->o, &home))
         return;
 
-    iter = overlayaz_marker_iter_new(overlayaz_get_marker_list(ui_map->o), &m);
-    if (iter == NULL)
-        return;
-
-    do
+    overlayaz_marker_store_get_arrays(overlayaz_get_marker_store(ui_map->o), &markers);
+    for (id = 0; id < markers.count; id++)
     {
-        if (overlayaz_marker_get_active(m))
+        if (!(markers.flags[id] & OVERLAYAZ_MARKER_ACTIVE) ||
+            isnan(markers.azimuth[id]))
+            continue;
+
+        pixbuf_id = id + 1;
+        if (pixbuf_id >= UI_VIEW_MAP_MARKER_CACHE)
+            pixbuf_id = 0;
+
+        if (!ui_map->pixbuf_marker[pixbuf_id])
+            ui_map->pixbuf_marker[pixbuf_id] = overlayaz_icon_marker(UI_VIEW_MAP_ICON_SIZE, pixbuf_id);
+
+        image = osm_gps_map_image_add_with_alignment(ui_map->map,
+                                                     (gfloat)markers.latitude[id],
+                                                     (gfloat)markers.longitude[id],
+                                                     ui_map->pixbuf_marker[pixbuf_id],
+                                                     0.5f, 1.0f);
+        ui_map->img_marker = g_slist_prepend(ui_map->img_marker, image);
+
+        /* Draw path only for selected and valid marker (within image bounds) */
+        if (id == selected &&
+            overlayaz_get_position(ui_map->o, OVERLAYAZ_REF_AZ, markers.azimuth[id], NULL))
         {
-            overlayaz_geo_inverse(home.latitude, home.longitude,
-                                  overlayaz_marker_get_latitude(m),
-                                  overlayaz_marker_get_longitude(m),
-                                  &angle, NULL, &dist);
-
-            pixbuf_id = overlayaz_marker_iter_get_id(iter);
-            if (pixbuf_id >= UI_VIEW_MAP_MARKER_CACHE)
-                pixbuf_id = 0;
-
-            if (!ui_map->pixbuf_marker[pixbuf_id])
-                ui_map->pixbuf_marker[pixbuf_id] = overlayaz_icon_marker(UI_VIEW_MAP_ICON_SIZE, pixbuf_id);
-
-            image = osm_gps_map_image_add_with_alignment(ui_map->map,
-                                                         (gfloat)overlayaz_marker_get_latitude(m),
-                                                         (gfloat)overlayaz_marker_get_longitude(m),
-                                                         ui_map->pixbuf_marker[pixbuf_id],
-                                                         0.5f, 1.0f);
-            ui_map->img_marker = g_slist_append(ui_map->img_marker, image);
-
-            /* Draw path only for selected and valid marker (within image bounds) */
-            if (overlayaz_ui_get_marker_id(ui_map->ui) == overlayaz_marker_iter_get_id(iter) &&
-                overlayaz_get_position(ui_map->o, OVERLAYAZ_REF_AZ, angle, NULL))
-            {
-                ui_map->track_marker = ui_view_map_track_new(home.latitude, home.longitude, angle, dist, &color_marker);
-                osm_gps_map_track_add(ui_map->map, ui_map->track_marker);
-            }
+            ui_map->track_marker = ui_view_map_track_new(home.latitude, home.longitude,
+                                                         markers.azimuth[id], markers.distance[id],
+                                                         &color_marker);
+            osm_gps_map_track_add(ui_map->map, ui_map->track_marker);
         }
-    } while (overlayaz_marker_iter_next(iter, &m));
-    overlayaz_marker_iter_free(iter);
+    }
 }
 
 static void
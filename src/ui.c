@@ -29,11 +29,13 @@
 #include "export.h"
 #include "file.h"
 #include "profile.h"
-#include "marker-list.h"
 #include "ui-util.h"
 #include "geo.h"
 #include "dialog-info.h"
 #include "dialog-about.h"
+#include "depth.h"
+#include "viewshed.h"
+#include "horizon.h"
 
 struct overlayaz_ui
 {
@@ -46,11 +48,14 @@ struct overlayaz_ui
     overlayaz_ui_view_map_t *map;
     gboolean lock;
     gboolean queue_map_update;
+    GCancellable *loading;
 };
 
 static void ui_sync(overlayaz_ui_t*, gboolean);
 
 static void ui_file_chooser_set(GtkFileChooserButton*, overlayaz_ui_t*);
+static void ui_file_load_ready(GObject*, GAsyncResult*, gpointer);
+static void ui_file_load_cancel(overlayaz_ui_t*);
 static void ui_menu_page_switched(GtkNotebook*, GtkWidget*, guint, overlayaz_ui_t*);
 static void ui_button_save_clicked(GtkButton*, overlayaz_ui_t*);
 static void ui_button_export_clicked(GtkButton*, overlayaz_ui_t*);
@@ -63,6 +68,8 @@ static void ui_button_rotation_reset_clicked(GtkButton*, overlayaz_ui_t*);
 static gboolean ui_key_press(GtkWidget*, GdkEventKey*, overlayaz_ui_t*);
 static gboolean ui_delete_event(GtkWidget*, GdkEvent*, overlayaz_ui_t*);
 static void ui_destroy(GtkWidget*, overlayaz_ui_t*);
+static void ui_terrain_ready(gpointer);
+static void ui_depth_ready(gpointer);
 static void ui_drag_data_received(GtkWidget*, GdkDragContext*, gint, gint, GtkSelectionData*, guint, guint, overlayaz_ui_t*);
 
 static void ui_add_marker(overlayaz_ui_t*, gdouble, gdouble, gdouble);
@@ -105,6 +112,11 @@ overlayaz_ui(overlayaz_t *o)
     gtk_drag_dest_set(ui->w.window, GTK_DEST_DEFAULT_ALL, drop_types, n_drop_types, GDK_ACTION_COPY);
     g_signal_connect(ui->w.window, "drag-data-received", G_CALLBACK(ui_drag_data_received), ui);
 
+    /* Terrain results are computed in the background */
+    overlayaz_viewshed_set_notify(ui_terrain_ready, ui);
+    overlayaz_horizon_set_notify(ui_terrain_ready, ui);
+    overlayaz_depth_set_notify(ui_depth_ready, ui);
+
     path = overlayaz_conf_get_open_path();
     if (path && strlen(path))
         gtk_file_chooser_set_current_folder(GTK_FILE_CHOOSER(ui->w.file_chooser), path);
@@ -126,10 +138,18 @@ overlayaz_ui_update_view(overlayaz_ui_t                *ui,
 {
     gint current_view = overlayaz_ui_get_view(ui);
 
+    /* The overlay also depends on the configuration, not just the profile */
+    if (mode & OVERLAYAZ_UI_UPDATE_OVERLAY)
+        overlayaz_ui_view_img_invalidate(ui->img);
+
     if (mode & OVERLAYAZ_UI_UPDATE_IMAGE)
         if (current_view == OVERLAYAZ_WINDOW_VIEW_IMAGE)
             gtk_widget_queue_draw(ui->w.image);
 
+    if (mode & OVERLAYAZ_UI_UPDATE_REFS)
+        if (current_view == OVERLAYAZ_WINDOW_VIEW_IMAGE)
+            overlayaz_ui_view_img_update_refs(ui->img);
+
     if (mode & OVERLAYAZ_UI_UPDATE_MAP)
     {
         if (current_view == OVERLAYAZ_WINDOW_VIEW_MAP)
@@ -139,6 +159,15 @@ overlayaz_ui_update_view(overlayaz_ui_t                *ui,
     }
 }
 
+void
+overlayaz_ui_update_image_area(overlayaz_ui_t       *ui,
+                               guint                 revision,
+                               const cairo_region_t *area)
+{
+    /* The damage is tracked even if the image is not visible */
+    overlayaz_ui_view_img_update_area(ui->img, revision, area);
+}
+
 void
 overlayaz_ui_set_menu(overlayaz_ui_t              *ui,
                       enum overlayaz_window_menu   id)
@@ -192,6 +221,15 @@ overlayaz_ui_show_distance(overlayaz_ui_t *ui,
     g_free(text);
 }
 
+void
+overlayaz_ui_show_terrain(overlayaz_ui_t *ui,
+                          gdouble         value)
+{
+    gchar *text = overlayaz_ui_util_format_distance(value);
+    ui_set_label_value(GTK_LABEL(ui->w.label_meas_third_value), text);
+    g_free(text);
+}
+
 gboolean
 overlayaz_ui_get_ref(const overlayaz_ui_t    *ui,
                      enum overlayaz_ref_type *ref_type,
@@ -225,7 +263,7 @@ overlayaz_ui_action_position(overlayaz_ui_t           *ui,
     gdouble longitude = NAN;
     gdouble azimuth = NAN;
     gdouble elevation = NAN;
-    gdouble distance;
+    gdouble distance = NAN;
 
     if (action == OVERLAYAZ_UI_ACTION_SET)
     {
@@ -258,9 +296,17 @@ overlayaz_ui_action_position(overlayaz_ui_t           *ui,
         {
             overlayaz_get_angle(ui->o, OVERLAYAZ_REF_AZ, pos_x, &azimuth);
             overlayaz_get_angle(ui->o, OVERLAYAZ_REF_EL, pos_y, &elevation);
+
+            /* Show the terrain point under the cursor, if the distance map is ready */
+            if (overlayaz_depth_get(ui->o, pos_x, pos_y, &distance) == OVERLAYAZ_DEPTH_READY &&
+                !isnan(distance))
+            {
+                overlayaz_geo_direct(home.latitude, home.longitude, azimuth,
+                                     distance, &latitude, &longitude);
+            }
         }
 
-        overlayaz_dialog_info(overlayaz_ui_get_parent(ui), pos_x, pos_y, latitude, longitude, azimuth, elevation, NAN);
+        overlayaz_dialog_info(overlayaz_ui_get_parent(ui), pos_x, pos_y, latitude, longitude, azimuth, elevation, distance);
     }
 }
 
@@ -375,7 +421,7 @@ static void
 ui_file_chooser_set(GtkFileChooserButton *widget,
                     overlayaz_ui_t       *ui)
 {
-    enum overlayaz_file_load_error error;
+    GdkPixbuf *preview;
     gchar *filename;
     gchar *path;
 
@@ -385,6 +431,7 @@ ui_file_chooser_set(GtkFileChooserButton *widget,
     filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(widget));
     if (filename == NULL)
     {
+        ui_file_load_cancel(ui);
         overlayaz_reset(ui->o);
         ui_sync(ui, FALSE);
         return;
@@ -413,20 +460,63 @@ ui_file_chooser_set(GtkFileChooserButton *widget,
         }
     }
 
-    error = overlayaz_file_load(ui->o, filename);
+    /* The preview is shown until the image is decoded, the profile is already there */
+    ui_file_load_cancel(ui);
+    preview = overlayaz_file_load_preview(filename);
+    overlayaz_ui_view_img_set_preview(ui->img, preview);
+    if (preview)
+        g_object_unref(preview);
+
+    ui->loading = g_cancellable_new();
+    overlayaz_file_load_async(ui->o, filename, ui->loading, ui_file_load_ready, ui);
 
     /* Sync UI with the model */
     ui_sync(ui, FALSE);
 
-    if (error != OVERLAYAZ_FILE_LOAD_OK)
-        overlayaz_dialog(overlayaz_ui_get_parent(ui), GTK_MESSAGE_ERROR, OVERLAYAZ_NAME, overlayaz_file_load_error(error));
-
     path = g_path_get_dirname(filename);
     overlayaz_conf_set_open_path(path);
     g_free(path);
     g_free(filename);
 }
 
+static void
+ui_file_load_ready(GObject      *source_object,
+                   GAsyncResult *result,
+                   gpointer      user_data)
+{
+    overlayaz_ui_t *ui = (overlayaz_ui_t*)user_data;
+    enum overlayaz_file_load_error error;
+
+    error = overlayaz_file_load_finish(result);
+    if (error == OVERLAYAZ_FILE_LOAD_ERROR_CANCELLED)
+    {
+        /* Another file was chosen or the window is already gone */
+        return;
+    }
+
+    g_clear_object(&ui->loading);
+    overlayaz_ui_view_img_set_preview(ui->img, NULL);
+
+    /* Sync UI with the model */
+    ui_sync(ui, FALSE);
+
+    if (error != OVERLAYAZ_FILE_LOAD_OK)
+        overlayaz_dialog(overlayaz_ui_get_parent(ui), GTK_MESSAGE_ERROR, OVERLAYAZ_NAME, overlayaz_file_load_error(error));
+}
+
+static void
+ui_file_load_cancel(overlayaz_ui_t *ui)
+{
+    if (ui->loading == NULL)
+        return;
+
+    /* The profile of the cancelled file does not stay without its image */
+    g_cancellable_cancel(ui->loading);
+    g_clear_object(&ui->loading);
+    overlayaz_reset(ui->o);
+    overlayaz_ui_view_img_set_preview(ui->img, NULL);
+}
+
 static void
 ui_menu_page_switched(GtkNotebook    *notebook,
                       GtkWidget      *page,
@@ -436,7 +526,7 @@ ui_menu_page_switched(GtkNotebook    *notebook,
     if (page_num != OVERLAYAZ_WINDOW_MENU_REF)
     {
         overlayaz_ui_menu_ref_none(ui->r);
-        overlayaz_ui_update_view(ui, OVERLAYAZ_UI_UPDATE_IMAGE);
+        overlayaz_ui_update_view(ui, OVERLAYAZ_UI_UPDATE_REFS);
     }
 }
 
@@ -485,12 +575,13 @@ ui_button_export_clicked(GtkButton      *button,
 {
     overlayaz_dialog_export_t *e = overlayaz_dialog_export(overlayaz_ui_get_parent(ui));
 
-    if (overlayaz_dialog_export_get_filename(e))
+    if (overlayaz_dialog_export_get_filename(e) &&
+        !overlayaz_export(ui->o,
+                          overlayaz_dialog_export_get_filename(e),
+                          overlayaz_dialog_export_get_filter(e),
+                          overlayaz_dialog_export_get_quality(e)))
     {
-        overlayaz_export(ui->o,
-                         overlayaz_dialog_export_get_filename(e),
-                         overlayaz_dialog_export_get_filter(e),
-                         overlayaz_dialog_export_get_quality(e));
+        overlayaz_dialog(overlayaz_ui_get_parent(ui), GTK_MESSAGE_ERROR, "Export", "Failed to export the image");
     }
 
     overlayaz_dialog_export_free(e);
@@ -519,10 +610,14 @@ ui_view_page_switched(GtkNotebook    *notebook,
     if (page_num == OVERLAYAZ_WINDOW_VIEW_IMAGE)
     {
         gtk_label_set_text(GTK_LABEL(ui->w.label_meas_second), "Elevation:");
+        gtk_widget_show(ui->w.label_meas_third);
+        gtk_widget_show(ui->w.label_meas_third_value);
     }
     else
     {
         gtk_label_set_text(GTK_LABEL(ui->w.label_meas_second), "Distance:");
+        gtk_widget_hide(ui->w.label_meas_third);
+        gtk_widget_hide(ui->w.label_meas_third_value);
         if (ui->queue_map_update)
         {
             overlayaz_ui_view_map_update(ui->map);
@@ -625,6 +720,15 @@ static void
 ui_destroy(GtkWidget      *widget,
            overlayaz_ui_t *ui)
 {
+    if (ui->loading)
+    {
+        g_cancellable_cancel(ui->loading);
+        g_object_unref(ui->loading);
+    }
+
+    overlayaz_viewshed_set_notify(NULL, NULL);
+    overlayaz_horizon_set_notify(NULL, NULL);
+    overlayaz_depth_set_notify(NULL, NULL);
     overlayaz_ui_menu_ref_free(ui->r);
     overlayaz_ui_menu_grid_free(ui->g);
     overlayaz_ui_menu_marker_free(ui->m);
@@ -634,6 +738,20 @@ ui_destroy(GtkWidget      *widget,
     gtk_main_quit();
 }
 
+static void
+ui_terrain_ready(gpointer user_data)
+{
+    overlayaz_ui_t *ui = (overlayaz_ui_t*)user_data;
+    overlayaz_ui_update_view(ui, OVERLAYAZ_UI_UPDATE_OVERLAY | OVERLAYAZ_UI_UPDATE_IMAGE);
+}
+
+static void
+ui_depth_ready(gpointer user_data)
+{
+    overlayaz_ui_t *ui = (overlayaz_ui_t*)user_data;
+    overlayaz_ui_view_img_update_terrain(ui->img);
+}
+
 static void
 ui_drag_data_received(GtkWidget        *widget,
                       GdkDragContext   *context,
@@ -674,34 +792,29 @@ ui_add_marker(overlayaz_ui_t *ui,
               gdouble         lon,
               gdouble         pos_y)
 {
+    overlayaz_marker_store_t *markers = overlayaz_get_marker_store(ui->o);
+    gint curr = overlayaz_ui_menu_marker_get_id(ui->m) - 1;
+    gint id;
 
-    GtkListStore *ml = overlayaz_get_marker_list(ui->o);
-    gint count = overlayaz_marker_list_count(ml);
-    const overlayaz_marker_t *m_curr = overlayaz_ui_menu_marker_get_current(ui->m);
-    overlayaz_marker_t *m;
-
-    m = overlayaz_marker_new();
-    overlayaz_marker_set_latitude(m, lat);
-    overlayaz_marker_set_longitude(m, lon);
+    id = overlayaz_marker_store_add(markers);
+    overlayaz_marker_store_set_latitude(markers, id, lat);
+    overlayaz_marker_store_set_longitude(markers, id, lon);
 
     if (!isnan(pos_y))
-        overlayaz_marker_set_position(m, pos_y / (gdouble)overlayaz_get_height(ui->o) * 100.0);
-    else if (m_curr)
-        overlayaz_marker_set_position(m, overlayaz_marker_get_position(m_curr));
+        overlayaz_marker_store_set_position(markers, id, pos_y / (gdouble)overlayaz_get_height(ui->o) * 100.0);
+    else if (curr >= 0)
+        overlayaz_marker_store_set_position(markers, id, overlayaz_marker_store_get_position(markers, curr));
 
-    if (m_curr)
+    if (curr >= 0)
     {
-        overlayaz_marker_set_tick(m, overlayaz_marker_get_tick(m_curr));
-        overlayaz_marker_set_font(m, overlayaz_font_get(overlayaz_marker_get_font(m_curr)));
-        overlayaz_marker_set_font_color_rgba(m, overlayaz_marker_get_font_color(m_curr));
-        overlayaz_marker_set_show_azimuth(m, overlayaz_marker_get_show_azimuth(m_curr));
-        overlayaz_marker_set_show_distance(m, overlayaz_marker_get_show_distance(m_curr));
+        overlayaz_marker_store_set_tick(markers, id, overlayaz_marker_store_get_tick(markers, curr));
+        overlayaz_marker_store_set_style(markers, id, overlayaz_marker_store_get_style(markers, curr));
+        overlayaz_marker_store_set_show_azimuth(markers, id, overlayaz_marker_store_get_show_azimuth(markers, curr));
+        overlayaz_marker_store_set_show_distance(markers, id, overlayaz_marker_store_get_show_distance(markers, curr));
     }
 
-    overlayaz_marker_list_add(overlayaz_get_marker_list(ui->o), m);
-
     overlayaz_ui_set_menu(ui, OVERLAYAZ_WINDOW_MENU_MARKER);
-    overlayaz_ui_menu_marker_set_id(ui->m, count + 1);
+    overlayaz_ui_menu_marker_set_id(ui->m, id + 1);
     overlayaz_ui_update_view(ui, OVERLAYAZ_UI_UPDATE_IMAGE | OVERLAYAZ_UI_UPDATE_MAP);
 }
 
@@ -20,8 +20,10 @@
 
 enum overlayaz_ui_update_mask
 {
-    OVERLAYAZ_UI_UPDATE_IMAGE = 1 << 0,
-    OVERLAYAZ_UI_UPDATE_MAP   = 1 << 1
+    OVERLAYAZ_UI_UPDATE_IMAGE   = 1 << 0,
+    OVERLAYAZ_UI_UPDATE_MAP     = 1 << 1,
+    OVERLAYAZ_UI_UPDATE_OVERLAY = 1 << 2,
+    OVERLAYAZ_UI_UPDATE_REFS    = 1 << 3
 };
 
 enum overlayaz_ui_action
@@ -36,6 +38,7 @@ void overlayaz_ui(overlayaz_t*);
 GtkWindow* overlayaz_ui_get_parent(overlayaz_ui_t*);
 
 void overlayaz_ui_update_view(overlayaz_ui_t*, enum overlayaz_ui_update_mask);
+void overlayaz_ui_update_image_area(overlayaz_ui_t*, guint, const cairo_region_t*);
 
 void overlayaz_ui_set_menu(overlayaz_ui_t*, enum overlayaz_window_menu);
 enum overlayaz_window_menu overlayaz_ui_get_menu(overlayaz_ui_t *ui);
@@ -45,6 +48,7 @@ enum overlayaz_window_view overlayaz_ui_get_view(overlayaz_ui_t *ui);
 void overlayaz_ui_show_azimuth(overlayaz_ui_t*, gdouble);
 void overlayaz_ui_show_elevation(overlayaz_ui_t*, gdouble);
 void overlayaz_ui_show_distance(overlayaz_ui_t*, gdouble);
+void overlayaz_ui_show_terrain(overlayaz_ui_t*, gdouble);
 
 gboolean overlayaz_ui_get_ref(const overlayaz_ui_t*, enum overlayaz_ref_type*, enum overlayaz_ref_id*);
 gint overlayaz_ui_get_marker_id(overlayaz_ui_t*);
@@ -0,0 +1,432 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+#include "viewshed.h"
+#include "srtm.h"
+#include "geo.h"
+#include "terrain-queue.h"
+
+#define VIEWSHED_EARTH_RADIUS 6371000.0
+#define VIEWSHED_REFRACTION   0.13
+#define VIEWSHED_EYE_HEIGHT   1.7
+#define VIEWSHED_ANCHOR       2000.0
+#define VIEWSHED_TARGET_GAP   150.0
+#define VIEWSHED_CHUNK        256
+#define VIEWSHED_CACHE_MAX    4096
+
+struct viewshed_key
+{
+    gdouble home_lat;
+    gdouble home_lon;
+    gdouble home_alt;
+    gdouble lat;
+    gdouble lon;
+};
+
+struct viewshed_job
+{
+    gchar *directory;
+    struct viewshed_key key;
+    guint generation;
+};
+
+/* Results are traced in the background,
+   keys that are still being traced are kept in the queued set */
+struct viewshed_cache
+{
+    struct overlayaz_terrain_queue queue;
+    gchar *directory;
+    GHashTable *results;
+    GHashTable *queued;
+};
+
+static struct viewshed_cache cache;
+
+static void viewshed_worker(gpointer, gpointer);
+static void viewshed_trace(overlayaz_srtm_sampler_t*, const struct viewshed_key*, struct overlayaz_viewshed*);
+static gdouble viewshed_slope(gdouble, gdouble, gdouble);
+static gboolean viewshed_skip(overlayaz_srtm_sampler_t*, const gdouble*, const gdouble*, gdouble, gdouble, gdouble, gdouble);
+static guint viewshed_key_hash(gconstpointer);
+static gboolean viewshed_key_equal(gconstpointer, gconstpointer);
+
+
+void
+overlayaz_viewshed_check(const gchar                     *directory,
+                         const struct overlayaz_location *home,
+                         const gdouble                   *latitude,
+                         const gdouble                   *longitude,
+                         gint                             count,
+                         gboolean                         wait,
+                         struct overlayaz_viewshed       *out)
+{
+    struct viewshed_job *job;
+    struct viewshed_key key, *new_key;
+    const struct overlayaz_viewshed *cached;
+    guint generation;
+    gint i;
+
+    for (i = 0; i < count; i++)
+    {
+        out[i].state = OVERLAYAZ_VIEWSHED_UNKNOWN;
+        out[i].clearance = 0.0;
+    }
+
+    if (directory == NULL || count <= 0)
+        return;
+
+    overlayaz_terrain_queue_lock(&cache.queue);
+
+    if (cache.results == NULL)
+    {
+        cache.results = g_hash_table_new_full(viewshed_key_hash, viewshed_key_equal, g_free, g_free);
+        cache.queued = g_hash_table_new_full(viewshed_key_hash, viewshed_key_equal, g_free, NULL);
+    }
+
+    if (g_strcmp0(cache.directory, directory) != 0 ||
+        g_hash_table_size(cache.results) > VIEWSHED_CACHE_MAX)
+    {
+        g_hash_table_remove_all(cache.results);
+        g_hash_table_remove_all(cache.queued);
+        g_free(cache.directory);
+        cache.directory = g_strdup(directory);
+        overlayaz_terrain_queue_reset(&cache.queue);
+    }
+
+    generation = overlayaz_terrain_queue_generation(&cache.queue);
+    for (i = 0; i < count; i++)
+    {
+        key.home_lat = home->latitude;
+        key.home_lon = home->longitude;
+        key.home_alt = home->altitude;
+        key.lat = latitude[i];
+        key.lon = longitude[i];
+
+        cached = g_hash_table_lookup(cache.results, &key);
+        if (cached)
+        {
+            out[i] = *cached;
+            continue;
+        }
+
+        if (g_hash_table_contains(cache.queued, &key))
+            continue;
+
+        new_key = g_new(struct viewshed_key, 1);
+        *new_key = key;
+        g_hash_table_add(cache.queued, new_key);
+
+        job = g_new(struct viewshed_job, 1);
+        job->directory = g_strdup(directory);
+        job->key = key;
+        job->generation = generation;
+        overlayaz_terrain_queue_push(&cache.queue, viewshed_worker, job);
+    }
+
+    for (i = 0; wait && i < count; i++)
+    {
+        key.home_lat = home->latitude;
+        key.home_lon = home->longitude;
+        key.home_alt = home->altitude;
+        key.lat = latitude[i];
+        key.lon = longitude[i];
+
+        while (!(cached = g_hash_table_lookup(cache.results, &key)))
+            if (!overlayaz_terrain_queue_wait(&cache.queue, generation))
+                break;
+
+        if (cached)
+            out[i] = *cached;
+    }
+
+    overlayaz_terrain_queue_unlock(&cache.queue);
+}
+
+void
+overlayaz_viewshed_set_notify(overlayaz_terrain_notify_t notify,
+                              gpointer                   data)
+{
+    overlayaz_terrain_queue_set_notify(&cache.queue, notify, data);
+}
+
+void
+overlayaz_viewshed_free(void)
+{
+    overlayaz_terrain_queue_free(&cache.queue);
+    if (cache.results)
+        g_hash_table_destroy(cache.results);
+    if (cache.queued)
+        g_hash_table_destroy(cache.queued);
+    g_free(cache.directory);
+
+    cache.results = NULL;
+    cache.queued = NULL;
+    cache.directory = NULL;
+}
+
+gdouble
+overlayaz_viewshed_observer(overlayaz_srtm_sampler_t        *sampler,
+                            const struct overlayaz_location *home)
+{
+    gdouble ground;
+
+    /* The observer can not be below the ground level */
+    if (overlayaz_srtm_sampler_get(sampler, home->latitude, home->longitude, &ground) == OVERLAYAZ_SRTM_OK)
+        return MAX(home->altitude, ground + VIEWSHED_EYE_HEIGHT);
+
+    return home->altitude;
+}
+
+gint
+overlayaz_viewshed_ray(overlayaz_srtm_sampler_t *sampler,
+                       gdouble                   latitude,
+                       gdouble                   longitude,
+                       gdouble                   observer,
+                       gdouble                   azimuth,
+                       gdouble                   distance,
+                       gdouble                  *profile,
+                       gdouble                  *max_slope)
+{
+    gdouble lat[VIEWSHED_CHUNK];
+    gdouble lon[VIEWSHED_CHUNK];
+    gdouble dist[VIEWSHED_CHUNK];
+    gdouble height[VIEWSHED_CHUNK];
+    enum overlayaz_srtm_error errors[VIEWSHED_CHUNK];
+    gdouble anchor_lat[2], anchor_lon[2];
+    gdouble anchor_dist[2];
+    gdouble d, t, slope;
+    gint samples, first, last, chunk;
+    gint missing = 0;
+    gint i, j;
+
+    samples = (gint)(distance / OVERLAYAZ_VIEWSHED_STEP);
+    *max_slope = -G_MAXDOUBLE;
+
+    /* The geodesic is evaluated exactly at sparse anchors only, sample
+       positions in between are interpolated linearly. */
+    anchor_lat[1] = latitude;
+    anchor_lon[1] = longitude;
+    anchor_dist[1] = 0.0;
+
+    for (first = 1; first <= samples; first = MAX(first, last + 1))
+    {
+        anchor_lat[0] = anchor_lat[1];
+        anchor_lon[0] = anchor_lon[1];
+        anchor_dist[0] = anchor_dist[1];
+        anchor_dist[1] = MIN(anchor_dist[1] + VIEWSHED_ANCHOR, distance);
+        overlayaz_geo_direct(latitude, longitude, azimuth, anchor_dist[1], &anchor_lat[1], &anchor_lon[1]);
+
+        last = (anchor_dist[1] < distance ? (gint)(anchor_dist[1] / OVERLAYAZ_VIEWSHED_STEP) : samples);
+        if (last < first)
+            continue;
+
+        if (viewshed_skip(sampler, anchor_lat, anchor_lon, observer,
+                          first * OVERLAYAZ_VIEWSHED_STEP, last * OVERLAYAZ_VIEWSHED_STEP, *max_slope))
+        {
+            if (profile)
+            {
+                for (i = first; i <= last; i++)
+                    profile[i-1] = -G_MAXDOUBLE;
+            }
+            continue;
+        }
+
+        for (i = first; i <= last; i += chunk)
+        {
+            chunk = MIN(VIEWSHED_CHUNK, last - i + 1);
+            for (j = 0; j < chunk; j++)
+            {
+                d = (i + j) * OVERLAYAZ_VIEWSHED_STEP;
+                t = (d - anchor_dist[0]) / (anchor_dist[1] - anchor_dist[0]);
+                lat[j] = anchor_lat[0] + (anchor_lat[1] - anchor_lat[0]) * t;
+                lon[j] = anchor_lon[0] + (anchor_lon[1] - anchor_lon[0]) * t;
+                dist[j] = d;
+            }
+
+            overlayaz_srtm_sampler_get_n(sampler, lat, lon, chunk, height, errors);
+
+            for (j = 0; j < chunk; j++)
+            {
+                if (profile)
+                    profile[i+j-1] = -G_MAXDOUBLE;
+
+                if (errors[j] == OVERLAYAZ_SRTM_ERROR_INVALID)
+                    continue;
+                if (errors[j] != OVERLAYAZ_SRTM_OK)
+                {
+                    missing++;
+                    continue;
+                }
+
+                slope = viewshed_slope(height[j], observer, dist[j]);
+                if (profile)
+                    profile[i+j-1] = slope;
+                if (slope > *max_slope)
+                    *max_slope = slope;
+            }
+        }
+    }
+
+    return missing;
+}
+
+static void
+viewshed_worker(gpointer data,
+                gpointer user_data)
+{
+    struct viewshed_job *job = (struct viewshed_job*)data;
+    overlayaz_srtm_sampler_t *sampler;
+    struct overlayaz_viewshed result;
+    struct overlayaz_viewshed *new_result;
+    struct viewshed_key *new_key;
+    gboolean stale;
+
+    overlayaz_terrain_queue_lock(&cache.queue);
+    stale = (job->generation != overlayaz_terrain_queue_generation(&cache.queue));
+    overlayaz_terrain_queue_unlock(&cache.queue);
+
+    if (!stale)
+    {
+        sampler = overlayaz_srtm_sampler_new(job->directory);
+        viewshed_trace(sampler, &job->key, &result);
+        overlayaz_srtm_sampler_free(sampler);
+    }
+
+    overlayaz_terrain_queue_lock(&cache.queue);
+    if (job->generation == overlayaz_terrain_queue_generation(&cache.queue))
+    {
+        g_hash_table_remove(cache.queued, &job->key);
+        new_key = g_new(struct viewshed_key, 1);
+        *new_key = job->key;
+        new_result = g_new(struct overlayaz_viewshed, 1);
+        *new_result = result;
+        g_hash_table_replace(cache.results, new_key, new_result);
+    }
+
+    overlayaz_terrain_queue_done(&cache.queue);
+    overlayaz_terrain_queue_unlock(&cache.queue);
+
+    g_free(job->directory);
+    g_free(job);
+}
+
+static void
+viewshed_trace(overlayaz_srtm_sampler_t  *sampler,
+               const struct viewshed_key *key,
+               struct overlayaz_viewshed *out)
+{
+    struct overlayaz_location home;
+    gdouble azimuth, distance;
+    gdouble observer, target;
+    gdouble max_slope;
+
+    out->state = OVERLAYAZ_VIEWSHED_UNKNOWN;
+    out->clearance = 0.0;
+
+    if (overlayaz_srtm_sampler_get(sampler, key->lat, key->lon, &target) != OVERLAYAZ_SRTM_OK)
+        return;
+
+    home.latitude = key->home_lat;
+    home.longitude = key->home_lon;
+    home.altitude = key->home_alt;
+    observer = overlayaz_viewshed_observer(sampler, &home);
+
+    overlayaz_geo_inverse(key->home_lat, key->home_lon, key->lat, key->lon, &azimuth, NULL, &distance);
+
+    if (distance <= 0.0)
+    {
+        out->state = OVERLAYAZ_VIEWSHED_VISIBLE;
+        out->clearance = 90.0;
+        return;
+    }
+
+    /* Terrain right next to the target belongs to the target itself */
+    if (overlayaz_viewshed_ray(sampler, key->home_lat, key->home_lon, observer, azimuth,
+                               distance - VIEWSHED_TARGET_GAP, NULL, &max_slope))
+        return;
+
+    /* With no terrain in between, the clearance is measured from the nadir */
+    out->clearance = (atan(viewshed_slope(target, observer, distance)) - atan(max_slope)) * 180.0 / G_PI;
+    out->state = (out->clearance >= 0.0 ? OVERLAYAZ_VIEWSHED_VISIBLE : OVERLAYAZ_VIEWSHED_OCCLUDED);
+}
+
+static gdouble
+viewshed_slope(gdouble height,
+               gdouble observer,
+               gdouble distance)
+{
+    /* Apparent drop of the terrain below the observer's horizontal plane */
+    const gdouble curvature = (1.0 - VIEWSHED_REFRACTION) / (2.0 * VIEWSHED_EARTH_RADIUS);
+    return (height - curvature * distance * distance - observer) / distance;
+}
+
+static gboolean
+viewshed_skip(overlayaz_srtm_sampler_t *sampler,
+              const gdouble            *latitude,
+              const gdouble            *longitude,
+              gdouble                   observer,
+              gdouble                   near,
+              gdouble                   far,
+              gdouble                   max_slope)
+{
+    const gdouble curvature = (1.0 - VIEWSHED_REFRACTION) / (2.0 * VIEWSHED_EARTH_RADIUS);
+    gdouble top;
+
+    if (max_slope == -G_MAXDOUBLE)
+        return FALSE;
+
+    /* The highest post around the segment bounds all of its samples */
+    if (overlayaz_srtm_sampler_range(sampler,
+                                     MIN(latitude[0], latitude[1]),
+                                     MIN(longitude[0], longitude[1]),
+                                     MAX(latitude[0], latitude[1]),
+                                     MAX(longitude[0], longitude[1]),
+                                     NULL, &top) != OVERLAYAZ_SRTM_OK)
+        return FALSE;
+
+    /* Upper bound of the slope anywhere between the near and the far sample */
+    top -= observer;
+    return (top / (top >= 0.0 ? near : far) - curvature * near <= max_slope);
+}
+
+static guint
+viewshed_key_hash(gconstpointer v)
+{
+    const struct viewshed_key *key = (const struct viewshed_key*)v;
+    guint hash;
+
+    hash = g_double_hash(&key->home_lat);
+    hash = hash * 31 + g_double_hash(&key->home_lon);
+    hash = hash * 31 + g_double_hash(&key->home_alt);
+    hash = hash * 31 + g_double_hash(&key->lat);
+    hash = hash * 31 + g_double_hash(&key->lon);
+    return hash;
+}
+
+static gboolean
+viewshed_key_equal(gconstpointer v1,
+                   gconstpointer v2)
+{
+    const struct viewshed_key *a = (const struct viewshed_key*)v1;
+    const struct viewshed_key *b = (const struct viewshed_key*)v2;
+
+    return (a->home_lat == b->home_lat &&
+            a->home_lon == b->home_lon &&
+            a->home_alt == b->home_alt &&
+            a->lat == b->lat &&
+            a->lon == b->lon);
+}
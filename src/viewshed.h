@@ -0,0 +1,48 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef OVERLAYAZ_VIEWSHED_H_
+#define OVERLAYAZ_VIEWSHED_H_
+#include "location.h"
+#include "srtm.h"
+#include "terrain-queue.h"
+
+/* Terrain along a ray is sampled every OVERLAYAZ_VIEWSHED_STEP metres,
+   the optional ray profile receives the slope of each of these samples.
+   Stretches that can not raise the maximum slope are skipped and
+   reported as -G_MAXDOUBLE, like voids. */
+#define OVERLAYAZ_VIEWSHED_STEP 60.0
+
+enum overlayaz_viewshed_state
+{
+    OVERLAYAZ_VIEWSHED_UNKNOWN,
+    OVERLAYAZ_VIEWSHED_VISIBLE,
+    OVERLAYAZ_VIEWSHED_OCCLUDED
+};
+
+struct overlayaz_viewshed
+{
+    enum overlayaz_viewshed_state state;
+    gdouble clearance;
+};
+
+void overlayaz_viewshed_check(const gchar*, const struct overlayaz_location*, const gdouble*, const gdouble*, gint, gboolean, struct overlayaz_viewshed*);
+void overlayaz_viewshed_set_notify(overlayaz_terrain_notify_t, gpointer);
+void overlayaz_viewshed_free(void);
+
+gdouble overlayaz_viewshed_observer(overlayaz_srtm_sampler_t*, const struct overlayaz_location*);
+gint overlayaz_viewshed_ray(overlayaz_srtm_sampler_t*, gdouble, gdouble, gdouble, gdouble, gdouble, gdouble*, gdouble*);
+
+#endif
@@ -77,12 +77,18 @@ overlayaz_window_init(struct overlayaz_window *w)
     w->label_meas_second = gtk_label_new("Elevation:");
     gtk_grid_attach(GTK_GRID(w->grid_meas), w->label_meas_second, 1, 0, 1, 1);
 
+    w->label_meas_third = gtk_label_new("Terrain:");
+    gtk_grid_attach(GTK_GRID(w->grid_meas), w->label_meas_third, 2, 0, 1, 1);
+
     w->label_meas_first_value = gtk_label_new(NULL);
     gtk_grid_attach(GTK_GRID(w->grid_meas), w->label_meas_first_value, 0, 1, 1, 1);
 
     w->label_meas_second_value = gtk_label_new(NULL);
     gtk_grid_attach(GTK_GRID(w->grid_meas), w->label_meas_second_value, 1, 1, 1, 1);
 
+    w->label_meas_third_value = gtk_label_new(NULL);
+    gtk_grid_attach(GTK_GRID(w->grid_meas), w->label_meas_third_value, 2, 1, 1, 1);
+
     w->box_bottom = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, OVERLAYAZ_WINDOW_GRID_SPACING);
     gtk_box_pack_start(GTK_BOX(w->box_menu), w->box_bottom, FALSE, FALSE, 0);
 
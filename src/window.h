@@ -88,6 +88,8 @@ struct overlayaz_window
     GtkWidget *label_meas_first_value;
     GtkWidget *label_meas_second;
     GtkWidget *label_meas_second_value;
+    GtkWidget *label_meas_third;
+    GtkWidget *label_meas_third_value;
 
     GtkWidget *box_bottom;
     GtkWidget *button_save;
@@ -0,0 +1,79 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "test-srtm-tile.h"
+
+
+guint8*
+test_srtm_tile_new(test_srtm_tile_value_t value)
+{
+    guint8 *data = g_malloc(TEST_SRTM_TILE_SIZE);
+    guint16 raw;
+    gint row, col;
+    gsize offset;
+
+    /* Rows are stored from north to south, big-endian */
+    for (row = 0; row < TEST_SRTM_TILE_GRID; row++)
+    {
+        for (col = 0; col < TEST_SRTM_TILE_GRID; col++)
+        {
+            raw = (guint16)value(row, col);
+            offset = ((gsize)(TEST_SRTM_TILE_GRID - row - 1) * TEST_SRTM_TILE_GRID + col) * 2;
+            data[offset] = (guint8)(raw >> 8);
+            data[offset+1] = (guint8)(raw & 0xFF);
+        }
+    }
+
+    return data;
+}
+
+gchar*
+test_srtm_tile_dir_new(const gchar            *prefix,
+                       const gchar            *name,
+                       test_srtm_tile_value_t  value,
+                       gchar                 **path)
+{
+    gchar *directory;
+    guint8 *data;
+
+    /* A new temporary directory holding a single tile */
+    directory = g_dir_make_tmp(prefix, NULL);
+    if (directory == NULL)
+        return NULL;
+
+    *path = g_build_filename(directory, name, NULL);
+    data = test_srtm_tile_new(value);
+    if (!g_file_set_contents(*path, (const gchar*)data, TEST_SRTM_TILE_SIZE, NULL))
+    {
+        test_srtm_tile_dir_free(directory, *path);
+        directory = NULL;
+        *path = NULL;
+    }
+
+    g_free(data);
+    return directory;
+}
+
+void
+test_srtm_tile_dir_free(gchar *directory,
+                        gchar *path)
+{
+    g_remove(path);
+    g_rmdir(directory);
+    g_free(path);
+    g_free(directory);
+}
@@ -0,0 +1,30 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef OVERLAYAZ_TEST_SRTM_TILE_H_
+#define OVERLAYAZ_TEST_SRTM_TILE_H_
+#include <glib.h>
+
+#define TEST_SRTM_TILE_GRID 1201
+#define TEST_SRTM_TILE_SIZE (TEST_SRTM_TILE_GRID * TEST_SRTM_TILE_GRID * 2)
+
+/* Elevation of the grid post at the row (south to north) and column */
+typedef gint16 (*test_srtm_tile_value_t)(gint, gint);
+
+guint8* test_srtm_tile_new(test_srtm_tile_value_t);
+gchar* test_srtm_tile_dir_new(const gchar*, const gchar*, test_srtm_tile_value_t, gchar**);
+void test_srtm_tile_dir_free(gchar*, gchar*);
+
+#endif
@@ -0,0 +1,294 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <math.h>
+#include "overlayaz.h"
+#include "depth.h"
+#include "viewshed.h"
+#include "srtm.h"
+#include "geo.h"
+#include "test-srtm-tile.h"
+
+#define TILE_NAME "N50E020.hgt"
+#define RIDGE_ROW 600
+#define RIDGE_HEIGHT 1000
+
+/* 10 x 10 cells, one degree spans ten pixels in both axes */
+#define IMAGE_SIZE 100
+#define IMAGE_CELL 10
+#define IMAGE_CELLS ((IMAGE_SIZE / IMAGE_CELL) * (IMAGE_SIZE / IMAGE_CELL))
+#define IMAGE_RATIO 10.0
+#define TERRAIN_RANGE 50000.0
+
+typedef struct {
+    gchar *directory;
+    gchar *path;
+    overlayaz_t *o;
+    gint ready;
+} test_context_t;
+
+/* Sea level plain, crossed by a narrow east-west ridge */
+static gint16
+tile_value(gint row,
+           gint col)
+{
+    return (gint16)(ABS(row - RIDGE_ROW) <= 2 ? RIDGE_HEIGHT : 0);
+}
+
+static void
+test_depth_ready(gpointer user_data)
+{
+    gint *ready = (gint*)user_data;
+    (*ready)++;
+}
+
+static int
+group_setup(void **state)
+{
+    test_context_t *ctx = malloc(sizeof(test_context_t));
+
+    overlayaz_geo_init();
+
+    ctx->directory = test_srtm_tile_dir_new("overlayaz-depth-XXXXXX", TILE_NAME, tile_value, &ctx->path);
+    assert_non_null(ctx->directory);
+
+    ctx->ready = 0;
+    overlayaz_depth_set_notify(test_depth_ready, &ctx->ready);
+
+    *state = ctx;
+    return 0;
+}
+
+static int
+group_teardown(void **state)
+{
+    test_context_t *ctx = *state;
+    overlayaz_depth_set_notify(NULL, NULL);
+    overlayaz_srtm_free();
+    test_srtm_tile_dir_free(ctx->directory, ctx->path);
+    free(ctx);
+    return 0;
+}
+
+static void
+test_depth_model(overlayaz_t                     *o,
+                 const struct overlayaz_location *home)
+{
+    struct overlayaz_location ref;
+
+    overlayaz_set_image(o, overlayaz_image_new(IMAGE_SIZE, IMAGE_SIZE, FALSE));
+    overlayaz_set_location(o, home);
+
+    /* North in the middle of the image, the horizontal plane
+       (with a negligible dip) in the middle of its height */
+    ref.latitude = home->latitude + 0.01;
+    ref.longitude = home->longitude;
+    ref.altitude = home->altitude;
+    overlayaz_set_ref_one(o, OVERLAYAZ_REF_AZ, &ref, IMAGE_SIZE / 2.0, IMAGE_RATIO);
+    overlayaz_set_ref_one(o, OVERLAYAZ_REF_EL, &ref, IMAGE_SIZE / 2.0, IMAGE_RATIO);
+}
+
+static int
+test_setup(void **state)
+{
+    test_context_t *ctx = *state;
+
+    ctx->o = overlayaz_new();
+    test_depth_model(ctx->o, &(struct overlayaz_location){50.25, 20.5, 0.0});
+    overlayaz_depth_set_terrain(ctx->directory, IMAGE_CELL, TERRAIN_RANGE);
+    return 0;
+}
+
+static int
+test_teardown(void **state)
+{
+    test_context_t *ctx = *state;
+    overlayaz_free(ctx->o);
+    overlayaz_depth_free();
+    return 0;
+}
+
+static enum overlayaz_depth_state
+test_depth_wait(const overlayaz_t *o,
+                gdouble            x,
+                gdouble            y,
+                gdouble           *distance)
+{
+    enum overlayaz_depth_state state;
+
+    /* The notify callback runs on the default main context */
+    while ((state = overlayaz_depth_get(o, x, y, distance)) == OVERLAYAZ_DEPTH_PENDING)
+        g_main_context_iteration(NULL, TRUE);
+
+    return state;
+}
+
+static gchar*
+test_depth_path(const test_context_t *ctx)
+{
+    return g_strdup_printf("%s%s", overlayaz_get_filename(ctx->o), OVERLAYAZ_EXTENSION_DEPTH);
+}
+
+static void
+test_depth_ray(void **state)
+{
+    test_context_t *ctx = *state;
+    gdouble distance;
+
+    /* Not traced yet */
+    assert_int_equal(overlayaz_depth_get(ctx->o, 55.0, 35.0, &distance), OVERLAYAZ_DEPTH_PENDING);
+    assert_true(isnan(distance));
+
+    /* 1.5 degrees up the column meets the ridge, about 28 km north */
+    assert_int_equal(test_depth_wait(ctx->o, 55.0, 35.0, &distance), OVERLAYAZ_DEPTH_READY);
+    assert_float_equal(distance, 27800.0, 300.0);
+    while (ctx->ready == 0)
+        g_main_context_iteration(NULL, TRUE);
+
+    /* 3.5 degrees up is above the ridge */
+    assert_int_equal(overlayaz_depth_get(ctx->o, 55.0, 15.0, &distance), OVERLAYAZ_DEPTH_READY);
+    assert_true(isnan(distance));
+
+    /* 2.5 degrees down meets the plain right in front of the observer */
+    assert_int_equal(overlayaz_depth_get(ctx->o, 55.0, 75.0, &distance), OVERLAYAZ_DEPTH_READY);
+    assert_float_equal(distance, OVERLAYAZ_VIEWSHED_STEP, DBL_EPSILON);
+
+    /* Outside of the image */
+    assert_int_equal(overlayaz_depth_get(ctx->o, IMAGE_SIZE + 1.0, 35.0, &distance), OVERLAYAZ_DEPTH_UNAVAILABLE);
+}
+
+static void
+test_depth_key(void **state)
+{
+    test_context_t *ctx = *state;
+    gdouble distance;
+    gdouble moved;
+    gdouble angle;
+
+    assert_int_equal(test_depth_wait(ctx->o, 55.0, 35.0, &distance), OVERLAYAZ_DEPTH_READY);
+
+    /* A different observer needs another map, 100 m up the
+       reference below the horizontal plane tilts the view down */
+    overlayaz_set_location(ctx->o, &(struct overlayaz_location){50.25, 20.5, 100.0});
+    assert_int_equal(overlayaz_depth_get(ctx->o, 55.0, 35.0, &distance), OVERLAYAZ_DEPTH_PENDING);
+    assert_int_equal(test_depth_wait(ctx->o, 55.0, 35.0, &moved), OVERLAYAZ_DEPTH_READY);
+    overlayaz_get_angle(ctx->o, OVERLAYAZ_REF_EL, 35.0, &angle);
+    assert_true(angle < 0.0);
+    assert_float_equal(moved, 100.0 / tan(-angle * G_PI / 180.0), 2 * OVERLAYAZ_VIEWSHED_STEP);
+
+    /* So does another elevation data directory */
+    overlayaz_depth_set_terrain(ctx->path, IMAGE_CELL, TERRAIN_RANGE);
+    assert_int_equal(overlayaz_depth_get(ctx->o, 55.0, 35.0, &distance), OVERLAYAZ_DEPTH_PENDING);
+    overlayaz_depth_set_terrain(ctx->directory, IMAGE_CELL, TERRAIN_RANGE);
+    assert_int_equal(overlayaz_depth_get(ctx->o, 55.0, 35.0, &distance), OVERLAYAZ_DEPTH_PENDING);
+    assert_int_equal(test_depth_wait(ctx->o, 55.0, 35.0, &distance), OVERLAYAZ_DEPTH_READY);
+    assert_float_equal(distance, moved, DBL_EPSILON);
+
+    /* No elevation data configured */
+    overlayaz_depth_set_terrain("", IMAGE_CELL, TERRAIN_RANGE);
+    assert_int_equal(overlayaz_depth_get(ctx->o, 55.0, 35.0, &distance), OVERLAYAZ_DEPTH_UNAVAILABLE);
+}
+
+static void
+test_depth_file(void **state)
+{
+    test_context_t *ctx = *state;
+    gchar *image;
+    gchar *path;
+    gchar *contents;
+    gsize length;
+    gfloat *data;
+    gdouble distance;
+    gdouble traced;
+    gint i;
+
+    image = g_build_filename(ctx->directory, "photo.jpg", NULL);
+    overlayaz_set_filename(ctx->o, image);
+    path = test_depth_path(ctx);
+
+    assert_int_equal(test_depth_wait(ctx->o, 55.0, 35.0, &distance), OVERLAYAZ_DEPTH_READY);
+    assert_float_equal(distance, 27800.0, 300.0);
+
+    /* The raster is stored after the header, mark it to tell where it is read from */
+    assert_true(g_file_get_contents(path, &contents, &length, NULL));
+    assert_true(length > IMAGE_CELLS * sizeof(gfloat));
+    data = (gfloat*)(contents + length - IMAGE_CELLS * sizeof(gfloat));
+    for (i = 0; i < IMAGE_CELLS; i++)
+        data[i] = 1234.0f;
+    assert_true(g_file_set_contents(path, contents, length, NULL));
+    g_free(contents);
+
+    overlayaz_depth_free();
+    overlayaz_depth_set_terrain(ctx->directory, IMAGE_CELL, TERRAIN_RANGE);
+    assert_int_equal(test_depth_wait(ctx->o, 55.0, 35.0, &distance), OVERLAYAZ_DEPTH_READY);
+    assert_float_equal(distance, 1234.0, DBL_EPSILON);
+
+    /* A file of another map is traced again and replaced */
+    overlayaz_set_location(ctx->o, &(struct overlayaz_location){50.25, 20.5, 100.0});
+    assert_int_equal(test_depth_wait(ctx->o, 55.0, 35.0, &traced), OVERLAYAZ_DEPTH_READY);
+    assert_false(traced == 1234.0);
+    overlayaz_depth_free();
+    overlayaz_depth_set_terrain(ctx->directory, IMAGE_CELL, TERRAIN_RANGE);
+    assert_int_equal(test_depth_wait(ctx->o, 55.0, 35.0, &distance), OVERLAYAZ_DEPTH_READY);
+    assert_float_equal(distance, traced, DBL_EPSILON);
+
+    g_remove(path);
+    g_free(path);
+    g_free(image);
+}
+
+static void
+test_depth_missing(void **state)
+{
+    test_context_t *ctx = *state;
+    gchar *image;
+    gchar *path;
+    gdouble distance;
+
+    /* The northern rays leave the only tile */
+    image = g_build_filename(ctx->directory, "photo.jpg", NULL);
+    overlayaz_set_filename(ctx->o, image);
+    test_depth_model(ctx->o, &(struct overlayaz_location){50.95, 20.5, 0.0});
+    path = test_depth_path(ctx);
+
+    assert_int_equal(test_depth_wait(ctx->o, 55.0, 35.0, &distance), OVERLAYAZ_DEPTH_READY);
+    assert_true(isnan(distance));
+
+    /* An incomplete map is not saved */
+    assert_false(g_file_test(path, G_FILE_TEST_EXISTS));
+
+    g_free(path);
+    g_free(image);
+}
+
+const struct CMUnitTest tests[] =
+{
+    cmocka_unit_test_setup_teardown(test_depth_ray, test_setup, test_teardown),
+    cmocka_unit_test_setup_teardown(test_depth_key, test_setup, test_teardown),
+    cmocka_unit_test_setup_teardown(test_depth_file, test_setup, test_teardown),
+    cmocka_unit_test_setup_teardown(test_depth_missing, test_setup, test_teardown),
+};
+
+int
+main(void)
+{
+    return cmocka_run_group_tests(tests, group_setup, group_teardown);
+}
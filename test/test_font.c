@@ -30,6 +30,7 @@ static int
 groupSetup(void **state)
 {
     test_context_t *ctx = malloc(sizeof(test_context_t));
+    overlayaz_font_context_init();
     *state = ctx;
     return 0;
 }
@@ -37,6 +38,7 @@ static int
 groupTeardown(void **state)
 {
     test_context_t *ctx = *state;
+    overlayaz_font_context_free();
     free(ctx);
     return 0;
 }
@@ -83,9 +85,32 @@ font_test_change_font(void **state)
     pango_font_description_free(desc);
 }
 
+static void
+font_test_layout(void **state)
+{
+    test_context_t *ctx = *state;
+    const char new_font[] = "sans-serif 12";
+    PangoLayout *layout;
+    PangoFontDescription *desc;
+
+    layout = overlayaz_font_get_layout(ctx->f, NULL, "text", PANGO_ALIGN_LEFT);
+    assert_non_null(layout);
+    assert_string_equal(pango_layout_get_text(layout), "text");
+    assert_ptr_equal(overlayaz_font_get_layout(ctx->f, NULL, "text", PANGO_ALIGN_LEFT), layout);
+    assert_ptr_not_equal(overlayaz_font_get_layout(ctx->f, NULL, "text", PANGO_ALIGN_CENTER), layout);
+    assert_int_equal(pango_layout_get_alignment(overlayaz_font_get_layout(ctx->f, NULL, "text", PANGO_ALIGN_CENTER)), PANGO_ALIGN_CENTER);
+
+    overlayaz_font_set(ctx->f, new_font);
+    layout = overlayaz_font_get_layout(ctx->f, NULL, "text", PANGO_ALIGN_LEFT);
+    desc = pango_font_description_from_string(new_font);
+    assert_int_equal(pango_font_description_equal(pango_layout_get_font_description(layout), desc), TRUE);
+    pango_font_description_free(desc);
+}
+
 const struct CMUnitTest tests[] = {
     cmocka_unit_test_setup_teardown(font_test_new_instance, testSetup, testTeardown),
     cmocka_unit_test_setup_teardown(font_test_change_font, testSetup, testTeardown),
+    cmocka_unit_test_setup_teardown(font_test_layout, testSetup, testTeardown),
 };
 
 int
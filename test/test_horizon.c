@@ -0,0 +1,159 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <math.h>
+#include "horizon.h"
+#include "viewshed.h"
+#include "srtm.h"
+#include "geo.h"
+#include "test-srtm-tile.h"
+
+#define TILE_NAME "N50E020.hgt"
+#define RIDGE_ROW 600
+#define RIDGE_HEIGHT 1000
+
+typedef struct {
+    gchar *directory;
+    gchar *path;
+} test_context_t;
+
+/* Sea level plain, crossed by a narrow east-west ridge */
+static gint16
+tile_value(gint row,
+           gint col)
+{
+    return (gint16)(ABS(row - RIDGE_ROW) <= 2 ? RIDGE_HEIGHT : 0);
+}
+
+static int
+group_setup(void **state)
+{
+    test_context_t *ctx = malloc(sizeof(test_context_t));
+
+    overlayaz_geo_init();
+
+    ctx->directory = test_srtm_tile_dir_new("overlayaz-horizon-XXXXXX", TILE_NAME, tile_value, &ctx->path);
+    assert_non_null(ctx->directory);
+
+    *state = ctx;
+    return 0;
+}
+
+static int
+group_teardown(void **state)
+{
+    test_context_t *ctx = *state;
+    overlayaz_horizon_free();
+    overlayaz_srtm_free();
+    test_srtm_tile_dir_free(ctx->directory, ctx->path);
+    free(ctx);
+    return 0;
+}
+
+static void
+test_horizon_ridge(void **state)
+{
+    test_context_t *ctx = *state;
+    const struct overlayaz_location home = { 50.25, 20.5, 0.0 };
+    const gdouble azimuth[] = { 0.0, 0.025, 359.99, 180.0 };
+    const gint count = G_N_ELEMENTS(azimuth);
+    gdouble elevation[G_N_ELEMENTS(azimuth)];
+    gdouble again[G_N_ELEMENTS(azimuth)];
+    gdouble ridge;
+    gint i;
+
+    overlayaz_horizon_get(ctx->directory, &home, 50000.0, azimuth, count, TRUE, elevation);
+
+    /* The ridge is about 28 km north of the observer */
+    ridge = atan2(RIDGE_HEIGHT, 27800.0) * 180.0 / G_PI;
+    assert_float_equal(elevation[0], ridge, 0.2);
+    assert_float_equal(elevation[1], ridge, 0.2);
+    assert_float_equal(elevation[2], ridge, 0.2);
+
+    /* The plain towards the south falls below the horizontal plane */
+    assert_true(elevation[3] < 0.0);
+
+    /* Cached bins must give the same result */
+    overlayaz_horizon_get(ctx->directory, &home, 50000.0, azimuth, count, TRUE, again);
+    for (i = 0; i < count; i++)
+        assert_float_equal(again[i], elevation[i], DBL_EPSILON);
+
+    /* Shorter range does not reach the ridge */
+    overlayaz_horizon_get(ctx->directory, &home, 20000.0, azimuth, 1, TRUE, elevation);
+    assert_true(elevation[0] < 0.0);
+}
+
+static void
+test_horizon_no_data(void **state)
+{
+    test_context_t *ctx = *state;
+    const struct overlayaz_location home = { 52.5, 20.5, 0.0 };
+    const gdouble azimuth = 90.0;
+    gdouble elevation;
+
+    overlayaz_horizon_get(ctx->directory, &home, 10000.0, &azimuth, 1, TRUE, &elevation);
+    assert_true(isnan(elevation));
+}
+
+static void
+test_horizon_ready(gpointer user_data)
+{
+    gint *ready = (gint*)user_data;
+    (*ready)++;
+}
+
+static void
+test_horizon_background(void **state)
+{
+    test_context_t *ctx = *state;
+    const struct overlayaz_location home = { 50.3, 20.5, 0.0 };
+    const gdouble azimuth = 0.0;
+    gdouble elevation;
+    gint ready = 0;
+
+    overlayaz_horizon_set_notify(test_horizon_ready, &ready);
+
+    /* Not traced yet */
+    overlayaz_horizon_get(ctx->directory, &home, 50000.0, &azimuth, 1, FALSE, &elevation);
+    assert_true(isnan(elevation));
+
+    while (ready == 0)
+        g_main_context_iteration(NULL, TRUE);
+    assert_int_equal(ready, 1);
+
+    overlayaz_horizon_get(ctx->directory, &home, 50000.0, &azimuth, 1, FALSE, &elevation);
+    assert_true(elevation > 0.0);
+
+    overlayaz_horizon_set_notify(NULL, NULL);
+}
+
+const struct CMUnitTest tests[] =
+{
+    cmocka_unit_test(test_horizon_ridge),
+    cmocka_unit_test(test_horizon_no_data),
+    cmocka_unit_test(test_horizon_background),
+};
+
+int
+main(void)
+{
+    return cmocka_run_group_tests(tests, group_setup, group_teardown);
+}
@@ -0,0 +1,93 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include <gtk/gtk.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include "image.h"
+
+#define WIDTH  33
+#define HEIGHT (OVERLAYAZ_IMAGE_BAND_HEIGHT * 2 + 7)
+
+static void
+test_image_bands(void **state)
+{
+    overlayaz_image_t *image = overlayaz_image_new(WIDTH, HEIGHT, FALSE);
+    const guint8* const *rows;
+    gint y;
+
+    assert_non_null(image);
+    assert_int_equal(overlayaz_image_get_width(image), WIDTH);
+    assert_int_equal(overlayaz_image_get_height(image), HEIGHT);
+    assert_false(overlayaz_image_get_has_alpha(image));
+
+    /* Rows are contiguous within a band */
+    rows = overlayaz_image_get_rows(image);
+    for (y = 0; y < HEIGHT; y++)
+    {
+        assert_ptr_equal(rows[y], overlayaz_image_get_row(image, y));
+        if (y % OVERLAYAZ_IMAGE_BAND_HEIGHT)
+            assert_ptr_equal(rows[y], rows[y - 1] + cairo_format_stride_for_width(CAIRO_FORMAT_RGB24, WIDTH));
+    }
+
+    overlayaz_image_free(image);
+}
+
+static void
+test_image_pixbuf(void **state)
+{
+    GdkPixbuf *pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, WIDTH, HEIGHT);
+    overlayaz_image_t *image;
+
+    gdk_pixbuf_fill(pixbuf, 0x10203000);
+    image = overlayaz_image_new_from_pixbuf(pixbuf);
+    g_object_unref(pixbuf);
+
+    assert_non_null(image);
+    assert_int_equal(((const guint32*)overlayaz_image_get_row(image, 0))[0], 0xFF102030);
+    assert_int_equal(((const guint32*)overlayaz_image_get_row(image, HEIGHT - 1))[WIDTH - 1], 0xFF102030);
+    overlayaz_image_free(image);
+}
+
+static void
+test_image_surface(void **state)
+{
+    overlayaz_image_t *image = overlayaz_image_new(WIDTH, HEIGHT, TRUE);
+    cairo_surface_t *surface;
+
+    /* The surface shares the pixels of the band */
+    surface = overlayaz_image_surface(image, 5, OVERLAYAZ_IMAGE_BAND_HEIGHT, 10, 20);
+    assert_non_null(surface);
+    assert_int_equal(cairo_image_surface_get_format(surface), CAIRO_FORMAT_ARGB32);
+    assert_ptr_equal(cairo_image_surface_get_data(surface), overlayaz_image_get_row(image, OVERLAYAZ_IMAGE_BAND_HEIGHT) + 5 * 4);
+    assert_int_equal(cairo_image_surface_get_stride(surface), cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, WIDTH));
+    cairo_surface_destroy(surface);
+
+    overlayaz_image_free(image);
+}
+
+const struct CMUnitTest tests[] =
+{
+    cmocka_unit_test(test_image_bands),
+    cmocka_unit_test(test_image_pixbuf),
+    cmocka_unit_test(test_image_surface),
+};
+
+int
+main(void)
+{
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,217 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include "jpeg.h"
+#include "image.h"
+
+/* Odd sizes leave partial blocks at the right and bottom edges */
+#define IMAGE_WIDTH 301
+#define IMAGE_HEIGHT 203
+#define IMAGE_QUALITY 100
+/* Largest difference of a channel after a round trip of the gradient */
+#define PIXEL_TOLERANCE 8
+
+typedef struct {
+    gchar *directory;
+    gchar *path;
+} test_context_t;
+
+static int
+group_setup(void **state)
+{
+    test_context_t *ctx = malloc(sizeof(test_context_t));
+
+    ctx->directory = g_dir_make_tmp("overlayaz-jpeg-XXXXXX", NULL);
+    assert_non_null(ctx->directory);
+    ctx->path = g_build_filename(ctx->directory, "test.jpg", NULL);
+
+    *state = ctx;
+    return 0;
+}
+
+static int
+group_teardown(void **state)
+{
+    test_context_t *ctx = *state;
+    g_remove(ctx->path);
+    g_rmdir(ctx->directory);
+    g_free(ctx->path);
+    g_free(ctx->directory);
+    free(ctx);
+    return 0;
+}
+
+/* Smooth in both directions, with every channel different */
+static guint32
+test_jpeg_pixel(gint x,
+                gint y)
+{
+    guint32 r = (guint32)(x * 255 / (IMAGE_WIDTH - 1));
+    guint32 g = (guint32)(y * 255 / (IMAGE_HEIGHT - 1));
+    guint32 b = 0x80;
+    return 0xFF000000 | r << 16 | g << 8 | b;
+}
+
+static guint8*
+test_jpeg_gradient(gint stride)
+{
+    guint8 *data = g_malloc0((gsize)stride * IMAGE_HEIGHT);
+    guint32 *row;
+    gint x, y;
+
+    for (y = 0; y < IMAGE_HEIGHT; y++)
+    {
+        row = (guint32*)(data + (gsize)y * stride);
+        for (x = 0; x < IMAGE_WIDTH; x++)
+            row[x] = test_jpeg_pixel(x, y);
+    }
+
+    return data;
+}
+
+static void
+test_jpeg_check(const overlayaz_image_t *image)
+{
+    const guint32 *row;
+    guint32 expected;
+    gint x, y, shift;
+    gint diff;
+
+    assert_int_equal(overlayaz_image_get_width(image), IMAGE_WIDTH);
+    assert_int_equal(overlayaz_image_get_height(image), IMAGE_HEIGHT);
+
+    for (y = 0; y < IMAGE_HEIGHT; y++)
+    {
+        row = (const guint32*)overlayaz_image_get_row(image, y);
+        for (x = 0; x < IMAGE_WIDTH; x++)
+        {
+            expected = test_jpeg_pixel(x, y);
+            assert_int_equal(row[x] >> 24, 0xFF);
+            for (shift = 0; shift < 24; shift += 8)
+            {
+                diff = ABS((gint)((row[x] >> shift) & 0xFF) - (gint)((expected >> shift) & 0xFF));
+                assert_in_range(diff, 0, PIXEL_TOLERANCE);
+            }
+        }
+    }
+}
+
+static void
+test_jpeg_write(const test_context_t *ctx,
+                gint                  stride,
+                gint                  rows)
+{
+    overlayaz_jpeg_t *jpeg;
+    guint8 *data;
+    gint y;
+
+    data = test_jpeg_gradient(stride);
+    jpeg = overlayaz_jpeg_new(ctx->path, IMAGE_WIDTH, IMAGE_HEIGHT, IMAGE_QUALITY);
+    assert_non_null(jpeg);
+
+    /* Strips of rows, as the export writes them */
+    for (y = 0; y < IMAGE_HEIGHT; y += rows)
+        assert_true(overlayaz_jpeg_write(jpeg, data + (gsize)y * stride, stride, MIN(rows, IMAGE_HEIGHT - y)));
+
+    assert_true(overlayaz_jpeg_finish(jpeg));
+    g_free(data);
+}
+
+static void
+test_jpeg_round_trip(void **state)
+{
+    test_context_t *ctx = *state;
+    overlayaz_image_t *image;
+
+    /* Rows go through the BGRX path of libjpeg-turbo or are converted to RGB, whichever is built */
+    test_jpeg_write(ctx, IMAGE_WIDTH * 4, 64);
+    image = overlayaz_jpeg_load(ctx->path, NULL);
+    assert_non_null(image);
+    test_jpeg_check(image);
+    overlayaz_image_free(image);
+}
+
+static void
+test_jpeg_stride(void **state)
+{
+    test_context_t *ctx = *state;
+    overlayaz_image_t *image;
+
+    /* Padding after each row must not leak into the pixels */
+    test_jpeg_write(ctx, IMAGE_WIDTH * 4 + 12, 1);
+    image = overlayaz_jpeg_load(ctx->path, NULL);
+    assert_non_null(image);
+    test_jpeg_check(image);
+    overlayaz_image_free(image);
+}
+
+static void
+test_jpeg_incomplete(void **state)
+{
+    test_context_t *ctx = *state;
+    overlayaz_jpeg_t *jpeg;
+    guint8 *data;
+
+    /* A file without all the rows is removed */
+    data = test_jpeg_gradient(IMAGE_WIDTH * 4);
+    jpeg = overlayaz_jpeg_new(ctx->path, IMAGE_WIDTH, IMAGE_HEIGHT, IMAGE_QUALITY);
+    assert_non_null(jpeg);
+    assert_true(overlayaz_jpeg_write(jpeg, data, IMAGE_WIDTH * 4, IMAGE_HEIGHT / 2));
+    assert_false(overlayaz_jpeg_finish(jpeg));
+    assert_false(g_file_test(ctx->path, G_FILE_TEST_EXISTS));
+    g_free(data);
+
+    /* So is a file that can not be encoded at all */
+    assert_null(overlayaz_jpeg_new(ctx->path, OVERLAYAZ_JPEG_MAX_SIZE + 1, 1, IMAGE_QUALITY));
+    assert_false(g_file_test(ctx->path, G_FILE_TEST_EXISTS));
+}
+
+static void
+test_jpeg_load_other(void **state)
+{
+    test_context_t *ctx = *state;
+    GCancellable *cancellable;
+
+    /* Other files are left to GdkPixbuf */
+    assert_true(g_file_set_contents(ctx->path, "GIF89a", -1, NULL));
+    assert_null(overlayaz_jpeg_load(ctx->path, NULL));
+
+    /* A cancelled load gives no image */
+    test_jpeg_write(ctx, IMAGE_WIDTH * 4, IMAGE_HEIGHT);
+    cancellable = g_cancellable_new();
+    g_cancellable_cancel(cancellable);
+    assert_null(overlayaz_jpeg_load(ctx->path, cancellable));
+    g_object_unref(cancellable);
+}
+
+const struct CMUnitTest tests[] =
+{
+    cmocka_unit_test(test_jpeg_round_trip),
+    cmocka_unit_test(test_jpeg_stride),
+    cmocka_unit_test(test_jpeg_incomplete),
+    cmocka_unit_test(test_jpeg_load_other),
+};
+
+int
+main(void)
+{
+    return cmocka_run_group_tests(tests, group_setup, group_teardown);
+}
@@ -0,0 +1,349 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2022  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include <gtk/gtk.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <math.h>
+#include "marker-store.h"
+#include "marker-style.h"
+#include "geo.h"
+
+typedef struct {
+    overlayaz_marker_store_t *store;
+    gint events[OVERLAYAZ_MARKER_STORE_RESET + 1];
+    gint last_id;
+} test_context_t;
+
+static void
+helper_notify(gpointer                           data,
+              enum overlayaz_marker_store_event  event,
+              gint                               id)
+{
+    test_context_t *ctx = data;
+    ctx->events[event]++;
+    ctx->last_id = id;
+}
+
+static int
+group_setup(void **state)
+{
+    test_context_t *ctx = malloc(sizeof(test_context_t));
+    *state = ctx;
+    return 0;
+}
+
+static int
+group_teardown(void **state)
+{
+    test_context_t *ctx = *state;
+    free(ctx);
+    return 0;
+}
+
+static int
+test_setup(void **state)
+{
+    test_context_t *ctx = *state;
+    ctx->store = overlayaz_marker_store_new();
+    memset(ctx->events, 0, sizeof(ctx->events));
+    ctx->last_id = -1;
+    overlayaz_marker_store_connect(ctx->store, helper_notify, ctx);
+    return 0;
+}
+
+static int
+test_teardown(void **state)
+{
+    test_context_t *ctx = *state;
+    overlayaz_marker_store_free(ctx->store);
+    return 0;
+}
+
+static void
+test_marker_store_add(void **state)
+{
+    test_context_t *ctx = *state;
+    overlayaz_marker_store_t *store = ctx->store;
+    gint id;
+
+    assert_int_equal(overlayaz_marker_store_count(store), 0);
+    id = overlayaz_marker_store_add(store);
+    assert_int_equal(id, 0);
+    assert_int_equal(overlayaz_marker_store_count(store), 1);
+    assert_int_equal(ctx->events[OVERLAYAZ_MARKER_STORE_INSERTED], 1);
+    assert_int_equal(ctx->last_id, 0);
+
+    assert_string_equal(overlayaz_marker_store_get_name(store, id), "Marker");
+    assert_float_equal(overlayaz_marker_store_get_latitude(store, id), 0.0, DBL_EPSILON);
+    assert_float_equal(overlayaz_marker_store_get_longitude(store, id), 0.0, DBL_EPSILON);
+    assert_int_equal(overlayaz_marker_store_get_tick(store, id), OVERLAYAZ_MARKER_TICK_BOTTOM);
+    assert_int_equal(overlayaz_marker_store_get_style(store, id), OVERLAYAZ_MARKER_STYLE_DEFAULT);
+    assert_float_equal(overlayaz_marker_store_get_position(store, id), 50.0, DBL_EPSILON);
+    assert_true(overlayaz_marker_store_get_active(store, id));
+    assert_true(overlayaz_marker_store_get_show_azimuth(store, id));
+    assert_true(overlayaz_marker_store_get_show_distance(store, id));
+    assert_false(overlayaz_marker_store_get_geo(store, id, NULL, NULL));
+}
+
+static void
+test_marker_store_set(void **state)
+{
+    test_context_t *ctx = *state;
+    overlayaz_marker_store_t *store = ctx->store;
+    struct overlayaz_marker_arrays markers;
+    gint id = overlayaz_marker_store_add(store);
+
+    overlayaz_marker_store_set_name(store, id, "Test");
+    overlayaz_marker_store_set_latitude(store, id, 50.1);
+    overlayaz_marker_store_set_longitude(store, id, 20.2);
+    overlayaz_marker_store_set_tick(store, id, OVERLAYAZ_MARKER_TICK_TOP);
+    overlayaz_marker_store_set_position(store, id, 12.5);
+    overlayaz_marker_store_set_show_azimuth(store, id, FALSE);
+    assert_int_equal(ctx->events[OVERLAYAZ_MARKER_STORE_CHANGED], 6);
+
+    /* Setting the same value again is not a change */
+    overlayaz_marker_store_set_latitude(store, id, 50.1);
+    overlayaz_marker_store_set_active(store, id, TRUE);
+    assert_int_equal(ctx->events[OVERLAYAZ_MARKER_STORE_CHANGED], 6);
+
+    overlayaz_marker_store_get_arrays(store, &markers);
+    assert_int_equal(markers.count, 1);
+    assert_string_equal(markers.name[id], "Test");
+    assert_float_equal(markers.latitude[id], 50.1, DBL_EPSILON);
+    assert_float_equal(markers.longitude[id], 20.2, DBL_EPSILON);
+    assert_int_equal(markers.tick[id], OVERLAYAZ_MARKER_TICK_TOP);
+    assert_float_equal(markers.position[id], 12.5, DBL_EPSILON);
+    assert_int_equal(markers.flags[id], OVERLAYAZ_MARKER_ACTIVE | OVERLAYAZ_MARKER_SHOW_DISTANCE);
+}
+
+static void
+test_marker_store_remove(void **state)
+{
+    test_context_t *ctx = *state;
+    overlayaz_marker_store_t *store = ctx->store;
+    gchar *name;
+    gint i;
+
+    /* More than the initial capacity of the store */
+    for (i = 0; i < 100; i++)
+    {
+        name = g_strdup_printf("%d", i);
+        overlayaz_marker_store_set_name(store, overlayaz_marker_store_add(store), name);
+        g_free(name);
+    }
+    assert_int_equal(overlayaz_marker_store_count(store), 100);
+
+    overlayaz_marker_store_remove(store, 0);
+    overlayaz_marker_store_remove(store, 50);
+    overlayaz_marker_store_remove(store, 97);
+    assert_int_equal(ctx->events[OVERLAYAZ_MARKER_STORE_REMOVED], 3);
+    assert_int_equal(ctx->last_id, 97);
+    assert_int_equal(overlayaz_marker_store_count(store), 97);
+    assert_string_equal(overlayaz_marker_store_get_name(store, 0), "1");
+    assert_string_equal(overlayaz_marker_store_get_name(store, 49), "50");
+    assert_string_equal(overlayaz_marker_store_get_name(store, 50), "52");
+    assert_string_equal(overlayaz_marker_store_get_name(store, 96), "98");
+
+    overlayaz_marker_store_clear(store);
+    assert_int_equal(ctx->events[OVERLAYAZ_MARKER_STORE_CLEARED], 1);
+    assert_int_equal(overlayaz_marker_store_count(store), 0);
+}
+
+static void
+test_marker_store_swap(void **state)
+{
+    test_context_t *ctx = *state;
+    overlayaz_marker_store_t *store = ctx->store;
+    gint a = overlayaz_marker_store_add(store);
+    gint b = overlayaz_marker_store_add(store);
+
+    overlayaz_marker_store_set_name(store, a, "A");
+    overlayaz_marker_store_set_latitude(store, a, 10.0);
+    overlayaz_marker_store_set_style(store, a, 1);
+    overlayaz_marker_store_set_name(store, b, "B");
+    overlayaz_marker_store_set_latitude(store, b, 20.0);
+
+    overlayaz_marker_store_swap(store, 0);
+    assert_int_equal(ctx->events[OVERLAYAZ_MARKER_STORE_SWAPPED], 1);
+    assert_string_equal(overlayaz_marker_store_get_name(store, 0), "B");
+    assert_float_equal(overlayaz_marker_store_get_latitude(store, 0), 20.0, DBL_EPSILON);
+    assert_int_equal(overlayaz_marker_store_get_style(store, 0), OVERLAYAZ_MARKER_STYLE_DEFAULT);
+    assert_string_equal(overlayaz_marker_store_get_name(store, 1), "A");
+    assert_float_equal(overlayaz_marker_store_get_latitude(store, 1), 10.0, DBL_EPSILON);
+    assert_int_equal(overlayaz_marker_store_get_style(store, 1), 1);
+}
+
+static void
+test_marker_store_style(void **state)
+{
+    test_context_t *ctx = *state;
+    overlayaz_marker_store_t *store = ctx->store;
+    struct overlayaz_marker_arrays markers;
+    gint id = overlayaz_marker_store_add(store);
+
+    overlayaz_marker_store_set_style(store, id, 3);
+    assert_int_equal(ctx->events[OVERLAYAZ_MARKER_STORE_CHANGED], 1);
+    overlayaz_marker_store_set_style(store, id, 3);
+    assert_int_equal(ctx->events[OVERLAYAZ_MARKER_STORE_CHANGED], 1);
+
+    overlayaz_marker_store_get_arrays(store, &markers);
+    assert_int_equal(markers.style[id], 3);
+}
+
+static void
+test_marker_style_lookup(void **state)
+{
+    overlayaz_marker_style_t *table = overlayaz_marker_style_new();
+    GdkRGBA color = {1.0, 0.0, 0.0, 1.0};
+    GdkRGBA color_default;
+    guint a, b;
+
+    gdk_rgba_parse(&color_default, "rgba(0,0,0,0.9)");
+    assert_string_equal(overlayaz_font_get(overlayaz_marker_style_get_font(table, OVERLAYAZ_MARKER_STYLE_DEFAULT)), "monospace 12");
+    assert_true(gdk_rgba_equal(overlayaz_marker_style_get_color(table, OVERLAYAZ_MARKER_STYLE_DEFAULT), &color_default));
+    assert_int_equal(overlayaz_marker_style_lookup(table, "monospace 12", &color_default), OVERLAYAZ_MARKER_STYLE_DEFAULT);
+
+    a = overlayaz_marker_style_lookup(table, "monospace 12", &color);
+    assert_int_not_equal(a, OVERLAYAZ_MARKER_STYLE_DEFAULT);
+    assert_true(gdk_rgba_equal(overlayaz_marker_style_get_color(table, a), &color));
+    assert_string_equal(overlayaz_font_get(overlayaz_marker_style_get_font(table, a)), "monospace 12");
+
+    b = overlayaz_marker_style_lookup(table, "sans-serif 10", &color);
+    assert_int_not_equal(a, b);
+    assert_int_equal(overlayaz_marker_style_lookup(table, "sans-serif 10", &color), b);
+    assert_int_equal(overlayaz_marker_style_lookup(table, "monospace 12", &color), a);
+    assert_string_equal(overlayaz_font_get(overlayaz_marker_style_get_font(table, b)), "sans-serif 10");
+
+    overlayaz_marker_style_free(table);
+}
+
+static void
+test_marker_store_geo(void **state)
+{
+    test_context_t *ctx = *state;
+    overlayaz_marker_store_t *store = ctx->store;
+    struct overlayaz_marker_arrays markers;
+    gdouble azimuth, distance;
+    gdouble expected_azimuth, expected_distance;
+    gint id = overlayaz_marker_store_add(store);
+
+    overlayaz_marker_store_set_latitude(store, id, 50.05);
+    overlayaz_marker_store_set_longitude(store, id, 20.05);
+    assert_false(overlayaz_marker_store_get_geo(store, id, &azimuth, &distance));
+
+    overlayaz_marker_store_set_home(store, 50.0, 20.0);
+    overlayaz_geo_inverse(50.0, 20.0, 50.05, 20.05, &expected_azimuth, NULL, &expected_distance);
+    assert_true(overlayaz_marker_store_get_geo(store, id, &azimuth, &distance));
+    assert_float_equal(azimuth, expected_azimuth, DBL_EPSILON);
+    assert_float_equal(distance, expected_distance, DBL_EPSILON);
+
+    /* Markers added later are measured from the same home */
+    id = overlayaz_marker_store_add(store);
+    overlayaz_geo_inverse(50.0, 20.0, 0.0, 0.0, &expected_azimuth, NULL, &expected_distance);
+    overlayaz_marker_store_get_arrays(store, &markers);
+    assert_float_equal(markers.azimuth[id], expected_azimuth, DBL_EPSILON);
+    assert_float_equal(markers.distance[id], expected_distance, DBL_EPSILON);
+
+    overlayaz_marker_store_set_home(store, NAN, NAN);
+    assert_false(overlayaz_marker_store_get_geo(store, 0, NULL, NULL));
+    assert_false(overlayaz_marker_store_get_geo(store, 1, NULL, NULL));
+}
+
+static void
+test_marker_store_batch(void **state)
+{
+    test_context_t *ctx = *state;
+    overlayaz_marker_store_t *store = ctx->store;
+    gint i, id;
+
+    overlayaz_marker_store_begin(store);
+    for (i = 0; i < 1000; i++)
+    {
+        id = overlayaz_marker_store_add(store);
+        overlayaz_marker_store_set_latitude(store, id, i / 100.0);
+    }
+
+    /* Nested batches are announced by the outermost commit */
+    overlayaz_marker_store_begin(store);
+    overlayaz_marker_store_remove(store, 0);
+    overlayaz_marker_store_commit(store);
+    assert_int_equal(ctx->events[OVERLAYAZ_MARKER_STORE_RESET], 0);
+
+    overlayaz_marker_store_commit(store);
+    assert_int_equal(ctx->events[OVERLAYAZ_MARKER_STORE_INSERTED], 0);
+    assert_int_equal(ctx->events[OVERLAYAZ_MARKER_STORE_CHANGED], 0);
+    assert_int_equal(ctx->events[OVERLAYAZ_MARKER_STORE_REMOVED], 0);
+    assert_int_equal(ctx->events[OVERLAYAZ_MARKER_STORE_RESET], 1);
+    assert_int_equal(ctx->last_id, -1);
+    assert_int_equal(overlayaz_marker_store_count(store), 999);
+    assert_float_equal(overlayaz_marker_store_get_latitude(store, 0), 0.01, DBL_EPSILON);
+
+    /* An empty batch is not a change */
+    overlayaz_marker_store_begin(store);
+    overlayaz_marker_store_commit(store);
+    assert_int_equal(ctx->events[OVERLAYAZ_MARKER_STORE_RESET], 1);
+
+    overlayaz_marker_store_add(store);
+    assert_int_equal(ctx->events[OVERLAYAZ_MARKER_STORE_INSERTED], 1);
+}
+
+static void
+test_marker_store_disconnect(void **state)
+{
+    test_context_t *ctx = *state;
+
+    overlayaz_marker_store_disconnect(ctx->store, helper_notify, ctx);
+    overlayaz_marker_store_add(ctx->store);
+    assert_int_equal(ctx->events[OVERLAYAZ_MARKER_STORE_INSERTED], 0);
+}
+
+static void
+test_marker_store_disconnect_batch(void **state)
+{
+    test_context_t *ctx = *state;
+
+    overlayaz_marker_store_begin(ctx->store);
+    overlayaz_marker_store_add(ctx->store);
+    overlayaz_marker_store_disconnect(ctx->store, helper_notify, ctx);
+    overlayaz_marker_store_commit(ctx->store);
+    assert_int_equal(ctx->events[OVERLAYAZ_MARKER_STORE_RESET], 0);
+
+    overlayaz_marker_store_add(ctx->store);
+    assert_int_equal(ctx->events[OVERLAYAZ_MARKER_STORE_INSERTED], 0);
+}
+
+const struct CMUnitTest tests[] =
+{
+    cmocka_unit_test_setup_teardown(test_marker_store_add, test_setup, test_teardown),
+    cmocka_unit_test_setup_teardown(test_marker_store_set, test_setup, test_teardown),
+    cmocka_unit_test_setup_teardown(test_marker_store_remove, test_setup, test_teardown),
+    cmocka_unit_test_setup_teardown(test_marker_store_swap, test_setup, test_teardown),
+    cmocka_unit_test_setup_teardown(test_marker_store_style, test_setup, test_teardown),
+    cmocka_unit_test(test_marker_style_lookup),
+    cmocka_unit_test_setup_teardown(test_marker_store_geo, test_setup, test_teardown),
+    cmocka_unit_test_setup_teardown(test_marker_store_batch, test_setup, test_teardown),
+    cmocka_unit_test_setup_teardown(test_marker_store_disconnect, test_setup, test_teardown),
+    cmocka_unit_test_setup_teardown(test_marker_store_disconnect_batch, test_setup, test_teardown),
+};
+
+int
+main(void)
+{
+    overlayaz_geo_init();
+    return cmocka_run_group_tests(tests, group_setup, group_teardown);
+}
@@ -19,8 +19,6 @@
 #include <cmocka.h>
 #include <stdlib.h>
 #include "overlayaz.h"
-#include "marker-list.h"
-#include "marker-iter.h"
 #include "overlayaz-default.h"
 #include "geo.h"
 
@@ -64,7 +62,7 @@ test_setup2(void **state)
 {
     test_context_t *ctx = *state;
     test_setup(state);
-    overlayaz_set_pixbuf(ctx->o, gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, PIXBUF_WIDTH, PIXBUF_HEIGHT));
+    overlayaz_set_image(ctx->o, overlayaz_image_new(PIXBUF_WIDTH, PIXBUF_HEIGHT, FALSE));
     overlayaz_set_location(ctx->o, &(struct overlayaz_location){LOCATION_LATITUDE, LOCATION_LONGITUDE, LOCATION_ALTITUDE});
     overlayaz_unchanged(ctx->o);
     return 0;
@@ -97,14 +95,12 @@ test_teardown(void **state)
 static void
 helper_overlayaz_default_values(const overlayaz_t *o)
 {
-    GtkListStore *marker_list;
-    overlayaz_marker_iter_t *marker_iter;
-    const overlayaz_marker_t *marker;
+    overlayaz_marker_store_t *markers;
     overlayaz_font_t *font;
     GdkRGBA color;
     gchar *color_str_A, *color_str_B;
 
-    assert_null(overlayaz_get_pixbuf(o));
+    assert_null(overlayaz_get_image(o));
     assert_null(overlayaz_get_filename(o));
     assert_int_equal(overlayaz_get_width(o), 0);
     assert_int_equal(overlayaz_get_height(o), 0);
@@ -147,10 +143,9 @@ helper_overlayaz_default_values(const overlayaz_t *o)
     g_free(color_str_A);
     g_free(color_str_B);
 
-    marker_list = overlayaz_get_marker_list(o);
-    assert_non_null(marker_list);
-    marker_iter = overlayaz_marker_iter_new(marker_list, &marker);
-    assert_null(marker_iter);
+    markers = overlayaz_get_marker_store(o);
+    assert_non_null(markers);
+    assert_int_equal(overlayaz_marker_store_count(markers), 0);
 }
 
 static void
@@ -169,7 +164,7 @@ test_overlayaz_reset(void **state)
     overlayaz_t *o = ctx->o;
 
     overlayaz_reset(o);
-    assert_null(overlayaz_get_pixbuf(o));
+    assert_null(overlayaz_get_image(o));
     assert_null(overlayaz_get_filename(o));
     helper_overlayaz_default_values(o);
     assert_int_equal(overlayaz_changed(o), FALSE);
@@ -185,7 +180,7 @@ test_overlayaz_reset_after_changes(void **state)
     gdk_rgba_parse(&color, "rgba(0x12,0x34,0x56,0.5)");
 
     overlayaz_set_filename(o, "test");
-    overlayaz_set_pixbuf(o, gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, 111, 222));
+    overlayaz_set_image(o, overlayaz_image_new(111, 222, FALSE));
     overlayaz_set_rotation(o, 11.1);
     overlayaz_set_location(o, &(struct overlayaz_location){56.0, 23.0, 101.1});
     overlayaz_set_ref_one(o, OVERLAYAZ_REF_AZ, &(struct overlayaz_location){56.05, 23.05, 100.0}, 55.0, 100.0);
@@ -200,7 +195,7 @@ test_overlayaz_reset_after_changes(void **state)
     overlayaz_set_grid_color(o, &color);
     overlayaz_set_grid_font(o, "monospace 64");
     overlayaz_set_grid_font_color(o, &color);
-    overlayaz_marker_list_add(overlayaz_get_marker_list(o), overlayaz_marker_new());
+    overlayaz_marker_store_add(overlayaz_get_marker_store(o));
 
     overlayaz_reset(o);
     helper_overlayaz_default_values(o);
@@ -222,6 +217,26 @@ test_overlayaz_changed(void **state)
     assert_true(overlayaz_changed(o));
 }
 
+static void
+test_overlayaz_revision(void **state)
+{
+    test_context_t *ctx = *state;
+    overlayaz_t *o = ctx->o;
+    guint revision = overlayaz_get_revision(o);
+
+    overlayaz_set_grid_width(o, overlayaz_get_grid_width(o));
+    assert_int_equal(overlayaz_get_revision(o), revision);
+    overlayaz_set_grid_width(o, overlayaz_get_grid_width(o) + 1.0);
+    assert_int_not_equal(overlayaz_get_revision(o), revision);
+
+    /* The revision is not reset along with the changed flag */
+    revision = overlayaz_get_revision(o);
+    overlayaz_unchanged(o);
+    assert_int_equal(overlayaz_get_revision(o), revision);
+    overlayaz_reset(o);
+    assert_int_not_equal(overlayaz_get_revision(o), revision);
+}
+
 static void
 test_overlayaz_filename_change(void **state)
 {
@@ -240,20 +255,20 @@ test_overlayaz_filename_change(void **state)
 }
 
 static void
-test_overlayaz_pixbuf_change(void **state)
+test_overlayaz_image_change(void **state)
 {
     test_context_t *ctx = *state;
     overlayaz_t *o = ctx->o;
     gint width = 123;
     gint height = 345;
-    GdkPixbuf *pixbuf;
+    overlayaz_image_t *image;
 
     assert_int_equal(overlayaz_changed(o), FALSE);
-    pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, width, height);
-    assert_non_null(pixbuf);
-    overlayaz_set_pixbuf(ctx->o, pixbuf);
+    image = overlayaz_image_new(width, height, FALSE);
+    assert_non_null(image);
+    overlayaz_set_image(ctx->o, image);
     assert_int_equal(overlayaz_changed(o), TRUE);
-    assert_ptr_equal(overlayaz_get_pixbuf(o), pixbuf);
+    assert_ptr_equal(overlayaz_get_image(o), image);
     assert_int_equal(overlayaz_get_width(o), width);
     assert_int_equal(overlayaz_get_height(o), height);
 }
@@ -497,6 +512,23 @@ test_overlayaz_ref_one_azimuth(void **state)
                             position, ratio);
 }
 
+static void
+test_overlayaz_ref_one_azimuth_image(void **state)
+{
+    test_context_t *ctx = *state;
+    overlayaz_t *o = ctx->o;
+    gdouble ratio;
+
+    /* A reference from a profile loaded before the image */
+    overlayaz_set_image(o, NULL);
+    overlayaz_set_ref_one(o, OVERLAYAZ_REF_AZ, &(struct overlayaz_location){50.05, 20.05, 0.0}, 250.0, 2.0);
+    assert_true(overlayaz_get_ratio(o, OVERLAYAZ_REF_AZ, &ratio));
+
+    /* The full circle is narrower than the image */
+    overlayaz_set_image(o, overlayaz_image_new(PIXBUF_WIDTH, PIXBUF_HEIGHT, FALSE));
+    assert_false(overlayaz_get_ratio(o, OVERLAYAZ_REF_AZ, &ratio));
+}
+
 static void
 test_overlayaz_ref_two_azimuth(void **state)
 {
@@ -566,6 +598,46 @@ test_overlayaz_ref_two_elevation(void **state)
                              ratio_expected);
 }
 
+static void
+test_overlayaz_marker_geo(void **state)
+{
+    test_context_t *ctx = *state;
+    overlayaz_t *o = ctx->o;
+    overlayaz_marker_store_t *markers = overlayaz_get_marker_store(o);
+    gint id = overlayaz_marker_store_add(markers);
+    gdouble azimuth, distance;
+    gdouble expected_azimuth, expected_distance;
+
+    overlayaz_marker_store_set_latitude(markers, id, 50.05);
+    overlayaz_marker_store_set_longitude(markers, id, 20.05);
+
+    overlayaz_geo_inverse(LOCATION_LATITUDE, LOCATION_LONGITUDE, 50.05, 20.05,
+                          &expected_azimuth, NULL, &expected_distance);
+    assert_true(overlayaz_marker_store_get_geo(markers, id, &azimuth, &distance));
+    assert_float_equal(azimuth, expected_azimuth, FLT_EPSILON);
+    assert_float_equal(distance, expected_distance, FLT_EPSILON);
+
+    /* Moving the marker */
+    overlayaz_marker_store_set_longitude(markers, id, 19.95);
+    overlayaz_geo_inverse(LOCATION_LATITUDE, LOCATION_LONGITUDE, 50.05, 19.95,
+                          &expected_azimuth, NULL, &expected_distance);
+    assert_true(overlayaz_marker_store_get_geo(markers, id, &azimuth, &distance));
+    assert_float_equal(azimuth, expected_azimuth, FLT_EPSILON);
+    assert_float_equal(distance, expected_distance, FLT_EPSILON);
+
+    /* Moving the home location */
+    overlayaz_set_location(o, &(struct overlayaz_location){50.1, 20.1, LOCATION_ALTITUDE});
+    overlayaz_geo_inverse(50.1, 20.1, 50.05, 19.95,
+                          &expected_azimuth, NULL, &expected_distance);
+    assert_true(overlayaz_marker_store_get_geo(markers, id, &azimuth, &distance));
+    assert_float_equal(azimuth, expected_azimuth, FLT_EPSILON);
+    assert_float_equal(distance, expected_distance, FLT_EPSILON);
+
+    /* Clearing the home location */
+    overlayaz_set_location(o, &(struct overlayaz_location){0.0, 0.0, LOCATION_ALTITUDE});
+    assert_false(overlayaz_marker_store_get_geo(markers, id, &azimuth, &distance));
+}
+
 const struct CMUnitTest tests[] =
 {
     /* Setup with no configuration */
@@ -573,8 +645,9 @@ const struct CMUnitTest tests[] =
     cmocka_unit_test_setup_teardown(test_overlayaz_reset, test_setup, test_teardown),
     cmocka_unit_test_setup_teardown(test_overlayaz_reset_after_changes, test_setup, test_teardown),
     cmocka_unit_test_setup_teardown(test_overlayaz_changed, test_setup, test_teardown),
+    cmocka_unit_test_setup_teardown(test_overlayaz_revision, test_setup, test_teardown),
     cmocka_unit_test_setup_teardown(test_overlayaz_filename_change, test_setup, test_teardown),
-    cmocka_unit_test_setup_teardown(test_overlayaz_pixbuf_change, test_setup, test_teardown),
+    cmocka_unit_test_setup_teardown(test_overlayaz_image_change, test_setup, test_teardown),
     cmocka_unit_test_setup_teardown(test_overlayaz_rotation_change, test_setup, test_teardown),
     cmocka_unit_test_setup_teardown(test_overlayaz_rotation_change_overlap, test_setup, test_teardown),
     cmocka_unit_test_setup_teardown(test_overlayaz_rotation_change_overlap_negative, test_setup, test_teardown),
@@ -586,9 +659,11 @@ const struct CMUnitTest tests[] =
     cmocka_unit_test_setup_teardown(test_overlayaz_grid_change_crosscheck, test_setup, test_teardown),
     /* Setup with location */
     cmocka_unit_test_setup_teardown(test_overlayaz_ref_one_azimuth, test_setup2, test_teardown),
+    cmocka_unit_test_setup_teardown(test_overlayaz_ref_one_azimuth_image, test_setup2, test_teardown),
     cmocka_unit_test_setup_teardown(test_overlayaz_ref_two_azimuth, test_setup2, test_teardown),
     cmocka_unit_test_setup_teardown(test_overlayaz_ref_one_elevation, test_setup2, test_teardown),
     cmocka_unit_test_setup_teardown(test_overlayaz_ref_two_elevation, test_setup2, test_teardown),
+    cmocka_unit_test_setup_teardown(test_overlayaz_marker_geo, test_setup2, test_teardown),
     /* Setup with location and references */
 };
 
@@ -0,0 +1,115 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include <gtk/gtk.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <string.h>
+#include "pixel.h"
+
+#define COUNT 67
+
+static void
+fill_pattern(guint8 *data,
+             gsize   size)
+{
+    gsize i;
+
+    for (i = 0; i < size; i++)
+        data[i] = (guint8)((i * 151 + 7) ^ (i >> 3));
+}
+
+static void
+test_pixel_rgb(void **state)
+{
+    const guint8 src[] = { 0x10, 0x20, 0x30, 0xFF, 0x00, 0x80 };
+    guint32 dst[2];
+
+    overlayaz_pixel_convert(src, 3, (guint8*)dst, 2);
+    assert_int_equal(dst[0], 0xFF102030);
+    assert_int_equal(dst[1], 0xFFFF0080);
+}
+
+static void
+test_pixel_rgba(void **state)
+{
+    const guint8 src[] = { 0x10, 0x20, 0x30, 0xFF,
+                           0xFF, 0x80, 0x00, 0x80,
+                           0xFF, 0xFF, 0xFF, 0x00,
+                           0x40, 0x40, 0x40, 0x01 };
+    guint32 dst[4];
+
+    overlayaz_pixel_convert(src, 4, (guint8*)dst, 4);
+    assert_int_equal(dst[0], 0xFF102030);
+    assert_int_equal(dst[1], 0x80804000);
+    assert_int_equal(dst[2], 0x00000000);
+    assert_int_equal(dst[3], 0x01000000);
+}
+
+static void
+test_pixel_scalar(void **state)
+{
+    guint8 src[COUNT * 4];
+    guint32 dst[COUNT];
+    guint32 ref[COUNT];
+    gint n_channels;
+    gint count;
+
+    fill_pattern(src, sizeof(src));
+
+    /* Every length exercises a different split between the vector body and the tail */
+    for (n_channels = 3; n_channels <= 4; n_channels++)
+    {
+        for (count = 0; count <= COUNT; count++)
+        {
+            memset(dst, 0xAA, sizeof(dst));
+            memset(ref, 0xAA, sizeof(ref));
+            overlayaz_pixel_convert(src, n_channels, (guint8*)dst, count);
+            overlayaz_pixel_convert_scalar(src, n_channels, (guint8*)ref, count);
+            assert_memory_equal(dst, ref, sizeof(dst));
+        }
+    }
+}
+
+static void
+test_pixel_halve(void **state)
+{
+    const guint32 src[] = { 0xFF000000, 0xFF040404, 0xFF102030,
+                            0xFF080808, 0xFF0C0C0C, 0x80804000,
+                            0x00000000, 0xFFFFFFFF, 0xFF010203 };
+    guint32 dst[4];
+
+    /* Odd sizes: the last column and row are averaged with themselves */
+    overlayaz_pixel_halve((const guint8*)src, 3 * 4, 3, 3, (guint8*)dst, 2 * 4);
+    assert_int_equal(dst[0], 0xFF060606);
+    assert_int_equal(dst[1], 0xC0483018);
+    assert_int_equal(dst[2], 0x80808080);
+    assert_int_equal(dst[3], 0xFF010203);
+}
+
+const struct CMUnitTest tests[] =
+{
+    cmocka_unit_test(test_pixel_rgb),
+    cmocka_unit_test(test_pixel_rgba),
+    cmocka_unit_test(test_pixel_scalar),
+    cmocka_unit_test(test_pixel_halve),
+};
+
+int
+main(void)
+{
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,211 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include <gtk/gtk.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rotate.h"
+
+#define WIDTH  37
+#define HEIGHT 24
+#define SIZE   16
+
+typedef struct {
+    guint32 *src;
+    const guint8 *rows[HEIGHT];
+    guint32 *dst;
+} test_context_t;
+
+static guint32
+pixel_value(gint x,
+            gint y)
+{
+    return (guint32)((x * 7) & 0xFF) << 16 | (guint32)((y * 11) & 0xFF) << 8 | (guint32)((x * y) & 0xFF);
+}
+
+static int
+group_setup(void **state)
+{
+    test_context_t *ctx = malloc(sizeof(test_context_t));
+    gint x, y;
+
+    ctx->src = g_new(guint32, WIDTH * HEIGHT);
+    ctx->dst = g_new(guint32, WIDTH * HEIGHT);
+    for (y = 0; y < HEIGHT; y++)
+    {
+        for (x = 0; x < WIDTH; x++)
+            ctx->src[y * WIDTH + x] = 0xFF000000 | pixel_value(x, y);
+        ctx->rows[y] = (const guint8*)(ctx->src + y * WIDTH);
+    }
+
+    *state = ctx;
+    return 0;
+}
+
+static int
+group_teardown(void **state)
+{
+    test_context_t *ctx = *state;
+    g_free(ctx->src);
+    g_free(ctx->dst);
+    free(ctx);
+    return 0;
+}
+
+static void
+test_rotate_identity(void **state)
+{
+    test_context_t *ctx = *state;
+    enum overlayaz_rotate_filter filter;
+    gint x, y;
+
+    for (filter = OVERLAYAZ_ROTATE_NEAREST; filter <= OVERLAYAZ_ROTATE_BICUBIC; filter++)
+    {
+        overlayaz_rotate(ctx->rows, WIDTH, HEIGHT, 0.0, filter,
+                         (guint8*)ctx->dst, WIDTH * 4, 0, HEIGHT);
+        for (y = 0; y < HEIGHT; y++)
+            for (x = 0; x < WIDTH; x++)
+                assert_int_equal(ctx->dst[y * WIDTH + x], pixel_value(x, y));
+    }
+}
+
+static void
+test_rotate_half_turn(void **state)
+{
+    test_context_t *ctx = *state;
+    enum overlayaz_rotate_filter filter;
+    gint x, y;
+
+    for (filter = OVERLAYAZ_ROTATE_NEAREST; filter <= OVERLAYAZ_ROTATE_BICUBIC; filter++)
+    {
+        overlayaz_rotate(ctx->rows, WIDTH, HEIGHT, 180.0, filter,
+                         (guint8*)ctx->dst, WIDTH * 4, 0, HEIGHT);
+        for (y = 0; y < HEIGHT; y++)
+            for (x = 0; x < WIDTH; x++)
+                assert_int_equal(ctx->dst[y * WIDTH + x], pixel_value(WIDTH - 1 - x, HEIGHT - 1 - y));
+    }
+}
+
+static void
+test_rotate_quarter_turn(void **state)
+{
+    test_context_t *ctx = *state;
+    gint x, y;
+
+    /* Clockwise on the screen, the left column becomes the top row */
+    overlayaz_rotate(ctx->rows, SIZE, SIZE, 90.0, OVERLAYAZ_ROTATE_NEAREST,
+                     (guint8*)ctx->dst, SIZE * 4, 0, SIZE);
+    for (y = 0; y < SIZE; y++)
+        for (x = 0; x < SIZE; x++)
+            assert_int_equal(ctx->dst[y * SIZE + x], pixel_value(y, SIZE - 1 - x));
+}
+
+static void
+test_rotate_bands(void **state)
+{
+    test_context_t *ctx = *state;
+    guint32 *full = g_new(guint32, WIDTH * HEIGHT);
+    enum overlayaz_rotate_filter filter;
+    gint first;
+
+    for (filter = OVERLAYAZ_ROTATE_NEAREST; filter <= OVERLAYAZ_ROTATE_BICUBIC; filter++)
+    {
+        overlayaz_rotate(ctx->rows, WIDTH, HEIGHT, 3.5, filter,
+                         (guint8*)full, WIDTH * 4, 0, HEIGHT);
+
+        /* Bands of any height give the same rows */
+        for (first = 0; first < HEIGHT; first += 5)
+            overlayaz_rotate(ctx->rows, WIDTH, HEIGHT, 3.5, filter,
+                             (guint8*)(ctx->dst + first * WIDTH), WIDTH * 4, first, MIN(5, HEIGHT - first));
+
+        assert_memory_equal(ctx->dst, full, WIDTH * HEIGHT * sizeof(guint32));
+    }
+
+    g_free(full);
+}
+
+static void
+test_rotate_rows(void **state)
+{
+    test_context_t *ctx = *state;
+    guint32 *full = g_new(guint32, WIDTH * HEIGHT);
+    guint8 *rows[HEIGHT];
+    const gdouble rotation[] = { 3.5, -7.0, 30.0 };
+    enum overlayaz_rotate_filter filter;
+    gsize i;
+    gint y;
+
+    /* Every source row is allocated on its own */
+    for (y = 0; y < HEIGHT; y++)
+    {
+        rows[y] = g_malloc(WIDTH * 4);
+        memcpy(rows[y], ctx->rows[y], WIDTH * 4);
+    }
+
+    for (i = 0; i < G_N_ELEMENTS(rotation); i++)
+    {
+        for (filter = OVERLAYAZ_ROTATE_NEAREST; filter <= OVERLAYAZ_ROTATE_BICUBIC; filter++)
+        {
+            overlayaz_rotate(ctx->rows, WIDTH, HEIGHT, rotation[i], filter,
+                             (guint8*)full, WIDTH * 4, 0, HEIGHT);
+            overlayaz_rotate((const guint8* const*)rows, WIDTH, HEIGHT, rotation[i], filter,
+                             (guint8*)ctx->dst, WIDTH * 4, 0, HEIGHT);
+            assert_memory_equal(ctx->dst, full, WIDTH * HEIGHT * sizeof(guint32));
+        }
+    }
+
+    for (y = 0; y < HEIGHT; y++)
+        g_free(rows[y]);
+    g_free(full);
+}
+
+static void
+test_rotate_outside(void **state)
+{
+    test_context_t *ctx = *state;
+    enum overlayaz_rotate_filter filter;
+
+    for (filter = OVERLAYAZ_ROTATE_NEAREST; filter <= OVERLAYAZ_ROTATE_BICUBIC; filter++)
+    {
+        overlayaz_rotate(ctx->rows, WIDTH, HEIGHT, 45.0, filter,
+                         (guint8*)ctx->dst, WIDTH * 4, 0, HEIGHT);
+
+        /* The corners are uncovered and black, the center is kept */
+        assert_int_equal(ctx->dst[0], 0);
+        assert_int_equal(ctx->dst[WIDTH - 1], 0);
+        assert_int_equal(ctx->dst[(HEIGHT - 1) * WIDTH], 0);
+        assert_int_equal(ctx->dst[HEIGHT * WIDTH - 1], 0);
+        assert_int_not_equal(ctx->dst[HEIGHT / 2 * WIDTH + WIDTH / 2], 0);
+    }
+}
+
+const struct CMUnitTest tests[] =
+{
+    cmocka_unit_test(test_rotate_identity),
+    cmocka_unit_test(test_rotate_half_turn),
+    cmocka_unit_test(test_rotate_quarter_turn),
+    cmocka_unit_test(test_rotate_bands),
+    cmocka_unit_test(test_rotate_rows),
+    cmocka_unit_test(test_rotate_outside),
+};
+
+int
+main(void)
+{
+    return cmocka_run_group_tests(tests, group_setup, group_teardown);
+}
@@ -0,0 +1,349 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <math.h>
+#include "srtm.h"
+#include "test-srtm-tile.h"
+
+#define TILE_NAME "N50E020.hgt"
+#define TILE_LATITUDE 50
+#define TILE_LONGITUDE 20
+#define TILE_GZ_NAME "N50E021.hgt.gz"
+#define TILE_GZ_LONGITUDE 21
+
+typedef struct {
+    gchar *directory;
+    gchar *path;
+    gchar *path_gz;
+} test_context_t;
+
+typedef struct {
+    gboolean done;
+    enum overlayaz_srtm_error error;
+    gdouble value;
+} test_async_t;
+
+/* Synthetic elevation: 10 m per row (south to north) plus 1 m per column */
+static gint16
+tile_value(gint row,
+           gint col)
+{
+    return (gint16)(row * 10 + col);
+}
+
+static int
+group_setup(void **state)
+{
+    test_context_t *ctx = malloc(sizeof(test_context_t));
+    GOutputStream *memory;
+    GOutputStream *stream;
+    GConverter *converter;
+    guint8 *data;
+
+    ctx->directory = test_srtm_tile_dir_new("overlayaz-srtm-XXXXXX", TILE_NAME, tile_value, &ctx->path);
+    assert_non_null(ctx->directory);
+    ctx->path_gz = g_build_filename(ctx->directory, TILE_GZ_NAME, NULL);
+
+    /* Keep the decoded tiles away from the real cache */
+    g_setenv("XDG_CACHE_HOME", ctx->directory, TRUE);
+
+    /* The neighbouring tile holds the same data, gzip compressed */
+    memory = g_memory_output_stream_new_resizable();
+    converter = G_CONVERTER(g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1));
+    stream = g_converter_output_stream_new(memory, converter);
+    data = test_srtm_tile_new(tile_value);
+    assert_true(g_output_stream_write_all(stream, data, TEST_SRTM_TILE_SIZE, NULL, NULL, NULL));
+    assert_true(g_output_stream_close(stream, NULL, NULL));
+    assert_true(g_file_set_contents(ctx->path_gz,
+                                    g_memory_output_stream_get_data(G_MEMORY_OUTPUT_STREAM(memory)),
+                                    (gssize)g_memory_output_stream_get_data_size(G_MEMORY_OUTPUT_STREAM(memory)),
+                                    NULL));
+    g_object_unref(stream);
+    g_object_unref(converter);
+    g_object_unref(memory);
+    g_free(data);
+
+    *state = ctx;
+    return 0;
+}
+
+static int
+group_teardown(void **state)
+{
+    test_context_t *ctx = *state;
+    gchar *decoded_dir;
+    gchar *decoded;
+    const gchar *filename;
+    GDir *dir;
+
+    overlayaz_srtm_free();
+
+    decoded_dir = g_build_filename(ctx->directory, "overlayaz", "srtm", NULL);
+    dir = g_dir_open(decoded_dir, 0, NULL);
+    while (dir && (filename = g_dir_read_name(dir)))
+    {
+        decoded = g_build_filename(decoded_dir, filename, NULL);
+        g_remove(decoded);
+        g_free(decoded);
+    }
+    if (dir)
+        g_dir_close(dir);
+    g_rmdir(decoded_dir);
+    g_free(decoded_dir);
+
+    decoded_dir = g_build_filename(ctx->directory, "overlayaz", NULL);
+    g_rmdir(decoded_dir);
+    g_free(decoded_dir);
+
+    g_remove(ctx->path_gz);
+    g_free(ctx->path_gz);
+    test_srtm_tile_dir_free(ctx->directory, ctx->path);
+    free(ctx);
+    return 0;
+}
+
+static void
+test_srtm_filename(void **state)
+{
+    gchar *filename;
+
+    filename = overlayaz_srtm_filename(50.5, 20.5);
+    assert_string_equal(filename, "N50E020.hgt");
+    g_free(filename);
+
+    filename = overlayaz_srtm_filename(-9.25, -10.5);
+    assert_string_equal(filename, "S10W011.hgt");
+    g_free(filename);
+}
+
+static void
+test_srtm_lookup(void **state)
+{
+    test_context_t *ctx = *state;
+    gdouble value;
+
+    assert_int_equal(overlayaz_srtm_lookup(ctx->directory, TILE_LATITUDE, TILE_LONGITUDE, &value), OVERLAYAZ_SRTM_OK);
+    assert_float_equal(value, tile_value(0, 0), FLT_EPSILON);
+
+    assert_int_equal(overlayaz_srtm_lookup(ctx->directory, TILE_LATITUDE + 0.5, TILE_LONGITUDE + 0.25, &value), OVERLAYAZ_SRTM_OK);
+    assert_float_equal(value, tile_value(600, 300), FLT_EPSILON);
+
+    /* Nearest grid post */
+    assert_int_equal(overlayaz_srtm_lookup(ctx->directory, TILE_LATITUDE + 0.9999, TILE_LONGITUDE + 0.0001, &value), OVERLAYAZ_SRTM_OK);
+    assert_float_equal(value, tile_value(TEST_SRTM_TILE_GRID - 1, 0), FLT_EPSILON);
+}
+
+static void
+test_srtm_lookup_missing(void **state)
+{
+    test_context_t *ctx = *state;
+    gdouble value;
+
+    assert_int_equal(overlayaz_srtm_lookup(ctx->directory, TILE_LATITUDE + 1.5, TILE_LONGITUDE, &value), OVERLAYAZ_SRTM_ERROR_MISSING);
+}
+
+static void
+test_srtm_lookup_directory(void **state)
+{
+    test_context_t *ctx = *state;
+    gchar *directory = g_build_filename(ctx->directory, "later", NULL);
+    gdouble value;
+
+    assert_int_equal(overlayaz_srtm_lookup(directory, TILE_LATITUDE, TILE_LONGITUDE, &value), OVERLAYAZ_SRTM_ERROR_DIR);
+
+    /* The failure is kept until the directory is set again */
+    assert_int_equal(g_mkdir(directory, 0700), 0);
+    assert_int_equal(overlayaz_srtm_lookup(directory, TILE_LATITUDE, TILE_LONGITUDE, &value), OVERLAYAZ_SRTM_ERROR_DIR);
+
+    overlayaz_srtm_set_directory(directory);
+    assert_int_equal(overlayaz_srtm_lookup(directory, TILE_LATITUDE, TILE_LONGITUDE, &value), OVERLAYAZ_SRTM_ERROR_MISSING);
+
+    overlayaz_srtm_free();
+    g_rmdir(directory);
+    g_free(directory);
+}
+
+static void
+test_srtm_lookup_compressed(void **state)
+{
+    test_context_t *ctx = *state;
+    gdouble value;
+    gint i;
+
+    /* The second pass maps the tile decoded by the first one */
+    for (i = 0; i < 2; i++)
+    {
+        assert_int_equal(overlayaz_srtm_lookup(ctx->directory, TILE_LATITUDE + 0.5, TILE_GZ_LONGITUDE + 0.25, &value), OVERLAYAZ_SRTM_OK);
+        assert_float_equal(value, tile_value(600, 300), FLT_EPSILON);
+        overlayaz_srtm_free();
+    }
+}
+
+static void
+test_srtm_lookup_async_ready(GObject      *source_object,
+                             GAsyncResult *result,
+                             gpointer      user_data)
+{
+    test_async_t *async = user_data;
+    async->error = overlayaz_srtm_lookup_finish(result, &async->value);
+    async->done = TRUE;
+}
+
+static void
+test_srtm_lookup_async(void **state)
+{
+    test_context_t *ctx = *state;
+    test_async_t async = { FALSE, OVERLAYAZ_SRTM_OK, 0.0 };
+    GCancellable *cancellable;
+
+    overlayaz_srtm_lookup_async(ctx->directory, TILE_LATITUDE + 0.5, TILE_LONGITUDE + 0.25, NULL, test_srtm_lookup_async_ready, &async);
+    while (!async.done)
+        g_main_context_iteration(NULL, TRUE);
+    assert_int_equal(async.error, OVERLAYAZ_SRTM_OK);
+    assert_float_equal(async.value, tile_value(600, 300), FLT_EPSILON);
+
+    /* A cancelled lookup reports the cancellation only */
+    async.done = FALSE;
+    cancellable = g_cancellable_new();
+    overlayaz_srtm_lookup_async(ctx->directory, TILE_LATITUDE + 0.5, TILE_LONGITUDE + 0.25, cancellable, test_srtm_lookup_async_ready, &async);
+    g_cancellable_cancel(cancellable);
+    while (!async.done)
+        g_main_context_iteration(NULL, TRUE);
+    assert_int_equal(async.error, OVERLAYAZ_SRTM_ERROR_CANCELLED);
+    g_object_unref(cancellable);
+}
+
+static void
+test_srtm_lookup_batch(void **state)
+{
+    test_context_t *ctx = *state;
+    const gdouble latitude[] = { 50.75, 51.5, 50.0, NAN, 50.1, 50.75 };
+    const gdouble longitude[] = { 20.5, 20.5, 20.0, 20.0, 20.9, 20.1 };
+    const gint count = G_N_ELEMENTS(latitude);
+    gdouble out[G_N_ELEMENTS(latitude)];
+    enum overlayaz_srtm_error errors[G_N_ELEMENTS(latitude)];
+    gdouble value;
+    gint i;
+
+    assert_int_equal(overlayaz_srtm_lookup_batch(ctx->directory, latitude, longitude, count, out, errors), 4);
+    assert_int_equal(errors[1], OVERLAYAZ_SRTM_ERROR_MISSING);
+    assert_int_equal(errors[3], OVERLAYAZ_SRTM_ERROR_INVALID);
+
+    for (i = 0; i < count; i++)
+    {
+        if (errors[i] != OVERLAYAZ_SRTM_OK)
+            continue;
+
+        /* Batch results must match single point lookups */
+        assert_int_equal(overlayaz_srtm_lookup(ctx->directory, latitude[i], longitude[i], &value), OVERLAYAZ_SRTM_OK);
+        assert_float_equal(out[i], value, FLT_EPSILON);
+    }
+}
+
+static void
+test_srtm_sampler(void **state)
+{
+    test_context_t *ctx = *state;
+    overlayaz_srtm_sampler_t *sampler;
+    gdouble latitude[20], longitude[20], out[20];
+    enum overlayaz_srtm_error errors[20];
+    gdouble row, col;
+    gdouble value;
+    gint i;
+
+    sampler = overlayaz_srtm_sampler_new(ctx->directory);
+    assert_non_null(sampler);
+
+    /* Grid posts are returned as they are */
+    assert_int_equal(overlayaz_srtm_sampler_get(sampler, TILE_LATITUDE + 0.5, TILE_LONGITUDE + 0.25, &value), OVERLAYAZ_SRTM_OK);
+    assert_float_equal(value, tile_value(600, 300), 1e-3);
+
+    /* The synthetic surface is a plane, so the interpolation is exact */
+    for (i = 0; i < 20; i++)
+    {
+        row = 100.0 + i * 50.3;
+        col = 1199.9 - i * 60.7;
+        latitude[i] = TILE_LATITUDE + row / (TEST_SRTM_TILE_GRID - 1);
+        longitude[i] = TILE_LONGITUDE + col / (TEST_SRTM_TILE_GRID - 1);
+    }
+    latitude[7] = TILE_LATITUDE + 1.5;
+
+    assert_int_equal(overlayaz_srtm_sampler_get_n(sampler, latitude, longitude, 20, out, errors), 19);
+    assert_int_equal(errors[7], OVERLAYAZ_SRTM_ERROR_MISSING);
+
+    for (i = 0; i < 20; i++)
+    {
+        if (i == 7)
+            continue;
+        assert_int_equal(errors[i], OVERLAYAZ_SRTM_OK);
+        assert_float_equal(out[i], (100.0 + i * 50.3) * 10.0 + (1199.9 - i * 60.7), 1e-2);
+    }
+
+    overlayaz_srtm_sampler_free(sampler);
+}
+
+static void
+test_srtm_sampler_range(void **state)
+{
+    test_context_t *ctx = *state;
+    overlayaz_srtm_sampler_t *sampler;
+    gdouble min, max;
+
+    sampler = overlayaz_srtm_sampler_new(ctx->directory);
+
+    assert_int_equal(overlayaz_srtm_sampler_range(sampler, TILE_LATITUDE, TILE_LONGITUDE, TILE_LATITUDE + 0.9999999, TILE_LONGITUDE + 0.9999999, &min, &max), OVERLAYAZ_SRTM_OK);
+    assert_float_equal(min, tile_value(0, 0), FLT_EPSILON);
+    assert_float_equal(max, tile_value(TEST_SRTM_TILE_GRID - 1, TEST_SRTM_TILE_GRID - 1), FLT_EPSILON);
+
+    /* The range covers the posts surrounding the corners, but may be wider */
+    assert_int_equal(overlayaz_srtm_sampler_range(sampler, TILE_LATITUDE + 0.2004, TILE_LONGITUDE + 0.1004, TILE_LATITUDE + 0.2996, TILE_LONGITUDE + 0.3996, &min, &max), OVERLAYAZ_SRTM_OK);
+    assert_true(min <= tile_value(240, 120));
+    assert_true(max >= tile_value(360, 480));
+    assert_true(max - min < tile_value(TEST_SRTM_TILE_GRID - 1, TEST_SRTM_TILE_GRID - 1) / 2);
+
+    /* The compressed neighbour holds the same data */
+    assert_int_equal(overlayaz_srtm_sampler_range(sampler, TILE_LATITUDE + 0.5004, TILE_LONGITUDE + 0.9004, TILE_LATITUDE + 0.5996, TILE_GZ_LONGITUDE + 0.0996, &min, &max), OVERLAYAZ_SRTM_OK);
+    assert_true(min <= tile_value(600, 0));
+    assert_true(max >= tile_value(720, TEST_SRTM_TILE_GRID - 1));
+
+    assert_int_equal(overlayaz_srtm_sampler_range(sampler, TILE_LATITUDE + 0.5, TILE_LONGITUDE, TILE_LATITUDE + 1.5, TILE_LONGITUDE, NULL, &max), OVERLAYAZ_SRTM_ERROR_MISSING);
+
+    overlayaz_srtm_sampler_free(sampler);
+}
+
+const struct CMUnitTest tests[] =
+{
+    cmocka_unit_test(test_srtm_filename),
+    cmocka_unit_test(test_srtm_lookup),
+    cmocka_unit_test(test_srtm_lookup_missing),
+    cmocka_unit_test(test_srtm_lookup_directory),
+    cmocka_unit_test(test_srtm_lookup_compressed),
+    cmocka_unit_test(test_srtm_lookup_async),
+    cmocka_unit_test(test_srtm_lookup_batch),
+    cmocka_unit_test(test_srtm_sampler),
+    cmocka_unit_test(test_srtm_sampler_range),
+};
+
+int
+main(void)
+{
+    return cmocka_run_group_tests(tests, group_setup, group_teardown);
+}
@@ -0,0 +1,165 @@
+/*
+ *  overlayaz – photo visibility analysis software
+ *  Copyright (c) 2020-2023  Konrad Kosmatka
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include "viewshed.h"
+#include "srtm.h"
+#include "geo.h"
+#include "test-srtm-tile.h"
+
+#define TILE_NAME "N50E020.hgt"
+#define TILE_LATITUDE 50
+#define TILE_LONGITUDE 20
+#define RIDGE_ROW 600
+#define RIDGE_HEIGHT 1000
+
+typedef struct {
+    gchar *directory;
+    gchar *path;
+} test_context_t;
+
+/* Flat plain at 100 m, crossed by a narrow east-west ridge */
+static gint16
+tile_value(gint row,
+           gint col)
+{
+    return (gint16)(ABS(row - RIDGE_ROW) <= 2 ? RIDGE_HEIGHT : 100);
+}
+
+static int
+group_setup(void **state)
+{
+    test_context_t *ctx = malloc(sizeof(test_context_t));
+
+    overlayaz_geo_init();
+
+    ctx->directory = test_srtm_tile_dir_new("overlayaz-viewshed-XXXXXX", TILE_NAME, tile_value, &ctx->path);
+    assert_non_null(ctx->directory);
+
+    *state = ctx;
+    return 0;
+}
+
+static int
+group_teardown(void **state)
+{
+    test_context_t *ctx = *state;
+    overlayaz_viewshed_free();
+    overlayaz_srtm_free();
+    test_srtm_tile_dir_free(ctx->directory, ctx->path);
+    free(ctx);
+    return 0;
+}
+
+static void
+test_viewshed_check(void **state)
+{
+    test_context_t *ctx = *state;
+    /* High enough for the plain not to hide itself behind the horizon */
+    const struct overlayaz_location home = { 50.1, 20.5, 500.0 };
+    const gdouble latitude[] = { 50.3, 50.8, 50.4, 51.5, 50.9 };
+    const gdouble longitude[] = { 20.5, 20.5, 20.2, 20.5, 20.9 };
+    const gint count = G_N_ELEMENTS(latitude);
+    struct overlayaz_viewshed out[G_N_ELEMENTS(latitude)];
+    struct overlayaz_viewshed again[G_N_ELEMENTS(latitude)];
+    gint i;
+
+    overlayaz_viewshed_check(ctx->directory, &home, latitude, longitude, count, TRUE, out);
+
+    /* Markers in front of the ridge */
+    assert_int_equal(out[0].state, OVERLAYAZ_VIEWSHED_VISIBLE);
+    assert_true(out[0].clearance >= 0.0);
+    assert_int_equal(out[2].state, OVERLAYAZ_VIEWSHED_VISIBLE);
+
+    /* Markers behind the ridge */
+    assert_int_equal(out[1].state, OVERLAYAZ_VIEWSHED_OCCLUDED);
+    assert_true(out[1].clearance < 0.0);
+    assert_int_equal(out[4].state, OVERLAYAZ_VIEWSHED_OCCLUDED);
+
+    /* No elevation data */
+    assert_int_equal(out[3].state, OVERLAYAZ_VIEWSHED_UNKNOWN);
+
+    /* Cached results must match */
+    overlayaz_viewshed_check(ctx->directory, &home, latitude, longitude, count, TRUE, again);
+    for (i = 0; i < count; i++)
+    {
+        assert_int_equal(again[i].state, out[i].state);
+        assert_float_equal(again[i].clearance, out[i].clearance, DBL_EPSILON);
+    }
+}
+
+static void
+test_viewshed_above_ridge(void **state)
+{
+    test_context_t *ctx = *state;
+    const struct overlayaz_location home = { 50.1, 20.5, 3000.0 };
+    const gdouble latitude = 50.8;
+    const gdouble longitude = 20.5;
+    struct overlayaz_viewshed out;
+
+    overlayaz_viewshed_check(ctx->directory, &home, &latitude, &longitude, 1, TRUE, &out);
+    assert_int_equal(out.state, OVERLAYAZ_VIEWSHED_VISIBLE);
+}
+
+static void
+test_viewshed_ready(gpointer user_data)
+{
+    gint *ready = (gint*)user_data;
+    (*ready)++;
+}
+
+static void
+test_viewshed_background(void **state)
+{
+    test_context_t *ctx = *state;
+    const struct overlayaz_location home = { 50.2, 20.5, 500.0 };
+    const gdouble latitude = 50.8;
+    const gdouble longitude = 20.5;
+    struct overlayaz_viewshed out;
+    gint ready = 0;
+
+    overlayaz_viewshed_set_notify(test_viewshed_ready, &ready);
+
+    /* Not traced yet */
+    overlayaz_viewshed_check(ctx->directory, &home, &latitude, &longitude, 1, FALSE, &out);
+    assert_int_equal(out.state, OVERLAYAZ_VIEWSHED_UNKNOWN);
+
+    while (ready == 0)
+        g_main_context_iteration(NULL, TRUE);
+    assert_int_equal(ready, 1);
+
+    overlayaz_viewshed_check(ctx->directory, &home, &latitude, &longitude, 1, FALSE, &out);
+    assert_int_equal(out.state, OVERLAYAZ_VIEWSHED_OCCLUDED);
+
+    overlayaz_viewshed_set_notify(NULL, NULL);
+}
+
+const struct CMUnitTest tests[] =
+{
+    cmocka_unit_test(test_viewshed_check),
+    cmocka_unit_test(test_viewshed_above_ridge),
+    cmocka_unit_test(test_viewshed_background),
+};
+
+int
+main(void)
+{
+    return cmocka_run_group_tests(tests, group_setup, group_teardown);
+}